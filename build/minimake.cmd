@@ -12,7 +12,7 @@ set COMPILE=gcc -c -xc++ -std=c++11 -Wall -Wextra -Wpedantic -Iinclude
 set ARCHIVE=ar -rc
 
 set MAKETEST=gcc -xc++ -std=c++11 -Wall -Wextra -Wpedantic -I. -Llib
-set TESTLIBS=-l%LIBNAME% -lsupc++
+set TESTLIBS=-l%LIBNAME% -lsupc++ -lpthread
 set ALTFLAGS=-fno-rtti -fno-exceptions
 
 :: Create directories
@@ -32,17 +32,25 @@ del /Q test\lib\*
 del /Q test\obj\*
 
 :: Build
-%COMPILE% nx-new.cc -o obj\nx-new.o
+%COMPILE% src\nx-new.cc -o obj\nx-new.o
+%COMPILE% src\nx-mem.cc -o obj\nx-mem.o
 ::%COMPILE% nx-ini.cc -o obj\nx-ini.o
 
 :: Archive
 %ARCHIVE% %LIBRARY% obj\nx-new.o
+%ARCHIVE% %LIBRARY% obj\nx-mem.o
 ::%ARCHIVE% %LIBRARY% obj\nx-ini.o
 
+:: Tools
+%MAKETEST% -Iinclude tools\nx-heap-report.cc %TESTLIBS% -o bin\nx-heap-report.exe
+
 :: Test
 %MAKETEST% test\test-nx-new.cc %TESTLIBS% -o test\bin\test-nx-new.exe && test\bin\test-nx-new.exe
 %MAKETEST% %ALTFLAGS% test\test-nx-new.cc %TESTLIBS% -o test\bin\test-nx-new[alt].exe && test\bin\test-nx-new[alt].exe
 
+%MAKETEST% test\test-nx-mem.cc %TESTLIBS% -o test\bin\test-nx-mem.exe && test\bin\test-nx-mem.exe
+%MAKETEST% %ALTFLAGS% test\test-nx-mem.cc %TESTLIBS% -o test\bin\test-nx-mem[alt].exe && test\bin\test-nx-mem[alt].exe
+
 %MAKETEST% test\test-nx-type.cc %TESTLIBS% -o test\bin\test-nx-type.exe && test\bin\test-nx-type.exe
 %MAKETEST% %ALTFLAGS% test\test-nx-type.cc %TESTLIBS% -o test\bin\test-nx-type[alt].exe && test\bin\test-nx-type[alt].exe
 
@@ -52,5 +60,8 @@ del /Q test\obj\*
 %MAKETEST% test\test-nx-rng.cc %TESTLIBS% -o test\bin\test-nx-rng.exe && test\bin\test-nx-rng.exe
 %MAKETEST% %ALTFLAGS% test\test-nx-rng.cc %TESTLIBS% -o test\bin\test-nx-rng[alt].exe && test\bin\test-nx-rng[alt].exe
 
+%MAKETEST% test\test-nx-hash.cc %TESTLIBS% -o test\bin\test-nx-hash.exe && test\bin\test-nx-hash.exe
+%MAKETEST% %ALTFLAGS% test\test-nx-hash.cc %TESTLIBS% -o test\bin\test-nx-hash[alt].exe && test\bin\test-nx-hash[alt].exe
+
 
 endlocal
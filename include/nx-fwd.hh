@@ -10,8 +10,13 @@ namespace nx
 // from <nx-new.hh>
 // Nothing yet!
 
+// from <nx-mem.hh>
+class Arena;
+template<typename T> class Pool;
+
 // from <nx-type.hh>
 template<typename T> class Array;
+template<typename T, typename L, size_t A> class RawArray;
 template<typename ... TS> class Tuple;
 template<typename T, size_t N> class Multi;
 
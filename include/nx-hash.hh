@@ -0,0 +1,411 @@
+// Include guard
+#pragma once
+
+// Local includes
+#include "nx-type.hh"
+#include "nx-rng.hh"
+
+// Namespace "nx"
+namespace nx {
+
+/**
+	Hashing
+
+	`hash(value)` returns a 64 bit hash of a value. Types are made hashable by specializing Hash<T>, which has a single
+	static function: `uint64_t hash(const T & value) noexcept`. Equal values must have equal hashes.
+
+	Integers and pointers are hashed by a finalizer (a bijective mix of their bits), so every bit of the input affects
+	every bit of the hash. Hash containers can use any part of the hash, without worrying about patterns in the keys.
+
+	Byte buffers (arrays of integers, and strings) are hashed by `hashBytes`, a wyhash style function, that reads 8
+	bytes at a time, and mixes them with 64x64->128 bit multiplications. It is seeded by `hashSeed()`, a random number
+	drawn once per process, so the hashes (and the layout of hash tables) differ between runs, and can't be attacked
+	with precomputed collisions. Data, that is not in one piece, can be hashed with `Hasher`, which gives the same hash
+	as `hashBytes` for the same bytes, however they are split.
+
+	Tuples, and arrays of other types combine the hashes of their items with `combineHash`.
+ */
+
+// [FUNCTION] mixHash - Mixes the bits of a 64 bit value (the finalizer of SplitMix64)
+inline uint64_t mixHash(uint64_t x) noexcept
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+	return x ^ (x >> 31);
+}
+
+// [CLASS] Hash - Hash function of a type (not defined for types, that are not hashable)
+template<typename T> struct Hash;
+
+// Namespace "nx::impl"
+namespace impl {
+
+// Hash of integer types
+template<typename T> struct IntegerHash
+{
+	static uint64_t hash(T value) noexcept
+		{return mixHash(static_cast<uint64_t>(value));}
+};
+
+// [CLASS] HashGroup - A group of control bytes in a hash table, compared all at once
+//
+// Every slot of the table has a control byte: either `empty` or `deleted` (high bit set), or the 7 bit tag of the hash
+// in the slot.
+// A group of 8 control bytes is loaded as a single 64 bit word, and the tag is compared to all of them with a few
+// integer operations (SIMD within a register). The match mask has the high bit set in every matching byte. It can also
+// have false positives, but only after a real match, and only for bytes with a tag one larger than the searched one
+// (the table still compares the full hashes, so these are just extra compares).
+struct HashGroup
+{
+	// Number of control bytes in a group, and the control bytes of empty and deleted slots
+	static constexpr size_t size = 8;
+	static constexpr byte empty = 0x80;
+	static constexpr byte deleted = 0xfe;
+
+	// Tag of a hash (its top 7 bits, the low bits select the group)
+	static inline byte tagOf(uintptr_t hash) noexcept
+		{return static_cast<byte>(hash >> (8 * sizeof(uintptr_t) - 7));}
+
+	// Load a group (the first byte of the group is the lowest byte of the word)
+	explicit HashGroup(const byte * control) noexcept
+	{
+		__builtin_memcpy(& word, control, sizeof(word));
+		#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		word = __builtin_bswap64(word);
+		#endif
+	}
+
+	// Masks of the bytes, that match a tag, of the empty bytes, and of the free (empty or deleted) bytes
+	inline uint64_t match(byte tag) const noexcept
+		{uint64_t x = word ^ (lows * tag); return (x - lows) & ~x & highs;}
+	inline uint64_t matchEmpty() const noexcept
+		{return word & ~(word << 6) & highs;}
+	inline uint64_t matchFree() const noexcept
+		{return word & highs;}
+
+	// Index of the first byte in a mask, and the mask without its first byte
+	static inline size_t first(uint64_t mask) noexcept
+		{return static_cast<size_t>(__builtin_ctzll(mask)) >> 3;}
+	static inline uint64_t next(uint64_t mask) noexcept
+		{return mask & (mask - 1);}
+
+	static constexpr uint64_t lows = 0x0101010101010101;
+	static constexpr uint64_t highs = 0x8080808080808080;
+	uint64_t word;
+};
+
+// Multiplies two 64 bit numbers, and returns the low and high half of the 128 bit product in them
+inline void multiplyWide(uint64_t & a, uint64_t & b) noexcept
+{
+	#ifdef __SIZEOF_INT128__
+	__extension__ typedef unsigned __int128 Wide;
+	Wide product = static_cast<Wide>(a) * b;
+	a = static_cast<uint64_t>(product);
+	b = static_cast<uint64_t>(product >> 64);
+	#else
+	uint64_t ah = a >> 32, al = a & 0xffffffff, bh = b >> 32, bl = b & 0xffffffff;
+	uint64_t hh = ah * bh, hl = ah * bl, lh = al * bh, ll = al * bl;
+	uint64_t middle = (ll >> 32) + (hl & 0xffffffff) + (lh & 0xffffffff);
+	a = (middle << 32) | (ll & 0xffffffff);
+	b = hh + (hl >> 32) + (lh >> 32) + (middle >> 32);
+	#endif
+}
+
+// Mixes two 64 bit numbers (the xor of the two halves of their product)
+inline uint64_t mixWide(uint64_t a, uint64_t b) noexcept
+{
+	multiplyWide(a, b);
+	return a ^ b;
+}
+
+// Little endian reads of 8, 4, and 1-3 bytes (from any address)
+inline uint64_t read8(const byte * p) noexcept
+{
+	uint64_t x;
+	__builtin_memcpy(& x, p, sizeof(x));
+	#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	x = __builtin_bswap64(x);
+	#endif
+	return x;
+}
+inline uint64_t read4(const byte * p) noexcept
+{
+	uint32_t x;
+	__builtin_memcpy(& x, p, sizeof(x));
+	#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	x = __builtin_bswap32(x);
+	#endif
+	return x;
+}
+inline uint64_t read3(const byte * p, size_t n) noexcept
+	{return (uint64_t(p[0]) << 16) | (uint64_t(p[n >> 1]) << 8) | p[n - 1];}
+
+// Secret constants of the byte hash
+constexpr uint64_t hashSecret0 = 0x2d358dccaa6c78a5;
+constexpr uint64_t hashSecret1 = 0x8bb84b93962eacc9;
+constexpr uint64_t hashSecret2 = 0x4b33a62ed433d4a3;
+constexpr uint64_t hashSecret3 = 0x4d5a2da51de1aa47;
+
+// Hashes a 48 byte block in three independent lanes
+inline void hashBlock(const byte * p, uint64_t & seed, uint64_t & see1, uint64_t & see2) noexcept
+{
+	seed = mixWide(read8(p) ^ hashSecret1, read8(p + 8) ^ seed);
+	see1 = mixWide(read8(p + 16) ^ hashSecret2, read8(p + 24) ^ see1);
+	see2 = mixWide(read8(p + 32) ^ hashSecret3, read8(p + 40) ^ see2);
+}
+
+// Hashes the last `n` (at most 48) bytes of a buffer of `length` bytes, after its blocks (if the buffer had blocks,
+// the 16 bytes before `p` must be readable, and must be the last bytes of the blocks)
+inline uint64_t hashTail(const byte * p, size_t n, uint64_t length, uint64_t seed) noexcept
+{
+	uint64_t a, b;
+	if (length <= 16)
+	{
+		if (n >= 4)
+		{
+			a = (read4(p) << 32) | read4(p + ((n >> 3) << 2));
+			b = (read4(p + n - 4) << 32) | read4(p + n - 4 - ((n >> 3) << 2));
+		}
+		else
+		{
+			a = n > 0 ? read3(p, n) : 0;
+			b = 0;
+		}
+	}
+	else
+	{
+		for (; n > 16; p += 16, n -= 16)
+			seed = mixWide(read8(p) ^ hashSecret1, read8(p + 8) ^ seed);
+		a = read8(p + n - 16);
+		b = read8(p + n - 8);
+	}
+
+	a ^= hashSecret1;
+	b ^= seed;
+	multiplyWide(a, b);
+	return mixWide(a ^ hashSecret0 ^ length, b ^ hashSecret1);
+}
+
+// Draws the seed of the process: the addresses of the stack, the code, and the data are randomized by the system
+// (ASLR), and the time stamp counter (where it can be read) differs between runs
+inline uint64_t drawHashSeed() noexcept
+{
+	static byte data;
+	byte stack = 0;
+	uint64_t entropy = reinterpret_cast<uintptr_t>(& stack);
+	entropy = mixHash(entropy ^ reinterpret_cast<uintptr_t>(& data));
+	entropy = mixHash(entropy ^ reinterpret_cast<uintptr_t>(& drawHashSeed));
+	#if defined(__x86_64__) || defined(__i386__)
+	entropy = mixHash(entropy ^ __builtin_ia32_rdtsc());
+	#endif
+
+	rng::Random random(entropy);
+	return random.next();
+}
+
+// Close namespace "nx::impl"
+}
+
+// Integer hashes
+template<> struct Hash<bool> : impl::IntegerHash<bool> {};
+template<> struct Hash<char> : impl::IntegerHash<char> {};
+template<> struct Hash<signed char> : impl::IntegerHash<signed char> {};
+template<> struct Hash<unsigned char> : impl::IntegerHash<unsigned char> {};
+template<> struct Hash<wchar_t> : impl::IntegerHash<wchar_t> {};
+template<> struct Hash<char16_t> : impl::IntegerHash<char16_t> {};
+template<> struct Hash<char32_t> : impl::IntegerHash<char32_t> {};
+template<> struct Hash<short> : impl::IntegerHash<short> {};
+template<> struct Hash<unsigned short> : impl::IntegerHash<unsigned short> {};
+template<> struct Hash<int> : impl::IntegerHash<int> {};
+template<> struct Hash<unsigned int> : impl::IntegerHash<unsigned int> {};
+template<> struct Hash<long> : impl::IntegerHash<long> {};
+template<> struct Hash<unsigned long> : impl::IntegerHash<unsigned long> {};
+template<> struct Hash<long long> : impl::IntegerHash<long long> {};
+template<> struct Hash<unsigned long long> : impl::IntegerHash<unsigned long long> {};
+
+// Pointer hashes (the address is hashed, not the object)
+template<typename T> struct Hash<T *>
+{
+	static uint64_t hash(T * value) noexcept
+		{return mixHash(reinterpret_cast<uintptr_t>(value));}
+};
+
+// [FUNCTION] hash - Returns the hash of a value
+template<typename T> inline uint64_t hash(const T & value) noexcept
+{
+	return Hash<T>::hash(value);
+}
+
+// [FUNCTION] combineHash - Combines the hash of the next item into the hash of the previous items (order dependent)
+inline uint64_t combineHash(uint64_t seed, uint64_t value) noexcept
+{
+	return impl::mixWide(seed ^ impl::hashSecret0, value ^ impl::hashSecret1);
+}
+
+// [FUNCTION] hashSeed - Returns the random seed of the byte hashes (drawn at the first call, then fixed for the process)
+inline uint64_t hashSeed() noexcept
+{
+	static const uint64_t seed = impl::drawHashSeed();
+	return seed;
+}
+
+// [FUNCTION] hashBytes - Returns the hash of a byte buffer (with the seed of the process, or with an explicit seed)
+inline uint64_t hashBytes(const void * data, size_t size, uint64_t seed) noexcept
+{
+	const byte * p = static_cast<const byte *>(data);
+	seed ^= impl::mixWide(seed ^ impl::hashSecret0, impl::hashSecret1);
+
+	size_t n = size;
+	if (n > 48)
+	{
+		uint64_t see1 = seed, see2 = seed;
+		for (; n > 48; p += 48, n -= 48)
+			impl::hashBlock(p, seed, see1, see2);
+		seed ^= see1 ^ see2;
+	}
+	return impl::hashTail(p, n, size, seed);
+}
+inline uint64_t hashBytes(const void * data, size_t size) noexcept
+{
+	return hashBytes(data, size, hashSeed());
+}
+
+// [CLASS] Hasher - Hashes data, that is not in one piece
+//
+// The bytes are hashed in 48 byte blocks as they come (only the incomplete block is buffered), and `finish()` gives the
+// same hash, as `hashBytes` for all the bytes in one piece. Values are added by their hash.
+class Hasher
+{
+public:
+	// Constructor
+	explicit Hasher(uint64_t seed = hashSeed()) noexcept
+		: seed(seed ^ impl::mixWide(seed ^ impl::hashSecret0, impl::hashSecret1)), see1(this->seed), see2(this->seed), length(0), pending(0) {}
+
+	// Number of bytes hashed
+	inline uint64_t size() const noexcept
+		{return length;}
+
+	// Hash bytes
+	void update(const void * data, size_t size) noexcept
+	{
+		const byte * p = static_cast<const byte *>(data);
+		if (size == 0)
+			return;
+		length += size;
+
+		// The buffered block is hashed only when more bytes follow it (the last block is hashed differently)
+		if (pending + size <= 48)
+		{
+			__builtin_memcpy(buffer + pending, p, size);
+			pending += size;
+			return;
+		}
+		if (pending > 0)
+		{
+			size_t count = 48 - pending;
+			__builtin_memcpy(buffer + pending, p, count);
+			impl::hashBlock(buffer, seed, see1, see2);
+			__builtin_memcpy(history, buffer + 32, 16);
+			p += count;
+			size -= count;
+		}
+
+		// Whole blocks are hashed in place
+		if (size > 48)
+		{
+			for (; size > 48; p += 48, size -= 48)
+				impl::hashBlock(p, seed, see1, see2);
+			__builtin_memcpy(history, p - 16, 16);
+		}
+		__builtin_memcpy(buffer, p, size);
+		pending = size;
+	}
+
+	// Hash a value (its hash is hashed as 8 bytes)
+	template<typename T> void add(const T & value) noexcept
+	{
+		uint64_t x = hash(value);
+		update(& x, sizeof(x));
+	}
+
+	// Hash of the bytes so far (more bytes can be hashed after it)
+	uint64_t finish() const noexcept
+	{
+		if (length <= 48)
+			return impl::hashTail(buffer, pending, length, seed);
+
+		// The tail can read up to 16 bytes before the last bytes
+		byte tail[64];
+		__builtin_memcpy(tail, history, 16);
+		__builtin_memcpy(tail + 16, buffer, pending);
+		return impl::hashTail(tail + 16, pending, length, seed ^ see1 ^ see2);
+	}
+
+private:
+	uint64_t seed;
+	uint64_t see1;
+	uint64_t see2;
+	uint64_t length;
+	size_t pending;
+	byte buffer[48];
+	byte history[16];
+};
+
+// Namespace "nx::impl"
+namespace impl {
+
+// Hash of items in a row: integers are hashed as bytes, other types by combining the hashes of the items
+template<typename T, bool = __is_base_of(IntegerHash<T>, Hash<T>)> struct ItemsHash
+{
+	static uint64_t hash(const T * items, size_t n) noexcept
+	{
+		uint64_t result = mixHash(n);
+		for (size_t i = 0; i < n; ++ i)
+			result = combineHash(result, Hash<T>::hash(items[i]));
+		return result;
+	}
+};
+template<typename T> struct ItemsHash<T, true>
+{
+	static uint64_t hash(const T * items, size_t n) noexcept
+		{return hashBytes(items, n * sizeof(T));}
+};
+
+// Close namespace "nx::impl"
+}
+
+// Tuple hashes
+template<typename X, typename Y> struct Hash<Tuple<X, Y>>
+{
+	static uint64_t hash(const Tuple<X, Y> & value) noexcept
+		{return combineHash(nx::hash(value.first), nx::hash(value.second));}
+};
+template<typename X, typename Y, typename Z> struct Hash<Tuple<X, Y, Z>>
+{
+	static uint64_t hash(const Tuple<X, Y, Z> & value) noexcept
+		{return combineHash(combineHash(nx::hash(value.first), nx::hash(value.second)), nx::hash(value.third));}
+};
+template<typename X, typename Y, typename Z, typename W> struct Hash<Tuple<X, Y, Z, W>>
+{
+	static uint64_t hash(const Tuple<X, Y, Z, W> & value) noexcept
+	{
+		uint64_t result = combineHash(nx::hash(value.first), nx::hash(value.second));
+		result = combineHash(result, nx::hash(value.third));
+		return combineHash(result, nx::hash(value.fourth));
+	}
+};
+
+// Multi and array hashes (the items are hashed, an array of bytes is hashed as a byte buffer)
+template<typename T, size_t N> struct Hash<Multi<T, N>>
+{
+	static uint64_t hash(const Multi<T, N> & value) noexcept
+		{return impl::ItemsHash<T>::hash(value.data, N);}
+};
+template<typename T> struct Hash<Array<T>>
+{
+	static uint64_t hash(const Array<T> & value) noexcept
+		{return impl::ItemsHash<T>::hash(value.data, value.length);}
+};
+
+// Close namespace "nx"
+}
@@ -0,0 +1,528 @@
+// Include guard
+#pragma once
+
+// Local includes
+#include "nx-new.hh"
+#include "nx-ptr.hh"
+
+// Namespace "nx"
+namespace nx {
+
+// ------------------------------------------------------------ //
+//		Arena
+// ------------------------------------------------------------ //
+
+/**
+	[CLASS] Arena - Monotonic (bump pointer) allocator
+
+	Memory is carved from large chunks, and only released all at once, by `reset` (or by destroying the arena). Objects
+	created with `create` and `createArray` are destroyed by `reset` in reverse order of creation, except when their type
+	is trivially destructible: nothing is recorded for those, so they cost no more than `alloc`. Memory returned by
+	`alloc` is never touched.
+
+	Chunks are kept after a reset, so an arena that is reused (eg. for the scratch data of a request) gets to a point,
+	where it doesn't call the global allocator at all. `trim` releases the kept chunks. Requests larger than a quarter
+	of a chunk get a chunk of their own, which is released by `reset`.
+
+	Arenas are not thread safe.
+ */
+class Arena
+{
+public:
+	// Default chunk size
+	static constexpr size_t defaultChunkSize = 64 * 1024;
+
+	// Constructor & destructor
+	explicit Arena(size_t chunkSize = defaultChunkSize) noexcept;
+	~Arena() noexcept;
+
+	// Copy operators deleted
+	Arena(const Arena &) = delete;
+	Arena & operator = (const Arena &) = delete;
+
+	// Allocate uninitialized memory (returns null, if the allocation failed)
+	void * alloc(size_t size, size_t align = type::newAlignment) noexcept;
+	// Memory is only released by reset (so Arena can be used as an allocator policy, with mem::Ref<Arena>)
+	void free(void *, size_t, size_t) noexcept
+		{}
+
+	// Create an object in the arena (returns null, if the allocation failed)
+	template<typename T, typename... TS> T * create(TS && ... args) noexcept(type::hasNoexceptCreate<T, TS ...>());
+	// Create an array of default constructed objects in the arena (returns null, if the allocation failed)
+	template<typename T> T * createArray(size_t n) noexcept(type::hasNoexceptCreate<T>() || !exceptions);
+
+	// Destroy the objects, and release the memory (chunks of the default size are kept for reuse)
+	void reset() noexcept;
+	// Release the chunks kept for reuse
+	void trim() noexcept;
+
+	// Number of bytes handed out since the last reset (including alignment)
+	size_t used() const noexcept
+		{return usedBytes + (head - start);}
+	// Number of bytes allocated from the global allocator
+	size_t reserved() const noexcept
+		{return reservedBytes;}
+
+private:
+	// Chunk header (followed by the memory of the chunk)
+	struct Chunk
+	{
+		Chunk * next;
+		size_t size;
+	};
+
+	// Record of objects to destroy on reset
+	struct Finalizer
+	{
+		Finalizer * next;
+		void (* destroy)(void * items, size_t n);
+		void * items;
+		size_t n;
+	};
+
+	// Destroy function of finalizers
+	template<typename T> static void finalize(void * items, size_t n) noexcept
+		{type::destroyArrayAt(static_cast<T *>(items), n);}
+
+	// Allocate memory from a new chunk
+	void * allocSlow(size_t size, size_t align) noexcept;
+
+	// Free part of the current chunk
+	uintptr_t head;
+	uintptr_t tail;
+	uintptr_t start;
+
+	// Chunks in use (the current one first), and chunks kept for reuse
+	Chunk * chunks;
+	Chunk * spare;
+
+	// Objects to destroy (the last created first)
+	Finalizer * finalizers;
+
+	// Settings and counters
+	size_t chunkSize;
+	size_t usedBytes;
+	size_t reservedBytes;
+};
+
+// ------------------------------------------------------------ //
+//		Arena Implementation
+// ------------------------------------------------------------ //
+
+inline Arena::Arena(size_t chunkSize) noexcept
+	: head(0), tail(0), start(0), chunks(nullptr), spare(nullptr), finalizers(nullptr), chunkSize(chunkSize < 1024 ? 1024 : chunkSize), usedBytes(0), reservedBytes(0)
+{
+}
+
+inline Arena::~Arena() noexcept
+{
+	reset();
+	trim();
+}
+
+// Allocate memory - bumps the head of the current chunk (align must be a power of two)
+inline void * Arena::alloc(size_t size, size_t align) noexcept
+{
+	uintptr_t ptr = (head + align - 1) & ~(align - 1);
+	if (head != 0 && ptr <= tail && size <= tail - ptr)
+	{
+		head = ptr + size;
+		return reinterpret_cast<void *>(ptr);
+	}
+	return allocSlow(size, align);
+}
+
+inline void * Arena::allocSlow(size_t size, size_t align) noexcept
+{
+	// Large requests get a chunk of their own (linked behind the current one, so its free part is not lost)
+	if (size > chunkSize / 4 || align > chunkSize / 4)
+	{
+		if (size > SIZE_MAX - sizeof(Chunk) - align)
+			return nullptr;
+
+		size_t bytes = sizeof(Chunk) + size + align;
+		Chunk * chunk = type::alloc<Chunk>(bytes);
+		if (!chunk)
+			return nullptr;
+
+		chunk->size = bytes;
+		if (chunks)
+		{
+			chunk->next = chunks->next;
+			chunks->next = chunk;
+		}
+		else
+		{
+			chunk->next = nullptr;
+			chunks = chunk;
+		}
+
+		usedBytes += size;
+		reservedBytes += bytes;
+		return reinterpret_cast<void *>((reinterpret_cast<uintptr_t>(chunk + 1) + align - 1) & ~(align - 1));
+	}
+
+	// Take a spare chunk, or allocate a new one
+	Chunk * chunk = spare;
+	if (chunk)
+	{
+		spare = chunk->next;
+	}
+	else
+	{
+		chunk = type::alloc<Chunk>(chunkSize);
+		if (!chunk)
+			return nullptr;
+		chunk->size = chunkSize;
+		reservedBytes += chunkSize;
+	}
+
+	// Retire the current chunk
+	chunk->next = chunks;
+	chunks = chunk;
+	usedBytes += head - start;
+
+	head = start = reinterpret_cast<uintptr_t>(chunk + 1);
+	tail = reinterpret_cast<uintptr_t>(chunk) + chunkSize;
+
+	// Fits for sure
+	return alloc(size, align);
+}
+
+template<typename T, typename... TS> T * Arena::create(TS && ... args) noexcept(type::hasNoexceptCreate<T, TS ...>())
+{
+	// Trivially destructible objects are not recorded
+	if (type::hasTrivialDestroy<T>())
+	{
+		void * ptr = alloc(sizeof(T), alignof(T));
+		return ptr ? type::createAt(static_cast<T *>(ptr), static_cast<TS &&>(args)...) : nullptr;
+	}
+
+	Finalizer * finalizer = static_cast<Finalizer *>(alloc(sizeof(Finalizer), alignof(Finalizer)));
+	void * ptr = finalizer ? alloc(sizeof(T), alignof(T)) : nullptr;
+	if (!ptr)
+		return nullptr;
+
+	// Record the object only after it was constructed, so a throwing constructor is never followed by a destructor
+	T * obj = type::createAt(static_cast<T *>(ptr), static_cast<TS &&>(args)...);
+	* finalizer = Finalizer {finalizers, & finalize<T>, obj, 1};
+	finalizers = finalizer;
+	return obj;
+}
+
+template<typename T> T * Arena::createArray(size_t n) noexcept(type::hasNoexceptCreate<T>() || !exceptions)
+{
+	if (n > SIZE_MAX / sizeof(T))
+		return nullptr;
+
+	// Trivially destructible objects are not recorded
+	if (type::hasTrivialDestroy<T>())
+	{
+		void * ptr = alloc(n * sizeof(T), alignof(T));
+		return ptr ? type::createArrayAt(static_cast<T *>(ptr), n) : nullptr;
+	}
+
+	Finalizer * finalizer = static_cast<Finalizer *>(alloc(sizeof(Finalizer), alignof(Finalizer)));
+	void * ptr = finalizer ? alloc(n * sizeof(T), alignof(T)) : nullptr;
+	if (!ptr)
+		return nullptr;
+
+	T * items = type::createArrayAt(static_cast<T *>(ptr), n);
+	* finalizer = Finalizer {finalizers, & finalize<T>, items, n};
+	finalizers = finalizer;
+	return items;
+}
+
+inline void Arena::reset() noexcept
+{
+	// Destroy objects in reverse order of creation (the records are in the arena, but they are not released yet)
+	for (Finalizer * finalizer = finalizers; finalizer; finalizer = finalizer->next)
+		finalizer->destroy(finalizer->items, finalizer->n);
+	finalizers = nullptr;
+
+	// Keep the chunks of the default size, release the large ones
+	while (chunks)
+	{
+		Chunk * chunk = chunks;
+		chunks = chunk->next;
+		if (chunk->size == chunkSize)
+		{
+			chunk->next = spare;
+			spare = chunk;
+		}
+		else
+		{
+			reservedBytes -= chunk->size;
+			type::free(chunk, chunk->size);
+		}
+	}
+
+	head = tail = start = 0;
+	usedBytes = 0;
+}
+
+inline void Arena::trim() noexcept
+{
+	while (spare)
+	{
+		Chunk * chunk = spare;
+		spare = chunk->next;
+		reservedBytes -= chunk->size;
+		type::free(chunk, chunk->size);
+	}
+}
+
+// ------------------------------------------------------------ //
+//		Pool
+// ------------------------------------------------------------ //
+
+// Namespace "nx::mem"
+namespace mem {
+
+// Maximum number of threads with an index (threads above this are served without per-thread state)
+constexpr size_t maxThreads = 64;
+
+// Claim an index for the calling thread, and set `index` to the index + 1 (released, when the thread exits)
+size_t claimThreadIndex(size_t & index) noexcept;
+
+// Index of the calling thread (below maxThreads), unique among the running threads, or maxThreads if none is left
+inline size_t threadIndex() noexcept
+{
+	// Index + 1, zero if not claimed yet
+	static thread_local size_t index = 0;
+	if (index == 0)
+		return claimThreadIndex(index);
+	return index - 1;
+}
+
+// Close namespace "nx::mem"
+}
+
+/**
+	[CLASS] Pool - Allocator of fixed size objects
+
+	Slots are carved from slabs, that are aligned to their size, so the pool of a slot can be found from its address.
+	This makes `Pool<T>::Deleter` stateless, so pooled objects can be kept in `UniquePtr<T, Pool<T>::Deleter>`.
+
+	Every thread has its own free list in the pool (threads are identified by `mem::threadIndex`), that is used without
+	any synchronization. When it grows above `cacheLimit`, the whole list is moved to the global free list at once. The
+	global free list is a lock-free stack, which is only ever emptied at once (by a thread, whose own list ran dry), so
+	it is not affected by the ABA problem.
+
+	Slots can be freed by any thread. The pool must outlive its slots: destroying the pool releases the slabs, without
+	destroying the objects that are still in them.
+ */
+template<typename T> class Pool
+{
+public:
+	// Deleter for UniquePtr - destroys the object, and returns it to its pool
+	struct Deleter
+	{
+		void operator () (T * obj) const noexcept
+			{if (obj) Pool::of(obj)->destroy(obj);}
+	};
+
+	// Slot sizes, and the number of slots kept in a thread free list
+	static constexpr size_t slotAlign = alignof(T) > alignof(void *) ? alignof(T) : alignof(void *);
+	static constexpr size_t slotSize = ((sizeof(T) > sizeof(void *) ? sizeof(T) : sizeof(void *)) + slotAlign - 1) & ~(slotAlign - 1);
+	static constexpr size_t cacheLimit = 256;
+
+	// Constructor & destructor
+	Pool() noexcept;
+	~Pool() noexcept;
+
+	// Copy operators deleted
+	Pool(const Pool &) = delete;
+	Pool & operator = (const Pool &) = delete;
+
+	// Allocate a slot, without constructing the object (returns null, if the allocation failed)
+	T * alloc() noexcept;
+	// Return a slot to the pool, without destroying the object
+	void free(T * obj) noexcept;
+
+	// Create an object in a slot (returns null, if the allocation failed)
+	template<typename... TS> T * create(TS && ... args) noexcept(type::hasNoexceptCreate<T, TS ...>());
+	// Destroy an object, and return its slot to the pool
+	void destroy(T * obj) noexcept(type::hasNoexceptDestroy<T>());
+
+	// Create an object in a slot, wrapped in a UniquePtr
+	template<typename... TS> UniquePtr<T, Deleter> make(TS && ... args) noexcept(type::hasNoexceptCreate<T, TS ...>())
+		{return UniquePtr<T, Deleter>(create(static_cast<TS &&>(args)...));}
+
+	// Pool of a slot
+	static Pool * of(T * obj) noexcept;
+
+private:
+	// Free slot
+	struct Slot
+	{
+		Slot * next;
+	};
+
+	// Slab header (followed by the slots)
+	struct Slab
+	{
+		Pool * pool;
+		Slab * next;
+	};
+
+	// Free list of a thread (padded to a cache line)
+	struct Cache
+	{
+		Slot * head;
+		Slot * tail;
+		size_t count;
+		byte padding[64 - 2 * sizeof(Slot *) - sizeof(size_t)];
+	};
+
+	// Slabs are at least 64 KB, and hold at least 32 slots (the size is a power of two, so slots can find their slab)
+	static constexpr size_t slotOffset = (sizeof(Slab) + slotAlign - 1) & ~(slotAlign - 1);
+	static constexpr size_t slabSize = slotOffset + 32 * slotSize <= 64 * 1024 ? 64 * 1024 : size_t(1) << (64 - __builtin_clzll(slotOffset + 32 * slotSize - 1));
+	static constexpr size_t slabSlots = (slabSize - slotOffset) / slotSize;
+
+	// Move a list of slots to the global free list
+	void release(Slot * head, Slot * tail) noexcept;
+
+	// Allocate a slot from the global free list, or from a new slab
+	T * allocSlow(size_t index) noexcept;
+
+	// Free lists of the threads
+	Cache caches[mem::maxThreads];
+
+	// Global free list
+	Slot * global;
+
+	// All slabs of the pool
+	Slab * slabs;
+};
+
+// ------------------------------------------------------------ //
+//		Pool Implementation
+// ------------------------------------------------------------ //
+
+template<typename T> Pool<T>::Pool() noexcept
+	: global(nullptr), slabs(nullptr)
+{
+	for (Cache & cache : caches)
+		cache.head = cache.tail = nullptr, cache.count = 0;
+}
+
+template<typename T> Pool<T>::~Pool() noexcept
+{
+	while (slabs)
+	{
+		Slab * slab = slabs;
+		slabs = slab->next;
+		operator delete (static_cast<void *>(slab), slabSize, std::align_val_t(slabSize));
+	}
+}
+
+template<typename T> Pool<T> * Pool<T>::of(T * obj) noexcept
+{
+	return reinterpret_cast<Slab *>(reinterpret_cast<uintptr_t>(obj) & ~(slabSize - 1))->pool;
+}
+
+template<typename T> T * Pool<T>::alloc() noexcept
+{
+	size_t index = mem::threadIndex();
+	if (index < mem::maxThreads && caches[index].head)
+	{
+		Cache & cache = caches[index];
+		Slot * slot = cache.head;
+		cache.head = slot->next;
+		cache.count -= 1;
+		return reinterpret_cast<T *>(slot);
+	}
+	return allocSlow(index);
+}
+
+template<typename T> void Pool<T>::free(T * obj) noexcept
+{
+	Slot * slot = reinterpret_cast<Slot *>(obj);
+	size_t index = mem::threadIndex();
+	if (index >= mem::maxThreads)
+		return release(slot, slot);
+
+	// Move the whole free list to the global free list, when it grows too long
+	Cache & cache = caches[index];
+	if (cache.count >= cacheLimit)
+	{
+		release(cache.head, cache.tail);
+		cache.head = nullptr;
+		cache.count = 0;
+	}
+
+	slot->next = cache.head;
+	if (!cache.head)
+		cache.tail = slot;
+	cache.head = slot;
+	cache.count += 1;
+}
+
+template<typename T> template<typename... TS> T * Pool<T>::create(TS && ... args) noexcept(type::hasNoexceptCreate<T, TS ...>())
+{
+	T * obj = alloc();
+	return obj ? type::createAt(obj, static_cast<TS &&>(args)...) : nullptr;
+}
+
+template<typename T> void Pool<T>::destroy(T * obj) noexcept(type::hasNoexceptDestroy<T>())
+{
+	type::destroyAt(obj);
+	free(obj);
+}
+
+template<typename T> void Pool<T>::release(Slot * head, Slot * tail) noexcept
+{
+	Slot * next = __atomic_load_n(& global, __ATOMIC_RELAXED);
+	do
+		tail->next = next;
+	while (!__atomic_compare_exchange_n(& global, & next, head, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+template<typename T> T * Pool<T>::allocSlow(size_t index) noexcept
+{
+	// Take the whole global free list, or carve a new slab
+	Slot * head = __atomic_exchange_n(& global, nullptr, __ATOMIC_ACQUIRE);
+	if (!head)
+	{
+		Slab * slab = static_cast<Slab *>(operator new (slabSize, std::align_val_t(slabSize)));
+		if (!slab)
+			return nullptr;
+
+		slab->pool = this;
+		slab->next = __atomic_load_n(& slabs, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(& slabs, & slab->next, slab, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+		byte * slots = reinterpret_cast<byte *>(slab) + slotOffset;
+		for (size_t i = 0; i + 1 < slabSlots; ++ i)
+			reinterpret_cast<Slot *>(slots + i * slotSize)->next = reinterpret_cast<Slot *>(slots + (i + 1) * slotSize);
+		reinterpret_cast<Slot *>(slots + (slabSlots - 1) * slotSize)->next = nullptr;
+		head = reinterpret_cast<Slot *>(slots);
+	}
+
+	// Keep the first slot, and move the rest to the free list of the thread (or back to the global one)
+	Slot * rest = head->next;
+	if (rest)
+	{
+		size_t count = 1;
+		Slot * tail = rest;
+		for (; tail->next; tail = tail->next)
+			count += 1;
+
+		if (index < mem::maxThreads)
+		{
+			Cache & cache = caches[index];
+			cache.head = rest;
+			cache.tail = tail;
+			cache.count = count;
+		}
+		else
+		{
+			release(rest, tail);
+		}
+	}
+	return reinterpret_cast<T *>(head);
+}
+
+// Close namespace "nx"
+}
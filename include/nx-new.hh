@@ -4,10 +4,171 @@
 // Local includes
 #include "nx-core.hh"
 
+// Namespace "nx::mem" - Interface of the global allocator
+namespace nx { namespace mem {
+
+/**
+	[STRUCT] Stats - Allocation statistics of the global allocator
+
+	Counters are kept per thread, and only summed up when they are read, so the numbers of concurrently running threads
+	may be slightly out of date. Small allocations are counted with the block size of their size class, large ones with
+	the usable size reported by malloc. The peak is tracked on the slow paths, so it may miss peaks shorter than what
+	the thread caches can hold.
+
+	Only glibc and Windows report the usable size of a malloc block. On other targets large blocks from malloc (between
+	the small limit and the map threshold) are still counted in largeAllocCount and largeFreeCount, but not in the byte
+	counters: largeBytes, liveBytes and peakBytes leave them out. Directly mapped blocks are counted everywhere.
+ */
+struct Stats
+{
+	// Number of size classes
+	static constexpr size_t classes = 40;
+
+	// Histogram entry of a size class
+	struct SizeClass
+	{
+		size_t size;
+		uint64_t allocCount;
+		uint64_t freeCount;
+	};
+
+	// Live bytes (allocated and not yet freed), and the highest value it has reached
+	size_t liveBytes;
+	size_t peakBytes;
+
+	// Live bytes of small (size class) and large allocations
+	size_t smallBytes;
+	size_t largeBytes;
+
+	// Number of allocations and deallocations
+	uint64_t allocCount;
+	uint64_t freeCount;
+
+	// Number of large allocations and deallocations
+	uint64_t largeAllocCount;
+	uint64_t largeFreeCount;
+
+	// Memory requested from the OS for small allocations
+	size_t mappedBytes;
+
+	// Histogram of small allocations
+	SizeClass sizeClasses[classes];
+};
+
+// Collect the allocation statistics of all threads
+Stats stats() noexcept;
+
+/**
+	Sampling heap profiler
+
+	While the profiler is running, roughly one allocation is sampled for every `interval` bytes allocated (the interval
+	between samples is random, and the average is `interval`). Sampled allocations are recorded with a short stack trace
+	into a ring buffer of `capacity` events, along with their deallocation. When the ring buffer is full, the oldest
+	events are overwritten. The buffers are allocated by the first start, and kept for the life of the process (threads
+	may still write into them for a moment after the profiler is stopped), so every later start must use the same
+	capacity.
+
+	The profile can be dumped at any time (even after the profiler is stopped). The binary format is a sequence of
+	native endian 64 bit words:
+
+		header:   ProfileMagic, interval, number of events, number of overwritten events
+		event:    kind (1 = alloc, 2 = free), address, size, depth, frames[depth]
+		end:      0, 0, 0, 0
+		
+	followed by the contents of /proc/self/maps (on Linux). The nx-heap-report tool converts it to a pprof heap profile.
+ */
+
+// Magic number at the start of profiles ("NXHEAP01")
+constexpr uint64_t ProfileMagic = 0x313050414548584e;
+
+// Start the profiler (fails, if it's already running, if the buffers cannot be allocated, or if the capacity differs from
+// the first start)
+bool startProfiler(size_t interval = 512 * 1024, size_t capacity = 16384) noexcept;
+
+// Stop the profiler (recorded events are kept, until the next start)
+void stopProfiler() noexcept;
+
+// Write the recorded events to a file
+bool dumpProfile(const char * filename) noexcept;
+
+/**
+	Large allocations
+
+	Allocations up to 32 KB are served from size classes. Larger ones are passed on to malloc, except for those of at
+	least the map threshold, which are mapped directly from the OS, and returned to it (unmapped) when they are freed.
+
+	Directly mapped allocations can be backed by huge pages. Transparent huge pages are requested (with madvise) for
+	mappings of at least 2 MB. Explicit huge pages (hugetlb) must be reserved by the system, and normal pages are used,
+	when none are available. Huge pages are only supported on Linux.
+ */
+
+// Huge page modes of directly mapped allocations
+enum class HugePages { none, transparent, hugetlb };
+
+// Default map threshold
+constexpr size_t defaultMapThreshold = 1024 * 1024;
+
+// Set the size, from which allocations are mapped directly from the OS (0 disables direct mapping)
+void setMapThreshold(size_t threshold) noexcept;
+
+// Set the huge page mode of directly mapped allocations (the default is none)
+void setHugePages(HugePages mode) noexcept;
+
+/**
+	Memory pressure
+
+	When an allocation fails, the reclaim callbacks are called (in the order they were added), so caches, pools and
+	arenas of the application can release memory. The allocation is retried after every callback, that released some
+	memory, and null is only returned, when all of them were called. Allocations made by the callbacks themselves fail
+	without calling the callbacks again.
+
+	Callbacks get the size of the failed allocation, and return the number of bytes they released (an estimate is fine,
+	only zero and non-zero are distinguished). They can be called from any thread, even concurrently, so they must be
+	thread safe. Removing a callback waits for the callbacks running in other threads to return, so it must not be done
+	while holding a lock, that the callback takes.
+ */
+
+// Reclaim callback - releases memory, and returns the number of bytes released
+typedef size_t (* ReclaimCallback)(size_t size, void * context);
+
+// Maximum number of reclaim callbacks
+constexpr size_t maxReclaimCallbacks = 32;
+
+// Add a reclaim callback (fails, if there are too many callbacks)
+bool addReclaimCallback(ReclaimCallback callback, void * context = nullptr) noexcept;
+
+// Remove a reclaim callback (added with the same context)
+void removeReclaimCallback(ReclaimCallback callback, void * context = nullptr) noexcept;
+
+// Call the reclaim callbacks, as if an allocation of the given size failed, and return the number of bytes released
+size_t reclaim(size_t size) noexcept;
+
+// Close namespace "nx::mem"
+}}
+
 // Disable -Wterminate : gcc over warns on templates
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wterminate"
 
+// Alignment tag of the aligned `new` and `delete` operators (declared by <new> since C++17)
+namespace std { enum class align_val_t : size_t; }
+
+// Sized `delete` operators (implicitly declared since C++14)
+#if !defined(__cpp_sized_deallocation)
+void operator delete (void * obj, size_t size) noexcept;
+void operator delete [] (void * obj, size_t size) noexcept;
+#endif
+
+// Aligned `new` and `delete` operators (implicitly declared since C++17)
+#if !defined(__cpp_aligned_new)
+void * operator new (size_t size, std::align_val_t align) noexcept;
+void * operator new [] (size_t size, std::align_val_t align) noexcept;
+void operator delete (void * obj, std::align_val_t align) noexcept;
+void operator delete [] (void * obj, std::align_val_t align) noexcept;
+void operator delete (void * obj, size_t size, std::align_val_t align) noexcept;
+void operator delete [] (void * obj, size_t size, std::align_val_t align) noexcept;
+#endif
+
 // Placement `new` operator for nx (takes an additional nothing)
 inline void * operator new (size_t, void * ptr, nx::Nothing) noexcept {return ptr;}
 
@@ -120,16 +281,68 @@ template<typename T> constexpr bool hasNoexceptCopy()
 template<typename T> constexpr bool hasNoexceptMove()
 	{return impl::hasNoexceptMove<T>(0);}
 
-// Allocate memory for a type, without constructing them
+// Check for trivial default constructor (creating the object can be skipped)
+template<typename T> constexpr bool hasTrivialCreate()
+	{return __is_trivially_constructible(T);}
+
+// Check for trivial copy and move constructors (the object can be created by copying its bytes)
+template<typename T> constexpr bool hasTrivialCopyCreate()
+	{return __is_trivially_constructible(T, const T &);}
+template<typename T> constexpr bool hasTrivialMoveCreate()
+	{return __is_trivially_constructible(T, T &&);}
+
+// Check for trivial copy assignment (the object can be assigned by copying its bytes)
+template<typename T> constexpr bool hasTrivialCopy()
+	{return __is_trivially_assignable(T &, const T &);}
+
+// Check for trivial destructor (destroying the object can be skipped)
+template<typename T> constexpr bool hasTrivialDestroy()
+	{return __has_trivial_destructor(T);}
+
+// Namespace "nx::type::proto"
+namespace proto {
+
+// [META FUNCTION] IsTriviallyRelocatable - True, if objects can be moved to an other address by copying their bytes
+// (without calling the move constructor and the destructor). Types can opt in by specializing this template, as
+// nx::type::proto::IsTriviallyRelocatable.
+template<typename T> struct IsTriviallyRelocatable { static constexpr bool result = __is_trivially_copyable(T); };
+
+// Close namespace "nx::type::proto"
+}
+
+// Check if the type is trivially relocatable
+template<typename T> constexpr bool isTriviallyRelocatable()
+	{return proto::IsTriviallyRelocatable<T>::result;}
+
+// Alignment of the memory returned by the unaligned `new` operators
+constexpr size_t newAlignment = 16;
+
+// Allocate memory for a type, without constructing them (over-aligned types use the aligned `new` operator)
 template<typename T> inline T * alloc(size_t size = sizeof(T)) noexcept
 {
+	if (alignof(T) > newAlignment)
+		return static_cast<T*>(operator new (size, std::align_val_t(alignof(T))));
 	return static_cast<T*>(operator new (size));
 }
 
 // Deallocate the memory of a type, without deconstructing them
 template<typename T> inline T * free(T * obj) noexcept
 {
-	operator delete (static_cast<void *>(obj)); return nullptr;
+	if (alignof(T) > newAlignment)
+		operator delete (static_cast<void *>(obj), std::align_val_t(alignof(T)));
+	else
+		operator delete (static_cast<void *>(obj));
+	return nullptr;
+}
+
+// Deallocate the memory of a type, without deconstructing them (size must be the same, as the one given to alloc)
+template<typename T> inline T * free(T * obj, size_t size) noexcept
+{
+	if (alignof(T) > newAlignment)
+		operator delete (static_cast<void *>(obj), size, std::align_val_t(alignof(T)));
+	else
+		operator delete (static_cast<void *>(obj), size);
+	return nullptr;
 }
 
 // Confirm that allocations were successful. TODO: Throws <?> exception if any of the pointers are null
@@ -181,7 +394,8 @@ template<typename T> inline T * createArray(size_t n) noexcept(noexcept(new T[n]
 // Create an array of objects in place (with exception handling)
 template<typename T> inline T * createArrayAt(T * ptr, size_t n) noexcept(hasNoexceptCreate<T>() || !exceptions)
 {
-	if (n == 0)
+	// Default initialization of trivial types does nothing
+	if (n == 0 || hasTrivialCreate<T>())
 		return ptr;
 	
 	if (hasNoexceptCreate<T>() || !exceptions)
@@ -220,6 +434,12 @@ template<typename T> inline T * createArrayAtByCopy(T * ptr, const T * array, si
 {
 	if (n == 0)
 		return ptr;
+
+	if (hasTrivialCopyCreate<T>())
+	{
+		__builtin_memcpy(static_cast<void *>(ptr), static_cast<const void *>(array), n * sizeof(T));
+		return ptr;
+	}
 	
 	if (hasNoexceptCreate<T, T &>() || !exceptions)
 	{
@@ -257,6 +477,12 @@ template<typename T> inline EnableIf<hasNoexceptCreate<T, T>(), T *> createArray
 {
 	if (n == 0)
 		return ptr;
+
+	if (hasTrivialMoveCreate<T>())
+	{
+		__builtin_memcpy(static_cast<void *>(ptr), static_cast<const void *>(array), n * sizeof(T));
+		return ptr;
+	}
 	
 	for (size_t i = 0; i < n; ++ i)
 		new (ptr + i, nothing) T(static_cast<T &&>(array[i]));		
@@ -300,7 +526,7 @@ template<typename T> inline void destroyArray(T * ptr, size_t n) noexcept(noexce
 // Destroy an array of objects in place
 template<typename T> inline void destroyArrayAt(T * ptr, size_t n) noexcept(hasNoexceptDestroy<T>())
 {
-	if (n == 0)
+	if (n == 0 || hasTrivialDestroy<T>())
 		return;
 	
 	if (hasNoexceptDestroy<T>() || !exceptions)
@@ -335,5 +561,110 @@ template<typename T> inline void destroyArrayAt(T * ptr, size_t n) noexcept(hasN
 // Close namespace "nx::type"
 }}
 
+// Namespace "nx::mem"
+namespace nx { namespace mem {
+
+/**
+	Allocator policies
+
+	Containers take an allocator policy as a template parameter, and keep an instance of it (which takes up no space,
+	if the policy is an empty class). Policies have two methods:
+
+		void * alloc(size_t size, size_t align) noexcept;             - Returns null, if the allocation failed
+		void free(void * ptr, size_t size, size_t align) noexcept;    - Size and alignment are the same as in alloc
+
+	Policies can also have a realloc method, which is used to resize buffers of trivially relocatable types:
+
+		void * realloc(void * ptr, size_t oldSize, size_t newSize, size_t align) noexcept;
+
+	Heap is the default policy (the global allocator), and Ref<R> forwards to an allocator object, like an Arena.
+ */
+
+// Allocate zeroed memory (freed like memory from `new`). Large blocks are fresh pages from the OS (or from calloc),
+// which are zero already, so they are not touched until they are used.
+void * allocateZeroed(size_t size, size_t align = type::newAlignment) noexcept;
+
+// Resize a block of memory, keeping its contents (oldSize is the size, that the block was allocated with). Blocks are
+// resized in place, when possible, and directly mapped blocks are grown by remapping their pages. Returns null, and
+// keeps the block intact, if the allocation failed.
+void * reallocate(void * ptr, size_t oldSize, size_t newSize, size_t align = type::newAlignment) noexcept;
+
+// [CLASS] Heap - Allocator policy of the global allocator
+struct Heap
+{
+	void * alloc(size_t size, size_t align) noexcept
+	{
+		if (align > type::newAlignment)
+			return operator new (size, std::align_val_t(align));
+		return operator new (size);
+	}
+
+	void free(void * ptr, size_t size, size_t align) noexcept
+	{
+		if (align > type::newAlignment)
+			operator delete (ptr, size, std::align_val_t(align));
+		else
+			operator delete (ptr, size);
+	}
+
+	void * realloc(void * ptr, size_t oldSize, size_t newSize, size_t align) noexcept
+		{return reallocate(ptr, oldSize, newSize, align);}
+};
+
+// [CLASS] Ref - Allocator policy, that forwards to an allocator object (the object must outlive the containers)
+template<typename R> struct Ref
+{
+	// Referenced allocator
+	R * resource;
+
+	// Constructor
+	Ref(R & resource) noexcept
+		: resource(& resource) {}
+
+	void * alloc(size_t size, size_t align) noexcept
+		{return resource->alloc(size, align);}
+	void free(void * ptr, size_t size, size_t align) noexcept
+		{resource->free(ptr, size, align);}
+
+	// Only available, if the allocator object has it
+	template<typename S = R> auto realloc(void * ptr, size_t oldSize, size_t newSize, size_t align) noexcept
+		-> decltype(static_cast<S *>(nullptr)->realloc(ptr, oldSize, newSize, align))
+		{return resource->realloc(ptr, oldSize, newSize, align);}
+};
+
+// Namespace "nx::mem::impl"
+namespace impl {
+
+// Resize with the realloc method of the policy
+template<typename A> auto reallocateWith(A & allocator, void * ptr, size_t oldSize, size_t newSize, size_t align, int) noexcept
+	-> decltype(allocator.realloc(ptr, oldSize, newSize, align))
+{
+	return allocator.realloc(ptr, oldSize, newSize, align);
+}
+
+// Resize by allocating a new block, and copying the contents
+template<typename A> void * reallocateWith(A & allocator, void * ptr, size_t oldSize, size_t newSize, size_t align, long) noexcept
+{
+	void * result = allocator.alloc(newSize, align);
+	if (result && ptr)
+	{
+		__builtin_memcpy(result, ptr, oldSize < newSize ? oldSize : newSize);
+		allocator.free(ptr, oldSize, align);
+	}
+	return result;
+}
+
+// Close namespace "nx::mem::impl"
+}
+
+// Resize a block of memory with an allocator policy (policies without realloc get a new block, and the contents are copied)
+template<typename A> inline void * reallocateWith(A & allocator, void * ptr, size_t oldSize, size_t newSize, size_t align) noexcept
+{
+	return impl::reallocateWith(allocator, ptr, oldSize, newSize, align, 0);
+}
+
+// Close namespace "nx::mem"
+}}
+
 // Restore GCC diagnostic options
 #pragma GCC diagnostic pop
@@ -6,9 +6,27 @@
 
 // Namespace "nx"
 namespace nx {
-	
-// Open variation of unique_ptr, the inner pointer is public and freely accessable
-template<typename T> struct UniquePtr
+
+// Default deleter of UniquePtr, wraps a delete expression
+template<typename T> struct DefaultDelete
+{
+	void operator () (T * ptr) const noexcept
+		{delete ptr;}
+};
+
+// Default deleter of UniquePtr for arrays, wraps a delete array expression
+template<typename T> struct DefaultDelete<T[]>
+{
+	void operator () (T * ptr) const noexcept
+		{delete [] ptr;}
+};
+
+// Checks if the pointer of UniquePtr<U, E> can be moved into UniquePtr<T, D> (same deleter, or both are the default)
+template<typename T, typename D, typename U, typename E> constexpr bool isMovablePtr()
+	{return type::isEqual<D, E>() || (type::isEqual<D, DefaultDelete<T>>() && type::isEqual<E, DefaultDelete<U>>());}
+
+// Open variation of unique_ptr, the inner pointer is public and freely accessable (the deleter D must be stateless)
+template<typename T, typename D = DefaultDelete<T>> struct UniquePtr
 {
 	// Referenced type
 	using Type = T;
@@ -19,29 +37,29 @@ template<typename T> struct UniquePtr
 	explicit UniquePtr(T * ptr) noexcept
 		: pointer(ptr) {}
 	~UniquePtr() noexcept
-		{delete pointer;}
+		{D()(pointer);}
 	
 	// Copy operators deleted
-	UniquePtr(const UniquePtr<T> &) = delete;
-	UniquePtr<T> & operator = (const UniquePtr<T> &) = delete;
+	UniquePtr(const UniquePtr<T, D> &) = delete;
+	UniquePtr<T, D> & operator = (const UniquePtr<T, D> &) = delete;
 	
 	// Move operators
-	UniquePtr(UniquePtr<T> && ptr) noexcept
+	UniquePtr(UniquePtr<T, D> && ptr) noexcept
 		: pointer(ptr.release()) {}
-	UniquePtr<T> & operator = (UniquePtr<T> && ptr) noexcept
+	UniquePtr<T, D> & operator = (UniquePtr<T, D> && ptr) noexcept
 		{return reset(ptr.release());}
 
-	// Template move operators
-	template<typename U> UniquePtr(UniquePtr<U> && ptr) noexcept
+	// Template move operators (the deleters must be the same, or both must be the default one)
+	template<typename U, typename E, typename = EnableIf<isMovablePtr<T, D, U, E>()>> UniquePtr(UniquePtr<U, E> && ptr) noexcept
 		: pointer(ptr.release()) {}
-	template<typename U> UniquePtr<T> & operator = (UniquePtr<U> && ptr) noexcept
+	template<typename U, typename E, typename = EnableIf<isMovablePtr<T, D, U, E>()>> UniquePtr<T, D> & operator = (UniquePtr<U, E> && ptr) noexcept
 		{return reset(ptr.release());}
 	
 	// Operators & methods
 	T * release() noexcept
 		{T * ptr = pointer; pointer = nullptr; return ptr;}
-	UniquePtr<T> & reset(T * ptr = nullptr)
-		{delete pointer; pointer = ptr; return * this;}
+	UniquePtr<T, D> & reset(T * ptr = nullptr)
+		{D()(pointer); pointer = ptr; return * this;}
 	T * operator -> () const noexcept
 		{return pointer;}
 	T & operator * () const noexcept
@@ -66,7 +84,7 @@ template<typename T> struct UniquePtr
 };
 
 // Open variation of unique_ptr for arrays, the inner pointer is public and freely accessable
-template<typename T> struct UniquePtr<T[]>
+template<typename T, typename D> struct UniquePtr<T[], D>
 {
 	// Referenced type
 	using Type = T;
@@ -77,29 +95,29 @@ template<typename T> struct UniquePtr<T[]>
 	explicit UniquePtr(T * ptr) noexcept
 		: pointer(ptr) {}
 	~UniquePtr() noexcept
-		{delete [] pointer;}
+		{D()(pointer);}
 	
 	// Copy operators deleted
-	UniquePtr(const UniquePtr<T[]> &) = delete;
-	UniquePtr<T[]> & operator = (const UniquePtr<T[]> &) = delete;
+	UniquePtr(const UniquePtr<T[], D> &) = delete;
+	UniquePtr<T[], D> & operator = (const UniquePtr<T[], D> &) = delete;
 
 	// Move operators
-	UniquePtr(UniquePtr<T[]> && ptr) noexcept
+	UniquePtr(UniquePtr<T[], D> && ptr) noexcept
 		: pointer(ptr.release()) {}
-	UniquePtr<T> & operator = (UniquePtr<T[]> && ptr) noexcept
+	UniquePtr<T[], D> & operator = (UniquePtr<T[], D> && ptr) noexcept
 		{return this->reset(ptr.release());}
 
 	// Template move operators
-	template<typename U> UniquePtr(UniquePtr<U> && ptr) noexcept
+	template<typename U> UniquePtr(UniquePtr<U, D> && ptr) noexcept
 		: pointer(ptr.release()) {}
-	template<typename U> UniquePtr<T[]> & operator = (UniquePtr<U> && ptr) noexcept
+	template<typename U> UniquePtr<T[], D> & operator = (UniquePtr<U, D> && ptr) noexcept
 		{return this->reset(ptr.release());}
 
 	// Operators & methods
 	T * release() noexcept
 		{T * ptr = pointer; pointer = nullptr; return ptr;}
-	UniquePtr<T[]> & reset(T * ptr = nullptr) noexcept
-		{delete [] pointer; pointer = ptr; return * this;}
+	UniquePtr<T[], D> & reset(T * ptr = nullptr) noexcept
+		{D()(pointer); pointer = ptr; return * this;}
 	T & operator [] (size_t i) const noexcept
 		{return pointer[i];}
 	
@@ -107,6 +125,11 @@ template<typename T> struct UniquePtr<T[]>
 	T * pointer;
 };
 
+// UniquePtr can be relocated (it's just a pointer)
+namespace type { namespace proto {
+	template<typename T, typename D> struct IsTriviallyRelocatable<UniquePtr<T, D>> { static constexpr bool result = true; };
+}}
+
 // Creates a new object, wrapped in a UniquePtr
 template<typename T, typename ... TS> inline UniquePtr<T> make(TS && ... args)
 {
@@ -125,5 +148,11 @@ template<typename T, typename ... TS> inline UniquePtr<Array<T>> makeArrayFrom(T
 	return UniquePtr<Array<T>>(Array<T>::createFrom(list...));
 }
 
+// Creates a new raw array, wrapped in a UniquePtr
+template<typename T, typename L = size_t, size_t A = alignof(T)> inline UniquePtr<RawArray<T, L, A>> makeRawArray(size_t n)
+{
+	return UniquePtr<RawArray<T, L, A>>(RawArray<T, L, A>::create(n));
+}
+
 // Close namespace "nx"
 }
@@ -89,8 +89,8 @@ inline uint64_t mutateSeed(uint64_t & seed) noexcept
 // Create a random array
 template<typename R> Array<uint64_t> * createRandomArray(R & random, size_t length) noexcept
 {
-	// Create array
-	auto result = Array<uint64_t>::create(length);
+	// Create array (every item is overwritten, so they are not initialized)
+	auto result = Array<uint64_t>::createUninitialized(length);
 	
 	// Fill array with random data
 	if (result)
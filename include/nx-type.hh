@@ -11,6 +11,9 @@
 // Namespace "nx"
 namespace nx {
 
+// [FUNCTION] param - Same as std::declval, a value of any type for unevaluated expressions (never defined)
+template<typename T> T && param() noexcept;
+
 // Namespace "nx::type" - Type system related functionality
 namespace type {
 
@@ -331,10 +334,22 @@ public:
 	Array * clone() const
 		{return create(*this);}
 
+	// Arrays have a custom size, so they must be deallocated without one (or sized delete would use sizeof(Array))
+	static void operator delete (void * ptr) noexcept
+		{nx::type::free(static_cast<Array *>(ptr));}
+
 	// Allocators
 	static Array * create(size_t n);
 	template<typename U> static Array * create(const Array<U> * array);
 	template<typename... TS> static Array * createFrom(TS && ... list);
+
+	// Allocators for trivial types - items are left uninitialized (they must be written before they are read), or zeroed
+	static Array * createUninitialized(size_t n);
+	static Array * createZeroed(size_t n);
+
+	// Allocators with an allocator policy (arrays created with these must be destroyed with the same policy)
+	template<typename A> static Array * create(size_t n, A allocator);
+	template<typename A> static void destroy(Array * array, A allocator);
 	
 	// Fill arrays
 	static void fill(Array & array, const T & item);
@@ -350,6 +365,83 @@ private:
 		: length(n) {}
 };
 
+/**
+	[CLASS] RawArray - Array without a virtual table
+
+	The only header in front of the items is the length, and its type can be chosen (eg. uint32_t for small arrays).
+	The items are aligned to A, if it's larger than their natural alignment (eg. 64 for cache line aligned items).
+	RawArrays are owned like Arrays (eg. with UniquePtr<RawArray<T>>), but they are destroyed without a virtual call.
+ */
+template<typename T, typename L = size_t, size_t A = alignof(T)> class RawArray
+{
+public:
+	// Element and length type
+	using Type = T;
+	using Length = L;
+
+	// Fields
+	const L length;
+	alignas(T) alignas(A) T data[0];
+
+	// Destructor
+	~RawArray() noexcept(nx::type::hasNoexceptDestroy<T>())
+		{nx::type::destroyArrayAt<T>(data, length);}
+
+	// Copy operators deleted (only the header would be copied, not the items after it)
+	RawArray(const RawArray &) = delete;
+	RawArray & operator = (const RawArray &) = delete;
+
+	// Iterators - mostly for foreach
+	inline T * begin()
+		{return data;}
+	inline const T * begin() const
+		{return data;}
+	inline T * end()
+		{return data + length;}
+	inline const T * end() const
+		{return data + length;}
+
+	// Operators & methods
+	inline T & operator [] (size_t i)
+		{return data[i];}
+	inline const T & operator [] (size_t i) const
+		{return data[i];}
+
+	// RawArrays have a custom size, so they must be deallocated without one
+	static void operator delete (void * ptr) noexcept
+		{nx::type::free(static_cast<RawArray *>(ptr));}
+
+	// Allocators (return null, if the length doesn't fit into L)
+	static RawArray * create(size_t n);
+	static RawArray * create(const RawArray * array);
+	template<typename... TS> static RawArray * createFrom(TS && ... list);
+
+	// Allocators for trivial types - items are left uninitialized (they must be written before they are read), or zeroed
+	static RawArray * createUninitialized(size_t n);
+	static RawArray * createZeroed(size_t n);
+
+	// Allocators with an allocator policy (arrays created with these must be destroyed with the same policy)
+	template<typename AP> static RawArray * create(size_t n, AP allocator);
+	template<typename AP> static void destroy(RawArray * array, AP allocator);
+
+private:
+	// Constructors
+	RawArray(size_t n)
+		: length(static_cast<L>(n)) {}
+
+	// Size of an array of n items (0, if the length doesn't fit)
+	static size_t sizeOf(size_t n) noexcept
+		{return static_cast<L>(n) == n ? sizeof(RawArray) + n * sizeof(T) : 0;}
+
+	// Create the header in the memory (items are left uninitialized)
+	static RawArray * createAt(void * ptr, size_t n) noexcept
+		{return ptr ? new (ptr, nothing) RawArray(n) : nullptr;}
+
+	// Allocate an array with uninitialized items
+	static RawArray * allocate(size_t n) noexcept
+		{return sizeOf(n) ? createAt(nx::type::alloc<RawArray>(sizeOf(n)), n) : nullptr;}
+};
+
 // Tuple class - only 2, 3 and 4 element tuples are defined here. For generic tuples include <nx-util.hh>
 template<typename ... TS> struct Tuple;
 
@@ -479,6 +571,27 @@ template<typename X, typename Y, typename Z, typename W> struct Tuple<X, Y, Z, W
 template<typename... TS> constexpr Tuple<type::RemoveAnyReference<TS>...> makeTuple(TS && ... args)
 	{return Tuple<type::RemoveAnyReference<TS>...>(forward<TS>(args)...);}
 
+// Tuple comparison - item by item (so tuples can be keys of hash containers)
+template<typename X, typename Y> inline bool operator == (const Tuple<X, Y> & a, const Tuple<X, Y> & b)
+	{return a.first == b.first && a.second == b.second;}
+template<typename X, typename Y, typename Z> inline bool operator == (const Tuple<X, Y, Z> & a, const Tuple<X, Y, Z> & b)
+	{return a.first == b.first && a.second == b.second && a.third == b.third;}
+template<typename X, typename Y, typename Z, typename W> inline bool operator == (const Tuple<X, Y, Z, W> & a, const Tuple<X, Y, Z, W> & b)
+	{return a.first == b.first && a.second == b.second && a.third == b.third && a.fourth == b.fourth;}
+template<typename... TS> inline bool operator != (const Tuple<TS...> & a, const Tuple<TS...> & b)
+	{return !(a == b);}
+
+// Multi comparison - item by item
+template<typename T, size_t N> inline bool operator == (const Multi<T, N> & a, const Multi<T, N> & b)
+{
+	for (size_t i = 0; i < N; ++ i)
+		if (!(a.data[i] == b.data[i]))
+			return false;
+	return true;
+}
+template<typename T, size_t N> inline bool operator != (const Multi<T, N> & a, const Multi<T, N> & b)
+	{return !(a == b);}
+
 // ------------------------------------------------------------ //
 //		Array Implementation
 // ------------------------------------------------------------ //
@@ -486,10 +599,44 @@ template<typename... TS> constexpr Tuple<type::RemoveAnyReference<TS>...> makeTu
 // Array allocator - creates a new array
 template<typename T> Array<T> * Array<T>::create(size_t n)
 {
+	return create(n, nx::mem::Heap());
+}
+
+// Array allocator - creates a new array, without initializing the items
+template<typename T> Array<T> * Array<T>::createUninitialized(size_t n)
+{
+	static_assert(__is_trivially_copyable(T), "Only trivially copyable items can be left uninitialized");
 	// Allocate array with custom size
 	auto * result = nx::type::alloc<Array>(sizeof(Array) + n * sizeof(T));
 	// Return null, if the allocation failed
 	if (!result) return nullptr;
+	// Create array (the items are not touched)
+	new (static_cast<void *>(result), nothing) Array(n);
+	// Return result
+	return result;
+}
+
+// Array allocator - creates a new array of zeroed items (large arrays are backed by pages, that the OS zeroes lazily)
+template<typename T> Array<T> * Array<T>::createZeroed(size_t n)
+{
+	static_assert(__is_trivially_copyable(T), "Only trivially copyable items can be zeroed");
+	// Allocate zeroed array with custom size
+	auto * result = static_cast<Array *>(nx::mem::allocateZeroed(sizeof(Array) + n * sizeof(T), alignof(Array)));
+	// Return null, if the allocation failed
+	if (!result) return nullptr;
+	// Create array (the items are not touched)
+	new (static_cast<void *>(result), nothing) Array(n);
+	// Return result
+	return result;
+}
+
+// Array allocator - creates a new array with an allocator policy
+template<typename T> template<typename A> Array<T> * Array<T>::create(size_t n, A allocator)
+{
+	// Allocate array with custom size
+	auto * result = static_cast<Array *>(allocator.alloc(sizeof(Array) + n * sizeof(T), alignof(Array)));
+	// Return null, if the allocation failed
+	if (!result) return nullptr;
 	// Create array (needs to be done in this function, because constructor is private)
 	new (static_cast<void *>(result), nothing) Array(n);
 	// Create elements
@@ -498,6 +645,19 @@ template<typename T> Array<T> * Array<T>::create(size_t n)
 	return result;
 }
 
+// Array deallocator - destroys an array created with an allocator policy
+template<typename T> template<typename A> void Array<T>::destroy(Array<T> * array, A allocator)
+{
+	// Nothing to do for null
+	if (!array) return;
+	// Size of the array (the length is gone after the destructor)
+	size_t size = sizeof(Array) + array->length * sizeof(T);
+	// Destroy elements and array
+	array->~Array();
+	// Release memory
+	allocator.free(array, size, alignof(Array));
+}
+
 template<typename T> template<typename U> Array<T> * Array<T>::create(const Array<U> * array)
 {
 	// Allocate array with custom size
@@ -535,8 +695,31 @@ template<typename T> void Array<T>::fill(Array<T> & array, const T & item)
 }
 template<typename T> void Array<T>::fill(Array<T> & array, size_t off, size_t len, const T & item)
 {
-	for (size_t i = 0; i < len; ++ i)
-		array[off + i] = item;
+	if (!nx::type::hasTrivialCopy<T>() || len < 16)
+	{
+		for (size_t i = 0; i < len; ++ i)
+			array[off + i] = item;
+		return;
+	}
+
+	// Items, whose bytes are all the same (like zero), are filled with memset
+	const unsigned char * bytes = reinterpret_cast<const unsigned char *>(& item);
+	bool pattern = true;
+	for (size_t i = 1; i < sizeof(T) && pattern; ++ i)
+		pattern = bytes[i] == bytes[0];
+	if (pattern)
+	{
+		__builtin_memset(static_cast<void *>(array.data + off), bytes[0], len * sizeof(T));
+		return;
+	}
+
+	// Other items are copied in doubling blocks, so most of the work is done by memcpy
+	array[off] = item;
+	for (size_t done = 1; done < len; done <<= 1)
+	{
+		size_t n = done < len - done ? done : len - done;
+		__builtin_memcpy(static_cast<void *>(array.data + off + done), static_cast<const void *>(array.data + off), n * sizeof(T));
+	}
 }
 
 // Copy arrays
@@ -546,19 +729,73 @@ template<typename T> void Array<T>::copy(const Array<T> & src, Array<T> & dest,
 }
 template<typename T> void Array<T>::copy(const Array<T> & src, size_t src_idx, Array<T> & dest, size_t dest_idx, size_t len)
 {
+	// Trivial items are copied with memmove, which also handles overlapping ranges
+	if (nx::type::hasTrivialCopy<T>())
+	{
+		if (len)
+			__builtin_memmove(static_cast<void *>(dest.data + dest_idx), static_cast<const void *>(src.data + src_idx), len * sizeof(T));
+		return;
+	}
+
 	// copy supports copying inside the same array, and tries to copy forward
 	if (& src != & dest || src_idx >= dest_idx || src_idx + len <= dest_idx)
 	{
 		for (size_t i = 0; i < len; ++ i)
-			dest[src_idx + i] = src[dest_idx + i];
+			dest[dest_idx + i] = src[src_idx + i];
 	}
 	else
 	{
 		for (size_t i = len - 1; i < len; -- i)
-			dest[src_idx + i] = src[dest_idx + i];
+			dest[dest_idx + i] = src[src_idx + i];
 	}
 }
 
+// RawArray allocators
+template<typename T, typename L, size_t A> RawArray<T, L, A> * RawArray<T, L, A>::create(size_t n)
+{
+	return create(n, nx::mem::Heap());
+}
+template<typename T, typename L, size_t A> RawArray<T, L, A> * RawArray<T, L, A>::create(const RawArray * array)
+{
+	RawArray * result = allocate(array->length);
+	if (result)
+		nx::type::createArrayAtByCopy<T>(result->data, array->data, array->length);
+	return result;
+}
+template<typename T, typename L, size_t A> template<typename... TS> RawArray<T, L, A> * RawArray<T, L, A>::createFrom(TS && ... list)
+{
+	RawArray * result = allocate(sizeof...(list));
+	if (result)
+		nx::type::createArrayAtFromList<T>(result->data, list...);
+	return result;
+}
+template<typename T, typename L, size_t A> RawArray<T, L, A> * RawArray<T, L, A>::createUninitialized(size_t n)
+{
+	static_assert(__is_trivially_copyable(T), "Only trivially copyable items can be left uninitialized");
+	return allocate(n);
+}
+template<typename T, typename L, size_t A> RawArray<T, L, A> * RawArray<T, L, A>::createZeroed(size_t n)
+{
+	static_assert(__is_trivially_copyable(T), "Only trivially copyable items can be zeroed");
+	size_t size = sizeOf(n);
+	return createAt(size ? nx::mem::allocateZeroed(size, alignof(RawArray)) : nullptr, n);
+}
+template<typename T, typename L, size_t A> template<typename AP> RawArray<T, L, A> * RawArray<T, L, A>::create(size_t n, AP allocator)
+{
+	size_t size = sizeOf(n);
+	RawArray * result = createAt(size ? allocator.alloc(size, alignof(RawArray)) : nullptr, n);
+	if (result)
+		nx::type::createArrayAt<T>(result->data, n);
+	return result;
+}
+template<typename T, typename L, size_t A> template<typename AP> void RawArray<T, L, A>::destroy(RawArray * array, AP allocator)
+{
+	if (!array) return;
+	size_t size = sizeOf(array->length);
+	array->~RawArray();
+	allocator.free(array, size, alignof(RawArray));
+}
+
 // Close namespace "nx"
 }
 
@@ -4,6 +4,8 @@
 // Local includes
 #include "nx-type.hh"
 #include "nx-meta.hh"
+#include "nx-hash.hh"
+#include "nx-mem.hh"
 
 // Namespace "nx"
 namespace nx {
@@ -19,10 +21,15 @@ template<typename T> class Iterable;
 // Numeric range
 template<typename T> class Range;
 
-// Containers
-template<typename T> class List;
-template<typename T> class Set;
-template<typename K, typename V> class Dictionary;
+// Containers (A is the allocator policy, see <nx-new.hh>)
+template<typename T, typename A = mem::Heap> class List;
+template<typename T, size_t N, typename A = mem::Heap> class SmallList;
+template<typename T, typename A = mem::Heap> class ChunkedList;
+template<typename T, typename A = mem::Heap> class Deque;
+template<typename T, typename A = mem::Heap> class Set;
+template<typename A = mem::Heap> class IntSet;
+template<typename K, typename V, typename A = mem::Heap> class Dictionary;
+template<typename K, typename V, typename A = mem::Heap> class ConcurrentDictionary;
 
 // Optional parameters
 namespace opt {
@@ -169,8 +176,11 @@ inline Range<double> range(double start, double end, double step = 1.0)
 	To achive the same with the single pointer implementation, it would need additional branching to determine the
 	size and capacity of the list, and also introduces some extra indirection. It's a small tradeoff, but a tradeoff
 	nevertheless.
+
+	The memory of the list comes from the allocator policy A. The list inherits from the policy, so stateless policies
+	(like the default mem::Heap) take up no space.
  */
-template<typename T> class List
+template<typename T, typename A> class List : private A
 {
 public:
 	// Element type
@@ -186,16 +196,27 @@ public:
 		T * end;
 	};
 
+	// Allocator type
+	using Allocator = A;
+
 	// Constructors & destructors
 	List() noexcept
 		: n(0), m(0), items(nullptr) {}
+	explicit List(const A & allocator) noexcept
+		: A(allocator), n(0), m(0), items(nullptr) {}
 	List(List && list) noexcept
-		: n(list.n), m(list.m), items(list.items) {list.n = 0; list.m = 0; list.items = nullptr;}
+		: A(list.allocator()), n(list.n), m(list.m), items(list.items) {list.n = 0; list.m = 0; list.items = nullptr;}
 	List(const List & list) noexcept(nx::type::hasNoexceptCreate<T, const T &>());
 	template<typename... TS, typename = EnableIf<nx::type::convertsFromAll<T, TS &&...>()>>
 		explicit List(TS && ... items) noexcept(nx::type::convertsFromAllNoexcept<T, TS &&...>());
 	~List()
-		{nx::type::destroyArrayAt(items, n); nx::type::free(items);}
+		{nx::type::destroyArrayAt(items, n); release(items, m);}
+
+	// Allocator policy
+	inline A & allocator() noexcept
+		{return * this;}
+	inline const A & allocator() const noexcept
+		{return * this;}
 		
 	// Size & capacity
 	inline size_t size() const noexcept
@@ -217,12 +238,23 @@ public:
 	inline const T & get(size_t i, const T & def = T())
 		{return (0 <= i) && (i < n) ? items[i] : def;}
 		
-	// Methods
+	// Methods (the item may be an item of the list)
 	void append(T && item);
 	void append(const T & item);
 	
 	void extend(List && list);
 	void extend(const List & list);
+
+	// Construct items in place (the list grows at most once). The arguments may refer to items of the list, but the
+	// ranges of extend must not be inside it
+	template<typename... TS> T & emplace(TS && ... args);
+	template<typename... TS> T & insert(size_t pos, TS && ... args);
+	void appendN(size_t count, const T & item);
+	void extend(const T * first, size_t count);
+	template<typename I> void extend(I first, I last);
+
+	// Append uninitialized items, and return the first of them (only for trivially copyable items)
+	T * appendUninitialized(size_t count);
 	
 	// NX iterator methods
 	//Iter iter();
@@ -251,218 +283,1222 @@ public:
 		{extend(static_cast<List &&>(list)); return * this;}
 	inline List & operator += (const List & list)
 		{extend(list); return * this;}
+
+	// Swap lists (along with their allocators)
+	template<typename U, typename B> friend void swap(List<U, B> & left, List<U, B> & right) noexcept;
 		
 private:
+	// Allocate and release item buffers
+	inline T * allocate(size_t size) noexcept
+		{return static_cast<T *>(allocator().alloc(sizeof(T) * size, alignof(T)));}
+	inline void release(T * buffer, size_t size) noexcept
+		{if (buffer) allocator().free(buffer, sizeof(T) * size, alignof(T));}
+
+	// Grow the capacity, to make room for at least `size` items
+	void grow(size_t size);
+
 	size_t n;
 	size_t m;
 	T *    items;
 };
 
 // Operations on List
-template<typename T> void swap(List<T> & left, List<T> & right) noexcept;
-
+template<typename T, typename A> void swap(List<T, A> & left, List<T, A> & right) noexcept;
 
-// Set class - TODO: concurrent, lock free, virtual interface
-template<typename T> class Set
-{
-public:
-private:
-};
+// Lists can be relocated, if their allocator can
+namespace type { namespace proto {
+	template<typename T, typename A> struct IsTriviallyRelocatable<List<T, A>> { static constexpr bool result = IsTriviallyRelocatable<A>::result; };
+}}
 
 
-// Dictionary class - Associative array, map, or dictionary -- TODO: concurrect, lock free, virtual interface
 /**
-	[CLASS] Dictionary - Associative array (also sometimes called "map")
-	
-	Implementation:
-	
-	Dictionary is implemented using two arrays. The first contains nodes, these nodes combine the key, the hash of the
-	key, and the associated value. The second is the index table, this is a hash table, that contains indices into the
-	node list.
-	
-	The index table can contain 8, 16, 32 or 64 bit indices, depending on its size. If it's current size is less than
-	128, 32768 or 2^31 bytes, it will use 8, 16 or 32 bit indices respectively, otherwise it' use 64bit indices
-	(but by then just the index table will take up 8 GB of memory).
+	[CLASS] SmallList - List with inline storage for N items
+
+	The first N items are stored inside the list itself, so short lists don't allocate any memory. When the list grows
+	beyond N items, the items are moved to a buffer from the allocator policy A, and from then on it works just like
+	List. `compact` moves the items back inline, when they fit again.
+
+	Unlike List, moving a SmallList moves the items one by one, while they are stored inline. SmallLists are not
+	trivially relocatable, because the item pointer may point into the list itself.
  */
-template<typename K, typename V> class Dictionary
+template<typename T, size_t N, typename A> class SmallList : private A
 {
 public:
-	// Entry type
-	using Entry = Pair<K, V>;
+	static_assert(N > 0, "SmallList needs room for at least one inline item");
+
+	// Element type
+	using Type = T;
+
+	// Allocator type
+	using Allocator = A;
+
+	// Number of inline items
+	static constexpr size_t inlineCapacity = N;
 
 	// Constructors & destructors
-	Dictionary() noexcept = default;
-	Dictionary(Dictionary && dict) noexcept;
-	Dictionary(const Dictionary & dict);
-	~Dictionary();
-		
+	SmallList() noexcept
+		: n(0), m(N), items(local()) {}
+	explicit SmallList(const A & allocator) noexcept
+		: A(allocator), n(0), m(N), items(local()) {}
+	SmallList(SmallList && list) noexcept(nx::type::hasNoexceptCreate<T, T>())
+		: A(list.allocator()), n(0), m(N), items(local()) {take(list);}
+	SmallList(const SmallList & list) noexcept(nx::type::hasNoexceptCreate<T, const T &>());
+	~SmallList()
+		{nx::type::destroyArrayAt(items, n); release(items, m);}
+
+	// Allocator policy
+	inline A & allocator() noexcept
+		{return * this;}
+	inline const A & allocator() const noexcept
+		{return * this;}
+
 	// Size & capacity
-	size_t size() const noexcept
+	inline size_t size() const noexcept
 		{return n;}
-	size_t capacity() const noexcept
+	inline size_t capacity() const noexcept
 		{return m;}
-		
+	inline bool isInline() const noexcept
+		{return items == local();}
+
+	void resize(size_t n);
+	void reserve(size_t n);
+	void compact();
+
+	// Data
+	inline T * data() noexcept
+		{return items;}
+	inline const T * data() const noexcept
+		{return items;}
+
 	// Getters
-	const V & get(const K & key, const V & def = V());
-	
-	// Methods
-	
-	// NX iterator methods
-	// Iter iter();
-	
+	inline const T & get(size_t i, const T & def = T())
+		{return i < n ? items[i] : def;}
+
+	// Methods (the appended item may be an item of the list, and the list may be extended by itself)
+	void append(T && item);
+	void append(const T & item);
+
+	void extend(SmallList && list);
+	void extend(const SmallList & list);
+
 	// STL iterator methods
-	
+	inline T * begin() noexcept
+		{return items;}
+	inline const T * begin() const noexcept
+		{return items;}
+	inline T * end() noexcept
+		{return items + n;}
+	inline const T * end() const noexcept
+		{return items + n;}
+
 	// Copy & move
-	
+	SmallList & operator = (SmallList && list) noexcept(nx::type::hasNoexceptCreate<T, T>());
+	SmallList & operator = (const SmallList & list);
+
 	// Operators
-	V & operator [] (const K & key);
-	const V & operator [] (const K & key) const;
+	inline T & operator [] (size_t i) noexcept
+		{return items[i];}
+	inline const T & operator [] (size_t i) const noexcept
+		{return items[i];}
+
+	inline SmallList & operator += (SmallList && list)
+		{extend(static_cast<SmallList &&>(list)); return * this;}
+	inline SmallList & operator += (const SmallList & list)
+		{extend(list); return * this;}
 
 private:
-	// Node type
-	struct Node;
-	
-	// Size and capacity
-	size_t n = 0;
-	size_t m = 0;
-	
-	// Node list and index
-	Node * nodes = nullptr;
-	byte * table = nullptr;
+	// Inline storage
+	inline T * local() noexcept
+		{return reinterpret_cast<T *>(storage);}
+	inline const T * local() const noexcept
+		{return reinterpret_cast<const T *>(storage);}
+
+	// Allocate and release item buffers (the inline storage is never released)
+	inline T * allocate(size_t size) noexcept
+		{return static_cast<T *>(allocator().alloc(sizeof(T) * size, alignof(T)));}
+	inline void release(T * buffer, size_t size) noexcept
+		{if (buffer != local()) allocator().free(buffer, sizeof(T) * size, alignof(T));}
+
+	// Move the items to a new buffer of the given capacity (the inline storage, if it's N)
+	void relocate(size_t size);
+	// Take the items of an other list, which is left empty (this list must be empty and inline)
+	void take(SmallList & list);
+	// Grow the capacity, to make room for at least `size` items
+	void grow(size_t size);
+
+	size_t n;
+	size_t m;
+	T *    items;
+	alignas(T) byte storage[sizeof(T) * N];
 };
 
 
-// ------------------------------------------------------------ //
-//		Optional parameters
-// ------------------------------------------------------------ //
+/**
+	[CLASS] ChunkedList - Append only list with stable item addresses
 
-// Namespace "nx::opt"
-namespace opt {
+	Items are stored in chunks of geometrically growing size: the first chunk holds 16 items, and every chunk after it
+	holds twice as many as the previous one. Growing the list allocates a new chunk, and never moves the items, so
+	pointers to them stay valid, and appending never has to copy the whole list.
 
-// [CLASS] In - Optional input only parameter. Can be constructed from "nothing". (For mandatory input, use "const T &") 
-template<typename T> class In
+	Indexing is O(1): the chunk of an index is found from its highest bit. Iterating over the chunks (with `chunk` or
+	`forEachChunk`) gives contiguous arrays, so loops over them can be vectorized.
+ */
+template<typename T, typename A> class ChunkedList : private A
 {
 public:
-	// Constructors
-	In(const T & obj) noexcept
-		: ptr(& obj) {}
-	In(Nothing) noexcept
-		: ptr(nullptr) {}
+	// Element type
+	using Type = T;
 
-	// Operator
-	operator bool() noexcept
-		{return ptr;}
+	// Allocator type
+	using Allocator = A;
 
-	// Use parameter
-	bool provided() const noexcept
-		{return ptr;}
-	const T & get(const T & def) const noexcept
-		{return ptr ? * ptr : def;}
+	// Size of the first chunk (a power of two), and the maximum number of chunks
+	static constexpr size_t chunkBits = 4;
+	static constexpr size_t maxChunks = 40;
 
-private:
-	// Pointer to object
-	const T * ptr;
-};
+	// Iterator type - steps through the items of a chunk, and jumps to the next chunk at its end
+	template<typename U> class Iter
+	{
+	public:
+		Iter(U * const * chunks, U * current, U * limit, U * last) noexcept
+			: chunks(chunks), k(0), current(current), limit(limit), last(last) {}
+
+		inline U & operator * () const noexcept
+			{return * current;}
+		inline U * operator -> () const noexcept
+			{return current;}
+		inline Iter & operator ++ () noexcept
+		{
+			if (++ current == limit && current != last)
+			{
+				current = chunks[++ k];
+				limit = current + ChunkedList::chunkSize(k);
+			}
+			return * this;
+		}
+		inline bool operator == (const Iter & other) const noexcept
+			{return current == other.current;}
+		inline bool operator != (const Iter & other) const noexcept
+			{return current != other.current;}
 
+	private:
+		U * const * chunks;
+		size_t k;
+		U * current;
+		U * limit;
+		U * last;
+	};
 
-// [CLASS] Out - Optional output only parameter. Can be constructed from "nothing". (For mandatory output, use "T &") 
-template<typename T> class Out
-{
-	// Constructors
-	Out(T & obj) noexcept
-		: ptr(& obj) {}
-	Out(Nothing) noexcept
-		: ptr(nullptr) {}
+	// Constructors & destructors
+	ChunkedList() noexcept
+		: n(0), c(0) {}
+	explicit ChunkedList(const A & allocator) noexcept
+		: A(allocator), n(0), c(0) {}
+	ChunkedList(ChunkedList && list) noexcept
+		: A(list.allocator()), n(0), c(0) {take(list);}
+	ChunkedList(const ChunkedList & list)
+		: A(list.allocator()), n(0), c(0) {extend(list);}
+	~ChunkedList()
+		{clear(); release();}
+
+	// Allocator policy
+	inline A & allocator() noexcept
+		{return * this;}
+	inline const A & allocator() const noexcept
+		{return * this;}
 
-	// Operator
-	operator bool() noexcept
-		{return ptr;}
+	// Size & capacity
+	inline size_t size() const noexcept
+		{return n;}
+	inline size_t capacity() const noexcept
+		{return c ? chunkStart(c) : 0;}
 
-	// Use parameter
-	bool provided() const noexcept
-		{return ptr;}
-	void set(T && val) const noexcept(nx::type::hasNoexceptMove<T>())
-		{if (ptr) (* ptr) = rvalue(val);}
-	void set(const T & val) const noexcept(nx::type::hasNoexceptCopy<T>())
-		{if (ptr) (* ptr) = val;}
+	void reserve(size_t n);
+	void clear() noexcept(nx::type::hasNoexceptDestroy<T>());
 
-private:
-	// Pointer to object
-	const T * ptr;
-};
+	// Getters
+	inline const T & get(size_t i, const T & def = T()) const
+		{return i < n ? (* this)[i] : def;}
 
+	// Methods
+	void append(T && item);
+	void append(const T & item);
+	template<typename... TS> T & emplace(TS && ... args);
 
-// [CLASS] InOut - Optional input-output parameter. Can be constructed from "nothing". (For mandatory input-output, use "T &")
-template<typename T> class InOut
-{
-	// Constructors
-	InOut(T & obj) noexcept
-		: ptr(& obj) {}
-	InOut(Nothing) noexcept
-		: ptr(nullptr) {}
+	void extend(const T * first, size_t count);
+	void extend(const ChunkedList & list);
 
-	// Operator
-	operator bool() noexcept
-		{return ptr;}
-		
-	// Use parameter
-	bool provided() const noexcept
-		{return ptr;}
-	void set(T && val) const noexcept(nx::type::hasNoexceptMove<T>())
-		{if (ptr) (* ptr) = rvalue(val);}
-	void set(const T & val) const noexcept(nx::type::hasNoexceptCopy<T>())
-		{if (ptr) (* ptr) = val;}
-	const T & get(const T & def) const noexcept
-		{return ptr ? * ptr : def;}
+	// Chunks - the used part of chunk k is [chunk(k), chunk(k) + chunkLength(k))
+	inline size_t chunkCount() const noexcept
+		{return n ? chunkOf(n - 1) + 1 : 0;}
+	inline T * chunk(size_t k) noexcept
+		{return chunks[k];}
+	inline const T * chunk(size_t k) const noexcept
+		{return chunks[k];}
+	inline size_t chunkLength(size_t k) const noexcept
+		{return n - chunkStart(k) < chunkSize(k) ? n - chunkStart(k) : chunkSize(k);}
+
+	// Call `f(T * items, size_t count)` on every chunk
+	template<typename F> void forEachChunk(F && f);
+	template<typename F> void forEachChunk(F && f) const;
+
+	// STL iterator methods
+	inline Iter<T> begin() noexcept
+		{return n ? Iter<T>(chunks, chunks[0], chunks[0] + chunkSize(0), endPointer()) : end();}
+	inline Iter<const T> begin() const noexcept
+		{return n ? Iter<const T>(chunks, chunks[0], chunks[0] + chunkSize(0), endPointer()) : end();}
+	inline Iter<T> end() noexcept
+		{return Iter<T>(chunks, endPointer(), endPointer(), endPointer());}
+	inline Iter<const T> end() const noexcept
+		{return Iter<const T>(chunks, endPointer(), endPointer(), endPointer());}
+
+	// Copy & move
+	ChunkedList & operator = (ChunkedList && list) noexcept;
+	ChunkedList & operator = (const ChunkedList & list);
+
+	// Operators
+	inline T & operator [] (size_t i) noexcept
+		{size_t k = chunkOf(i); return chunks[k][i - chunkStart(k)];}
+	inline const T & operator [] (size_t i) const noexcept
+		{size_t k = chunkOf(i); return chunks[k][i - chunkStart(k)];}
 
 private:
-	// Pointer to object
-	const T * ptr;
-};
+	// Chunk of an index, the index of the first item in a chunk, and the size of a chunk
+	static inline size_t chunkOf(size_t i) noexcept
+		{return 63 - __builtin_clzll(static_cast<unsigned long long>((i >> chunkBits) + 1));}
+	static inline size_t chunkStart(size_t k) noexcept
+		{return ((size_t(1) << k) - 1) << chunkBits;}
+	static inline size_t chunkSize(size_t k) noexcept
+		{return size_t(1) << (k + chunkBits);}
+
+	// Pointer past the last item
+	inline T * endPointer() const noexcept
+		{return n ? & const_cast<ChunkedList *>(this)->operator [] (n - 1) + 1 : nullptr;}
+
+	// Make room for the next item
+	inline T * slot()
+		{if (n == capacity()) reserve(n + 1); return & (* this)[n];}
+
+	// Release the chunks (the items must already be destroyed)
+	void release() noexcept;
+	// Take the chunks of an other list, which is left empty (this list must have no chunks)
+	void take(ChunkedList & list) noexcept;
 
+	size_t n;
+	size_t c;
+	T *    chunks[maxChunks];
+};
 
-// Close namespace "nx::opt"
-}
 
+/**
+	[CLASS] Deque - Double ended queue on a ring buffer
 
-// ------------------------------------------------------------ //
-//		Iterators 
-// ------------------------------------------------------------ //
+	Items can be added and removed at both ends in O(1). The capacity of the ring buffer is a power of two, so indices
+	are wrapped with a mask. Just like List, an empty deque doesn't allocate any memory.
 
-// Namespace "nx::iter"
-namespace iter {
-	
-// [CLASS] Legacy - Coverts singular iterators to legacy C++ iterators, that will work with foreach
-template<typename T> class Legacy
+	The items are stored in at most two contiguous spans: `headSpan` (from the front, up to the end of the buffer) and
+	`tailSpan` (from the start of the buffer). Bulk pushes and pops copy in at most two pieces, which is memcpy for
+	trivially copyable items. The deque is not thread safe.
+ */
+template<typename T, typename A> class Deque : private A
 {
 public:
 	// Element type
-	using Type = decltype(param<T>().last());
+	using Type = T;
+
+	// Allocator type
+	using Allocator = A;
+
+	// Iterator type
+	template<typename U> class Iter
+	{
+	public:
+		Iter(U * items, size_t mask, size_t i) noexcept
+			: items(items), mask(mask), i(i) {}
+
+		inline U & operator * () const noexcept
+			{return items[i & mask];}
+		inline U * operator -> () const noexcept
+			{return items + (i & mask);}
+		inline Iter & operator ++ () noexcept
+			{++ i; return * this;}
+		inline bool operator == (const Iter & other) const noexcept
+			{return i == other.i;}
+		inline bool operator != (const Iter & other) const noexcept
+			{return i != other.i;}
+
+	private:
+		U * items;
+		size_t mask;
+		size_t i;
+	};
+
+	// Constructors & destructors
+	Deque() noexcept
+		: h(0), n(0), m(0), items(nullptr) {}
+	explicit Deque(const A & allocator) noexcept
+		: A(allocator), h(0), n(0), m(0), items(nullptr) {}
+	Deque(Deque && deque) noexcept
+		: A(deque.allocator()), h(deque.h), n(deque.n), m(deque.m), items(deque.items) {deque.h = deque.n = deque.m = 0; deque.items = nullptr;}
+	Deque(const Deque & deque);
+	~Deque()
+		{clear(); release(items, m);}
+
+	// Allocator policy
+	inline A & allocator() noexcept
+		{return * this;}
+	inline const A & allocator() const noexcept
+		{return * this;}
+
+	// Size & capacity
+	inline size_t size() const noexcept
+		{return n;}
+	inline size_t capacity() const noexcept
+		{return m;}
+
+	void reserve(size_t n);
+	void clear() noexcept(nx::type::hasNoexceptDestroy<T>());
+
+	// Items at the ends (the deque must not be empty)
+	inline T & front() noexcept
+		{return items[h];}
+	inline const T & front() const noexcept
+		{return items[h];}
+	inline T & back() noexcept
+		{return items[(h + n - 1) & (m - 1)];}
+	inline const T & back() const noexcept
+		{return items[(h + n - 1) & (m - 1)];}
+
+	// Add items
+	void pushBack(T && item);
+	void pushBack(const T & item);
+	void pushFront(T && item);
+	void pushFront(const T & item);
+	template<typename... TS> T & emplaceBack(TS && ... args);
+	template<typename... TS> T & emplaceFront(TS && ... args);
+
+	// Remove items (the deque must not be empty)
+	T popBack() noexcept(nx::type::hasNoexceptCreate<T, T>());
+	T popFront() noexcept(nx::type::hasNoexceptCreate<T, T>());
+
+	// Bulk operations - copy items to the back, and move items from the front into uninitialized memory (count must not
+	// be larger than the size)
+	void pushBack(const T * first, size_t count);
+	void popFront(T * out, size_t count);
+
+	// Contiguous spans of the items (the tail span is empty, unless the items wrap around the end of the buffer)
+	inline Pair<T *, size_t> headSpan() noexcept
+		{return Pair<T *, size_t>(items + h, h + n <= m ? n : m - h);}
+	inline Pair<T *, size_t> tailSpan() noexcept
+		{return Pair<T *, size_t>(items, h + n <= m ? 0 : h + n - m);}
+	inline Pair<const T *, size_t> headSpan() const noexcept
+		{return Pair<const T *, size_t>(items + h, h + n <= m ? n : m - h);}
+	inline Pair<const T *, size_t> tailSpan() const noexcept
+		{return Pair<const T *, size_t>(items, h + n <= m ? 0 : h + n - m);}
+
+	// STL iterator methods
+	inline Iter<T> begin() noexcept
+		{return Iter<T>(items, m - 1, h);}
+	inline Iter<const T> begin() const noexcept
+		{return Iter<const T>(items, m - 1, h);}
+	inline Iter<T> end() noexcept
+		{return Iter<T>(items, m - 1, h + n);}
+	inline Iter<const T> end() const noexcept
+		{return Iter<const T>(items, m - 1, h + n);}
+
+	// Copy & move
+	Deque & operator = (Deque && deque) noexcept;
+	Deque & operator = (const Deque & deque);
+
+	// Operators
+	inline T & operator [] (size_t i) noexcept
+		{return items[(h + i) & (m - 1)];}
+	inline const T & operator [] (size_t i) const noexcept
+		{return items[(h + i) & (m - 1)];}
 
-	// Constructor
-	template<typename... TS> Legacy(TS && ... args)
-		: iterator(forward<TS>(args) ...) {}
-		
-	// Legacy C++ iterator interface
-	Type operator * () const
-		{return iterator.last();}
-	Legacy & operator ++ ()
-		{iterator.next(); return * this;}
-	bool operator != (const Legacy &)
-		{return iterator.hasNext();}
-	
 private:
-	T iterator;
+	// Allocate and release item buffers
+	inline T * allocate(size_t size) noexcept
+		{return static_cast<T *>(allocator().alloc(sizeof(T) * size, alignof(T)));}
+	inline void release(T * buffer, size_t size) noexcept
+		{if (buffer) allocator().free(buffer, sizeof(T) * size, alignof(T));}
+
+	// Make room for more items
+	inline void grow(size_t size)
+		{if (size > m) reserve(size);}
+
+	// Index of the first item, size, capacity (0 or a power of two), and the ring buffer
+	size_t h;
+	size_t n;
+	size_t m;
+	T *    items;
 };
 
-// [CLASS] Virtual - Wraps a simple iterator, and creates one with a virtual interface
-template<typename T> class Virtual : public Iterator<decltype(param<T>().last())>
+
+/**
+	[CLASS] Set - Hash set with open addressing
+
+	Items are hashed with nx::hash (see <nx-hash.hh>), and compared with operator ==. Just like List, an empty set
+	doesn't allocate any memory. The order of iteration is unspecified.
+
+	Implementation:
+
+	The items are stored in an array of slots, and every slot has a control byte (see HashGroup in <nx-hash.hh>). The
+	low bits of the hash select the first group of 8 slots, and groups are probed in order, until a group with an
+	empty slot. The tag of the hash is compared to every control byte of a group at once, so items are only compared,
+	when their tags match.
+
+	Erased slots are marked deleted, unless their group has an empty slot (then no probe ever went past the group). The
+	set is rehashed, when the used (full and deleted) slots would go above 7/8 of the capacity: deleted slots are
+	dropped, and the capacity is doubled, if the set is at least half full. The bulk operations hash a batch of items
+	first, and prefetch their groups, so the cache misses of the batch overlap.
+ */
+template<typename T, typename A> class Set : private A
 {
 public:
 	// Element type
-	using Type = decltype(param<T>().last());
-	
-	// Constructor
+	using Type = T;
+
+	// Allocator type
+	using Allocator = A;
+
+	// Iterator type (skips free slots)
+	template<typename U> class Iter
+	{
+	public:
+		Iter(const byte * control, U * slot, U * last) noexcept
+			: control(control), slot(slot), last(last) {skip();}
+
+		inline U & operator * () const noexcept
+			{return * slot;}
+		inline U * operator -> () const noexcept
+			{return slot;}
+		inline Iter & operator ++ () noexcept
+			{++ control; ++ slot; skip(); return * this;}
+		inline bool operator == (const Iter & other) const noexcept
+			{return slot == other.slot;}
+		inline bool operator != (const Iter & other) const noexcept
+			{return slot != other.slot;}
+
+	private:
+		inline void skip() noexcept
+			{while (slot != last && (* control & 0x80)) {++ control; ++ slot;}}
+
+		const byte * control;
+		U * slot;
+		U * last;
+	};
+
+	// Constructors & destructors
+	Set() noexcept
+		: n(0), d(0), m(0), control(nullptr), slots(nullptr) {}
+	explicit Set(const A & allocator) noexcept
+		: A(allocator), n(0), d(0), m(0), control(nullptr), slots(nullptr) {}
+	Set(Set && set) noexcept
+		: A(set.allocator()), n(set.n), d(set.d), m(set.m), control(set.control), slots(set.slots) {set.forget();}
+	Set(const Set & set);
+	~Set()
+		{clear(); release();}
+
+	// Allocator policy
+	inline A & allocator() noexcept
+		{return * this;}
+	inline const A & allocator() const noexcept
+		{return * this;}
+
+	// Size & capacity (the set rehashes, when it would be more than 7/8 full)
+	inline size_t size() const noexcept
+		{return n;}
+	inline size_t capacity() const noexcept
+		{return m;}
+
+	void reserve(size_t size);
+	void clear() noexcept(nx::type::hasNoexceptDestroy<T>());
+
+	// Getters
+	inline bool contains(const T & item) const noexcept
+		{return locate(item, hashOf(item)) != notFound;}
+
+	// Methods - insert returns true if the item is new, erase returns true if the item was found
+	bool insert(T && item);
+	bool insert(const T & item);
+	bool erase(const T & item) noexcept(nx::type::hasNoexceptDestroy<T>());
+
+	// Bulk operations - insertAll returns the number of new items, containsAll returns true if every item is found
+	size_t insertAll(const T * items, size_t count);
+	bool containsAll(const T * items, size_t count) const noexcept;
+
+	// STL iterator methods
+	inline Iter<T> begin() noexcept
+		{return Iter<T>(control, slots, slots + m);}
+	inline Iter<const T> begin() const noexcept
+		{return Iter<const T>(control, slots, slots + m);}
+	inline Iter<T> end() noexcept
+		{return Iter<T>(control + m, slots + m, slots + m);}
+	inline Iter<const T> end() const noexcept
+		{return Iter<const T>(control + m, slots + m, slots + m);}
+
+	// Copy & move
+	Set & operator = (Set && set) noexcept;
+	Set & operator = (const Set & set);
+
+private:
+	// Slot of missing items, and the number of items hashed at once by the bulk operations
+	static constexpr size_t notFound = ~size_t(0);
+	static constexpr size_t batch = 8;
+
+	// Hash of an item
+	static inline uintptr_t hashOf(const T & item) noexcept
+		{return static_cast<uintptr_t>(nx::hash(item));}
+
+	// Offset of the slots after the control bytes, and the size of the arrays, for a capacity
+	static inline size_t offsetOf(size_t capacity) noexcept
+		{return (capacity + alignof(T) - 1) & ~(alignof(T) - 1);}
+	static inline size_t sizeOf(size_t capacity) noexcept
+		{return offsetOf(capacity) + sizeof(T) * capacity;}
+	static constexpr size_t align = alignof(T) > 8 ? alignof(T) : 8;
+
+	// First group of a hash
+	inline const byte * groupOf(uintptr_t h) const noexcept
+		{return control + (h & (m / impl::HashGroup::size - 1)) * impl::HashGroup::size;}
+
+	// Find the slot of an item (returns notFound, if the item is not in the set), and a free slot for a new item
+	size_t locate(const T & item, uintptr_t h) const noexcept;
+	size_t vacancy(uintptr_t h) const noexcept;
+
+	// Insert an item, that is not in the set yet (there must be room for it)
+	template<typename U> void place(U && item, uintptr_t h);
+
+	// Make room for another item, and move the items to new arrays with the given capacity
+	void grow();
+	void rehash(size_t capacity);
+
+	// Release the arrays (the items must already be destroyed), or forget them after they are moved
+	void release() noexcept;
+	inline void forget() noexcept
+		{n = d = m = 0; control = nullptr; slots = nullptr;}
+
+	// Number of items, number of deleted slots, and capacity (0 or a power of two, at least a group)
+	size_t n;
+	size_t d;
+	size_t m;
+
+	// Control bytes, and slots (in the same allocation)
+	byte * control;
+	T *    slots;
+};
+
+
+/**
+	[CLASS] IntSet - Compressed set of 32 bit integers (roaring bitmap)
+
+	Values are split into 64K chunks by their high 16 bits, and every chunk, that has values in it, is a container of
+	the low 16 bits. Small containers are sorted arrays (up to 4096 values), large ones are bitmaps (8 KB, whatever the
+	number of values). `optimize` turns containers into runs (sorted ranges), where that's smaller: a range of a million
+	consecutive IDs takes 16 runs of 4 bytes, instead of 16 bitmaps. Containers are modified as arrays or bitmaps, so a
+	run container is expanded, when it's changed.
+
+	The set algebra works on matching containers, so chunks without values in the other set cost nothing. Bitmaps are
+	combined a word at a time in plain loops, that the compiler vectorizes, and counted with popcount. Values are
+	visited in ascending order by `forEach`.
+ */
+template<typename A> class IntSet : private A
+{
+public:
+	// Allocator type
+	using Allocator = A;
+
+	// Largest array container, and the number of words in a bitmap container
+	static constexpr uint32_t arrayLimit = 4096;
+	static constexpr size_t bitmapWords = 1024;
+
+	// Constructors & destructors
+	IntSet() noexcept
+		: n(0) {}
+	explicit IntSet(const A & allocator) noexcept
+		: A(allocator), containers(allocator), n(0) {}
+	IntSet(IntSet && set) noexcept
+		: A(set.allocator()), containers(rvalue(set.containers)), n(set.n) {set.n = 0;}
+	IntSet(const IntSet & set);
+	~IntSet()
+		{clear();}
+
+	// Allocator policy
+	inline A & allocator() noexcept
+		{return * this;}
+	inline const A & allocator() const noexcept
+		{return * this;}
+
+	// Number of values (cardinality)
+	inline size_t size() const noexcept
+		{return n;}
+
+	// Getters
+	bool contains(uint32_t value) const noexcept;
+
+	// Methods - add returns true if the value is new, remove returns true if the value was found
+	bool add(uint32_t value);
+	bool remove(uint32_t value);
+	void addAll(const uint32_t * values, size_t count);
+	void clear() noexcept;
+
+	// Convert containers to runs, where they are smaller that way
+	void optimize();
+
+	// Set algebra (in place), and the size of the intersection (without computing it)
+	void unite(const IntSet & set);
+	void intersect(const IntSet & set);
+	void subtract(const IntSet & set);
+	size_t intersectionSize(const IntSet & set) const noexcept;
+
+	// Call a function with every value, in ascending order
+	template<typename F> void forEach(F && func) const;
+
+	// Copy & move
+	IntSet & operator = (IntSet && set) noexcept;
+	IntSet & operator = (const IntSet & set);
+
+private:
+	// Kind of a container, and a range of values in a run container
+	enum class Kind : uint8_t {array, bitmap, runs};
+	struct Run
+	{
+		uint16_t first;
+		uint16_t last;
+	};
+
+	// Container of the values with the same high 16 bits
+	struct Container
+	{
+		uint16_t key;
+		Kind     kind;
+		uint32_t count;
+		uint32_t length;
+		uint32_t capacity;
+		union
+		{
+			uint16_t * values;
+			Run *      runs;
+			uint64_t * words;
+		};
+	};
+
+	// Allocate and release container data
+	template<typename U> U * allocate(size_t count);
+	template<typename U> inline void release(U * data, size_t count) noexcept
+		{allocator().free(data, sizeof(U) * count, alignof(U));}
+	uint64_t * allocateWords();
+	void release(Container & c) noexcept;
+
+	// Index of the container of a key (or where it would be)
+	size_t find(uint16_t key) const noexcept;
+
+	// Containers - create, copy, test, and visit values
+	Container createArray(uint16_t key, uint32_t capacity);
+	Container copy(const Container & c);
+	static bool has(const Container & c, uint16_t low) noexcept;
+	template<typename F> static void each(const Container & c, F && func);
+
+	// Bitmap helpers - the bitmap of any container, ranges of bits, and the number of bits set
+	static void fill(const Container & c, uint64_t * words) noexcept;
+	static void setRange(uint64_t * words, uint16_t first, uint16_t last) noexcept;
+	static uint32_t popcount(const uint64_t * words) noexcept;
+	static size_t runCount(const Container & c) noexcept;
+
+	// Convert containers between kinds (expand turns runs into an array or a bitmap, shrink turns small bitmaps into
+	// arrays)
+	void toArray(Container & c);
+	void toBitmap(Container & c);
+	void toRuns(Container & c, size_t count);
+	void expand(Container & c);
+	void shrink(Container & c);
+
+	// Add and remove low bits in a container
+	bool addTo(Container & c, uint16_t low);
+	bool removeFrom(Container & c, uint16_t low);
+
+	// Combine a container with the matching container of an other set
+	void uniteWith(Container & c, const Container & other);
+	void intersectWith(Container & c, const Container & other);
+	void subtractWith(Container & c, const Container & other);
+	static uint32_t intersectionSize(const Container & c, const Container & other) noexcept;
+
+	// Containers sorted by key, and the number of values
+	List<Container, A> containers;
+	size_t n;
+};
+
+
+// Dictionary class - Associative array, map, or dictionary -- TODO: concurrect, lock free, virtual interface
+/**
+	[CLASS] Dictionary - Associative array (also sometimes called "map")
+
+	Keys are hashed with nx::hash (see <nx-hash.hh>), and compared with operator ==. Iteration visits the entries in
+	insertion order. Inserting an existing key replaces its value, but keeps its position.
+
+	Implementation:
+
+	Dictionary is implemented using two arrays. The first contains nodes, these nodes combine the key, the hash of the
+	key, and the associated value. The second is the index table, this is a hash table, that contains indices into the
+	node list. Nodes are appended in insertion order. The index table has twice as many slots as the node list, so it's
+	never more than half full.
+
+	Every slot of the index table has a control byte, with 7 bits of the hash in it (see HashGroup in <nx-hash.hh>). The
+	control bytes are stored together, in front of the indices, and they are probed in groups of 8: the low bits of the
+	hash select the first group, and every slot of a group is compared at once. Only slots with matching control bytes
+	are followed into the node list, so a lookup usually touches one group of control bytes, and one node.
+
+	The index table can contain 8, 16, 32 or 64 bit indices, depending on the capacity of the node list. If it's at
+	most 256, 65536 or 2^32 nodes, it will use 8, 16 or 32 bit indices respectively, otherwise it' use 64bit indices
+	(but by then just the index table will take up over 100 GB of memory). Small dictionaries have small index tables, that
+	stay in the cache.
+
+	Erasing an entry destroys it, but leaves its node (and its slot in the index table) in place. When the node list is
+	full, it's compacted if at least half of the nodes are erased, and doubled otherwise. Both arrays come from the
+	allocator policy A, just like in List.
+
+	The bulk lookups (getMany and containsMany) work on batches of keys in three passes: the keys are hashed, and their
+	groups are prefetched, then the first matching node of every key is prefetched, and only then are the keys resolved.
+	The cache misses of a batch overlap, instead of following each other.
+ */
+template<typename K, typename V, typename A> class Dictionary : private A
+{
+	// Node type
+	struct Node;
+
+public:
+	// Entry type
+	using Entry = Pair<K, V>;
+
+	// Allocator type
+	using Allocator = A;
+
+	// Iterator type (skips erased nodes)
+	template<typename E, typename N> class Iter
+	{
+	public:
+		Iter(N * node, N * last) noexcept
+			: node(node), last(last) {skip();}
+
+		inline E & operator * () const noexcept
+			{return node->entry;}
+		inline E * operator -> () const noexcept
+			{return & node->entry;}
+		inline Iter & operator ++ () noexcept
+			{++ node; skip(); return * this;}
+		inline bool operator == (const Iter & other) const noexcept
+			{return node == other.node;}
+		inline bool operator != (const Iter & other) const noexcept
+			{return node != other.node;}
+
+	private:
+		inline void skip() noexcept
+			{while (node != last && node->hash == 0) ++ node;}
+
+		N * node;
+		N * last;
+	};
+
+	// Constructors & destructors
+	Dictionary() noexcept
+		: n(0), u(0), m(0), nodes(nullptr), table(nullptr) {}
+	explicit Dictionary(const A & allocator) noexcept
+		: A(allocator), n(0), u(0), m(0), nodes(nullptr), table(nullptr) {}
+	Dictionary(Dictionary && dict) noexcept
+		: A(dict.allocator()), n(dict.n), u(dict.u), m(dict.m), nodes(dict.nodes), table(dict.table) {dict.forget();}
+	Dictionary(const Dictionary & dict);
+	~Dictionary()
+		{clear(); release();}
+
+	// Allocator policy
+	inline A & allocator() noexcept
+		{return * this;}
+	inline const A & allocator() const noexcept
+		{return * this;}
+
+	// Size & capacity
+	inline size_t size() const noexcept
+		{return n;}
+	inline size_t capacity() const noexcept
+		{return m;}
+
+	void reserve(size_t size);
+	void compact();
+	void clear() noexcept(nx::type::hasNoexceptDestroy<Entry>());
+
+	// Getters (find returns null, if the key is not in the dictionary)
+	const V & get(const K & key, const V & def = V()) const noexcept;
+	inline V * find(const K & key) noexcept
+		{size_t i = locate(key, hashOf(key)); return i != notFound ? & nodes[i].entry.second : nullptr;}
+	inline const V * find(const K & key) const noexcept
+		{size_t i = locate(key, hashOf(key)); return i != notFound ? & nodes[i].entry.second : nullptr;}
+	inline bool contains(const K & key) const noexcept
+		{return locate(key, hashOf(key)) != notFound;}
+
+	// Bulk getters - getMany stores the address of every value (or null), containsMany stores if every key is found,
+	// both return the number of keys found
+	size_t getMany(const K * keys, size_t count, V ** values) noexcept;
+	size_t getMany(const K * keys, size_t count, const V ** values) const noexcept;
+	size_t containsMany(const K * keys, size_t count, bool * found) const noexcept;
+
+	// Methods - insert returns true if the key is new, erase returns true if the key was found
+	template<typename KK, typename VV> bool insert(KK && key, VV && value);
+	bool erase(const K & key) noexcept(nx::type::hasNoexceptDestroy<Entry>());
+
+	// STL iterator methods (in insertion order)
+	inline Iter<Entry, Node> begin() noexcept
+		{return Iter<Entry, Node>(nodes, nodes + u);}
+	inline Iter<const Entry, const Node> begin() const noexcept
+		{return Iter<const Entry, const Node>(nodes, nodes + u);}
+	inline Iter<Entry, Node> end() noexcept
+		{return Iter<Entry, Node>(nodes + u, nodes + u);}
+	inline Iter<const Entry, const Node> end() const noexcept
+		{return Iter<const Entry, const Node>(nodes + u, nodes + u);}
+
+	// Copy & move
+	Dictionary & operator = (Dictionary && dict) noexcept;
+	Dictionary & operator = (const Dictionary & dict);
+
+	// Operators (the non-const version inserts a default value for missing keys, the const version returns it)
+	V & operator [] (const K & key);
+	const V & operator [] (const K & key) const noexcept;
+
+private:
+	// Index of missing keys, and the number of keys looked up at once by the bulk getters
+	static constexpr size_t notFound = ~size_t(0);
+	static constexpr size_t batch = 8;
+
+	// Hash of a key (0 marks erased nodes, so it's remapped to 1)
+	static inline uintptr_t hashOf(const K & key) noexcept
+		{uintptr_t h = static_cast<uintptr_t>(nx::hash(key)); return h ? h : 1;}
+
+	// Width of an index in the index table, and the size of the index table (control bytes and indices), for a node list
+	// capacity
+	static inline size_t widthOf(size_t capacity) noexcept
+		{return capacity <= 0x100 ? 1 : capacity <= 0x10000 ? 2 : capacity <= 0x100000000 ? 4 : 8;}
+	static inline size_t tableSize(size_t capacity) noexcept
+		{return 2 * capacity * (1 + widthOf(capacity));}
+
+	// Find the node of a key (returns notFound, if the key is not in the dictionary)
+	size_t locate(const K & key, uintptr_t h) const noexcept;
+	template<typename I> size_t locateIn(const K & key, uintptr_t h) const noexcept;
+
+	// Find the nodes of a batch of keys (at most `batch` keys)
+	void locateMany(const K * keys, size_t count, size_t * indices) const noexcept;
+	template<typename I> void locateManyIn(const K * keys, size_t count, size_t * indices) const noexcept;
+
+	// Add a node to the index table
+	void link(size_t i, uintptr_t h) noexcept;
+	template<typename I> void linkIn(size_t i, uintptr_t h) noexcept;
+
+	// Append a new node (the key must not be in the dictionary)
+	template<typename... TS> Entry & append(uintptr_t h, TS && ... args);
+
+	// Move the entries to new arrays with the given capacity, dropping erased nodes
+	void rehash(size_t capacity);
+
+	// Release the arrays (the entries must already be destroyed), or forget them after they are moved
+	void release() noexcept;
+	inline void forget() noexcept
+		{n = u = m = 0; nodes = nullptr; table = nullptr;}
+
+	// Number of entries, number of used nodes (including erased ones), and capacity (0 or a power of two)
+	size_t n;
+	size_t u;
+	size_t m;
+
+	// Node list and index table
+	Node * nodes;
+	byte * table;
+};
+
+
+/**
+	[CLASS] ConcurrentDictionary - Dictionary, that can be used by many threads at once
+
+	Readers take no locks: `get`, `contains` and `forEach` only publish the epoch of the reader in a slot of their own
+	(threads are identified by `mem::threadIndex`), so they scale with the number of cores. Writers lock one of 64
+	stripes, selected by the low bits of the hash, so writers of different keys rarely wait for each other. Keys and
+	values are returned by copy, because they can be replaced at any moment.
+
+	Implementation:
+
+	The table is an array of buckets, with a chain of nodes in each bucket. Nodes are never modified after they are
+	published (except their link to the next node): replacing a value publishes a new node. Nodes unlinked by writers
+	are retired, and released when every reader, that could still see them, is gone (epoch based reclamation).
+
+	The table doubles when it's three quarters full. Resizing is incremental: the new table is linked to the old one,
+	and every writer moves a few buckets, before doing its own work. Moved buckets are marked, so readers follow them to
+	the new table. The bucket count is always a multiple of the stripe count, so the buckets, that a bucket is moved
+	to, are protected by the same stripe.
+
+	Every dictionary has 64 stripes and 64 epoch slots on separate cache lines (8 KB in total), so it's meant for a
+	few large shared tables, not for many small ones.
+ */
+template<typename K, typename V, typename A> class ConcurrentDictionary : private A
+{
+public:
+	// Entry type
+	using Entry = Pair<K, V>;
+
+	// Allocator type
+	using Allocator = A;
+
+	// Number of write locks (and the initial number of buckets)
+	static constexpr size_t stripes = 64;
+
+	// Constructors & destructors (concurrent dictionaries can't be copied or moved)
+	ConcurrentDictionary()
+		{init();}
+	explicit ConcurrentDictionary(const A & allocator)
+		: A(allocator), retired(allocator) {init();}
+	ConcurrentDictionary(const ConcurrentDictionary & dict) = delete;
+	~ConcurrentDictionary();
+
+	// Allocator policy
+	inline A & allocator() noexcept
+		{return * this;}
+	inline const A & allocator() const noexcept
+		{return * this;}
+
+	// Number of entries (exact, only when there are no writers)
+	inline size_t size() const noexcept
+		{return __atomic_load_n(& n, __ATOMIC_RELAXED);}
+
+	// Getters (lock free) - get copies the value into `value`, and returns false if the key is not in the dictionary
+	bool get(const K & key, V & value) const;
+	V get(const K & key, const V & def) const;
+	bool contains(const K & key) const noexcept;
+
+	// Call a function with every entry (lock free, entries changed during the call may or may not be visited)
+	template<typename F> void forEach(F && func) const;
+
+	// Methods - insert returns true if the key is new, erase returns true if the key was found
+	bool insert(const K & key, const V & value);
+	bool erase(const K & key);
+
+	// Copy & move
+	ConcurrentDictionary & operator = (const ConcurrentDictionary & dict) = delete;
+
+private:
+	// Node and table types
+	struct Node;
+	struct Table;
+	class Guard;
+
+	// Spin lock (on a cache line of its own)
+	struct Lock
+	{
+		int  flag;
+		byte padding[64 - sizeof(int)];
+
+		void lock() noexcept;
+		inline void unlock() noexcept
+			{__atomic_store_n(& flag, 0, __ATOMIC_RELEASE);}
+	};
+
+	// Epoch of a reader (0, if the reader is not in the dictionary)
+	struct Slot
+	{
+		uint64_t epoch;
+		byte     padding[64 - sizeof(uint64_t)];
+	};
+
+	// Retired node or table, and the epoch it was retired in
+	struct Retired
+	{
+		Node *   node;
+		Table *  table;
+		uint64_t epoch;
+	};
+
+	// Number of buckets moved by a writer at once, and the number of retired objects that starts a collection
+	static constexpr size_t moveChunk = 16;
+	static constexpr size_t collectLimit = 64;
+
+	// Marks moved buckets
+	static inline Node * moved() noexcept
+		{return reinterpret_cast<Node *>(uintptr_t(1));}
+
+	// Hash of a key
+	static inline uintptr_t hashOf(const K & key) noexcept
+		{return static_cast<uintptr_t>(nx::hash(key));}
+
+	// Allocate the locks, the slots, and the first table
+	void init();
+
+	// Create and release nodes and tables
+	Node * createNode(uintptr_t h, const K & key, const V & value);
+	void releaseNode(Node * node) noexcept;
+	Table * createTable(size_t size);
+	void releaseTable(Table * table) noexcept;
+
+	// Find the node of a key, and the bucket of a hash (in the table, that holds the bucket)
+	const Node * find(const K & key, uintptr_t h) const noexcept;
+	Node ** bucketOf(uintptr_t h) const noexcept;
+
+	// Visit the entries of a bucket (and the buckets it was moved to)
+	template<typename F> void forEachIn(const Table * table, size_t i, F & func) const;
+
+	// Start resizing a table, and move a chunk of buckets to the new table
+	void grow(Table * table);
+	void help();
+	void move(Table * table, size_t i);
+
+	// Retire a node or a table (released after every reader is gone), and release the objects, that can be released
+	void retire(Node * node, Table * table);
+	void collect() noexcept;
+
+	// Current table, number of entries, and the global epoch
+	Table *  table;
+	size_t   n;
+	uint64_t epoch;
+
+	// Readers, that have no slot (threads above mem::maxThreads)
+	mutable size_t others;
+
+	// Write locks, and the epochs of readers
+	Lock * locks;
+	Slot * slots;
+
+	// Retired objects, and the size of the list, that starts the next collection
+	Lock             retireLock;
+	List<Retired, A> retired;
+	size_t           collectAt;
+};
+
+
+// ------------------------------------------------------------ //
+//		Optional parameters
+// ------------------------------------------------------------ //
+
+// Namespace "nx::opt"
+namespace opt {
+
+// [CLASS] In - Optional input only parameter. Can be constructed from "nothing". (For mandatory input, use "const T &") 
+template<typename T> class In
+{
+public:
+	// Constructors
+	In(const T & obj) noexcept
+		: ptr(& obj) {}
+	In(Nothing) noexcept
+		: ptr(nullptr) {}
+
+	// Operator
+	operator bool() noexcept
+		{return ptr;}
+
+	// Use parameter
+	bool provided() const noexcept
+		{return ptr;}
+	const T & get(const T & def) const noexcept
+		{return ptr ? * ptr : def;}
+
+private:
+	// Pointer to object
+	const T * ptr;
+};
+
+
+// [CLASS] Out - Optional output only parameter. Can be constructed from "nothing". (For mandatory output, use "T &") 
+template<typename T> class Out
+{
+	// Constructors
+	Out(T & obj) noexcept
+		: ptr(& obj) {}
+	Out(Nothing) noexcept
+		: ptr(nullptr) {}
+
+	// Operator
+	operator bool() noexcept
+		{return ptr;}
+
+	// Use parameter
+	bool provided() const noexcept
+		{return ptr;}
+	void set(T && val) const noexcept(nx::type::hasNoexceptMove<T>())
+		{if (ptr) (* ptr) = rvalue(val);}
+	void set(const T & val) const noexcept(nx::type::hasNoexceptCopy<T>())
+		{if (ptr) (* ptr) = val;}
+
+private:
+	// Pointer to object
+	const T * ptr;
+};
+
+
+// [CLASS] InOut - Optional input-output parameter. Can be constructed from "nothing". (For mandatory input-output, use "T &")
+template<typename T> class InOut
+{
+	// Constructors
+	InOut(T & obj) noexcept
+		: ptr(& obj) {}
+	InOut(Nothing) noexcept
+		: ptr(nullptr) {}
+
+	// Operator
+	operator bool() noexcept
+		{return ptr;}
+		
+	// Use parameter
+	bool provided() const noexcept
+		{return ptr;}
+	void set(T && val) const noexcept(nx::type::hasNoexceptMove<T>())
+		{if (ptr) (* ptr) = rvalue(val);}
+	void set(const T & val) const noexcept(nx::type::hasNoexceptCopy<T>())
+		{if (ptr) (* ptr) = val;}
+	const T & get(const T & def) const noexcept
+		{return ptr ? * ptr : def;}
+
+private:
+	// Pointer to object
+	const T * ptr;
+};
+
+
+// Close namespace "nx::opt"
+}
+
+
+// ------------------------------------------------------------ //
+//		Iterators 
+// ------------------------------------------------------------ //
+
+// Namespace "nx::iter"
+namespace iter {
+	
+// [CLASS] Legacy - Coverts singular iterators to legacy C++ iterators, that will work with foreach
+template<typename T> class Legacy
+{
+public:
+	// Element type
+	using Type = decltype(param<T>().last());
+
+	// Constructor
+	template<typename... TS> Legacy(TS && ... args)
+		: iterator(forward<TS>(args) ...) {}
+		
+	// Legacy C++ iterator interface
+	Type operator * () const
+		{return iterator.last();}
+	Legacy & operator ++ ()
+		{iterator.next(); return * this;}
+	bool operator != (const Legacy &)
+		{return iterator.hasNext();}
+	
+private:
+	T iterator;
+};
+
+// [CLASS] Virtual - Wraps a simple iterator, and creates one with a virtual interface
+template<typename T> class Virtual : public Iterator<decltype(param<T>().last())>
+{
+public:
+	// Element type
+	using Type = decltype(param<T>().last());
+	
+	// Constructor
 	template<typename... TS> Virtual(TS && ... args)
 		: iterator(forward<TS>(args)...) {}
 	
@@ -470,241 +1506,2525 @@ public:
 	Type last() const override
 		{return iterator.last();}
 
-	Type next() override
-		{return iterator.next();}
-	bool hasNext() override
-		{return iterator.hasNext();}
+	Type next() override
+		{return iterator.next();}
+	bool hasNext() override
+		{return iterator.hasNext();}
+		
+	Type prev() override
+		{return iterator.prev();}
+	bool hasPrev() override
+		{return iterator.hasPrev();}
+
+private:
+	T iterator;
+};
+	
+// Close namespace "nx::iter"
+}
+
+
+// ------------------------------------------------------------ //
+//		Utility functions
+// ------------------------------------------------------------ //
+
+template<typename T> T * addressof(T & obj) noexcept
+	{return reinterpret_cast<T*>(& const_cast<char&>(reinterpret_cast<const volatile char &>(obj)));}
+
+template<typename T> constexpr uintptr_t getaddress(T & obj) noexcept
+	{return & reinterpret_cast<const volatile char &>(obj) - reinterpret_cast<const volatile char *>(nullptr);}
+	
+template<typename T> constexpr T & useaddress(uintptr_t addr) noexcept
+	{return * (reinterpret_cast<const volatile char *>(nullptr) + addr);}
+	
+template<typename T> void swap(T & left, T & right) noexcept(nx::type::hasNoexceptCreate<T, T>() && nx::type::hasNoexceptMove<T>())
+{
+	T l = rvalue(left);
+	T r = rvalue(right);
+	left = rvalue(r);
+	right = rvalue(l);
+}
+
+// ------------------------------------------------------------ //
+//		List Implementation
+// ------------------------------------------------------------ //
+
+template<typename T, typename A> List<T, A>::List(const List<T, A> & list) noexcept(nx::type::hasNoexceptCreate<T, const T &>())
+	: A(list.allocator()), n(0), m(0), items(nullptr)
+{
+	if (list.n > 0)
+	{
+		reserve(list.n);
+		nx::type::createArrayAtByCopy(items, list.items, list.n);
+		n = list.n;
+	}
+}
+
+template<typename T, typename A> void List<T, A>::resize(size_t size)
+{
+	reserve(size);
+	if (size > n)
+	{
+		nx::type::createArrayAt(items + n, size - n);
+		n = size;
+	}
+	if (size < n)
+	{
+		nx::type::destroyArrayAt(items + size, n - size);
+		n = size;
+	}
+}
+
+template<typename T, typename A> void List<T, A>::reserve(size_t size)
+{
+	if (size > m && nx::type::isTriviallyRelocatable<T>())
+	{
+		// The items are moved along with the buffer (in place, or by remapping, if the allocator can)
+		T * buffer = static_cast<T *>(mem::reallocateWith(allocator(), items, sizeof(T) * m, sizeof(T) * size, alignof(T)));
+		nx::type::confirm(buffer);
+
+		m = size;
+		items = buffer;
+	}
+	else if (size > m)
+	{
+		// The new buffer is owned by an empty list, until the items are moved over
+		List list(allocator());
+		list.m = size;
+		list.items = allocate(size);
+		nx::type::confirm(list.items);
+		
+		if (items)
+		{
+			nx::type::createArrayAtByMove(list.items, items, n);
+			nx::type::destroyArrayAt(items, n);
+			release(items, m);
+		}
+		
+		m = size;
+		items = list.items;
+		list.items = nullptr;
+	}
+}
+
+template<typename T, typename A> void List<T, A>::compact()
+{
+	if (items)
+	{
+		if (n > 0 && nx::type::isTriviallyRelocatable<T>())
+		{
+			T * buffer = static_cast<T *>(mem::reallocateWith(allocator(), items, sizeof(T) * m, sizeof(T) * n, alignof(T)));
+			nx::type::confirm(buffer);
+
+			m = n;
+			items = buffer;
+		}
+		else if (n > 0)
+		{
+			List list(allocator());
+			list.m = n;
+			list.items = allocate(n);
+			nx::type::confirm(list.items);
+			
+			nx::type::createArrayAtByMove(list.items, items, n);
+			nx::type::destroyArrayAt(items, n);
+			release(items, m);
+			
+			m = n;
+			items = list.items;
+			list.items = nullptr;
+		}
+		else
+		{
+			release(items, m);
+			m = 0;
+			items = nullptr;
+		}
+	}
+}
+
+template<typename T, typename A> void List<T, A>::append(T && item)
+{
+	emplace(static_cast<T &&>(item));
+}
+
+template<typename T, typename A> void List<T, A>::append(const T & item)
+{
+	emplace(item);
+}
+
+template<typename T, typename A> void List<T, A>::extend(List<T, A> && list)
+{
+	if (list.n > 0)
+	{
+		size_t x = m > 16 ? m : 16;
+		while (n + list.n > x)
+		{
+			x = x + (x >> 1);
+		}
+		reserve(x);
+
+		nx::type::createArrayAtByMove(items + n, list.items, list.n);
+		n += list.n;
+	}
+}
+
+template<typename T, typename A> void List<T, A>::extend(const List<T, A> & list)
+{
+	if (list.n > 0)
+	{
+		size_t x = m > 16 ? m : 16;
+		while (n + list.n > x)
+		{
+			x = x + (x >> 1);
+		}
+		reserve(x);
+
+		nx::type::createArrayAtByCopy(items + n, list.items, list.n);
+		n += list.n;
+	}
+}
+
+template<typename T, typename A> void List<T, A>::grow(size_t size)
+{
+	if (size > m)
+	{
+		// Exponential growth with a 1.5 base (starting from 16)
+		size_t x = m > 16 ? m : 16;
+		while (size > x)
+			x = x + (x >> 1);
+		reserve(x);
+	}
+}
+
+template<typename T, typename A> template<typename... TS> T & List<T, A>::emplace(TS && ... args)
+{
+	if (n + 1 > m)
+	{
+		// The arguments may be items of the list, so the new item is made before the old buffer is freed
+		T item(static_cast<TS &&>(args)...);
+		grow(n + 1);
+		nx::type::createAt(items + n, static_cast<T &&>(item));
+		return items[n ++];
+	}
+	nx::type::createAt(items + n, static_cast<TS &&>(args)...);
+	return items[n ++];
+}
+
+template<typename T, typename A> template<typename... TS> T & List<T, A>::insert(size_t pos, TS && ... args)
+{
+	if (pos >= n)
+		return emplace(static_cast<TS &&>(args)...);
+
+	// The arguments may be items of the list, that are moved by the shift (or freed by the growth), so the new item is
+	// made first
+	T item(static_cast<TS &&>(args)...);
+	grow(n + 1);
+	if (nx::type::isTriviallyRelocatable<T>())
+	{
+		// The items after the position are moved as bytes, and the gap is left unconstructed
+		__builtin_memmove(static_cast<void *>(items + pos + 1), static_cast<const void *>(items + pos), sizeof(T) * (n - pos));
+	}
+	else
+	{
+		// The last item is moved to the end, the others are shifted by move assignment, and the gap is destroyed
+		nx::type::createAt(items + n, static_cast<T &&>(items[n - 1]));
+		for (size_t i = n - 1; i > pos; -- i)
+			items[i] = static_cast<T &&>(items[i - 1]);
+		nx::type::destroyAt(items + pos);
+	}
+	nx::type::createAt(items + pos, static_cast<T &&>(item));
+	n ++;
+	return items[pos];
+}
+
+template<typename T, typename A> void List<T, A>::appendN(size_t count, const T & item)
+{
+	if (n + count > m)
+	{
+		// The item may be in the list, so it's copied before the old buffer is freed
+		T copy(item);
+		grow(n + count);
+		for (size_t i = 0; i < count; ++ i)
+			nx::type::createAt(items + n + i, copy);
+		n += count;
+		return;
+	}
+	for (size_t i = 0; i < count; ++ i)
+		nx::type::createAt(items + n + i, item);
+	n += count;
+}
+
+template<typename T, typename A> void List<T, A>::extend(const T * first, size_t count)
+{
+	if (count > 0)
+	{
+		grow(n + count);
+		nx::type::createArrayAtByCopy(items + n, first, count);
+		n += count;
+	}
+}
+
+template<typename T, typename A> template<typename I> void List<T, A>::extend(I first, I last)
+{
+	// The range is walked twice, so I must be a forward iterator
+	size_t count = 0;
+	for (I i = first; i != last; ++ i)
+		count ++;
+
+	grow(n + count);
+	for (; first != last; ++ first)
+		nx::type::createAt(items + n ++, * first);
+}
+
+template<typename T, typename A> T * List<T, A>::appendUninitialized(size_t count)
+{
+	static_assert(__is_trivially_copyable(T), "Only trivially copyable items can be left uninitialized");
+	grow(n + count);
+	n += count;
+	return items + n - count;
+}
+
+template<typename T, typename A> List<T, A> & List<T, A>::operator = (List<T, A> && list) noexcept
+{
+	swap(* this, list);
+	return * this;
+}
+
+template<typename T, typename A> List<T, A> & List<T, A>::operator = (const List<T, A> & list)
+{
+	// TODO: use operator = here
+	return * this;
+}
+
+template<typename T, typename A> void swap(List<T, A> & left, List<T, A> & right) noexcept
+{
+	swap(left.allocator(), right.allocator());
+	swap(left.n, right.n);
+	swap(left.m, right.m);
+	swap(left.items, right.items);
+}
+
+
+// ------------------------------------------------------------ //
+//		SmallList Implementation
+// ------------------------------------------------------------ //
+
+template<typename T, size_t N, typename A> SmallList<T, N, A>::SmallList(const SmallList<T, N, A> & list) noexcept(nx::type::hasNoexceptCreate<T, const T &>())
+	: A(list.allocator()), n(0), m(N), items(local())
+{
+	if (list.n > 0)
+	{
+		reserve(list.n);
+		nx::type::createArrayAtByCopy(items, list.items, list.n);
+		n = list.n;
+	}
+}
+
+template<typename T, size_t N, typename A> void SmallList<T, N, A>::resize(size_t size)
+{
+	reserve(size);
+	if (size > n)
+	{
+		nx::type::createArrayAt(items + n, size - n);
+		n = size;
+	}
+	if (size < n)
+	{
+		nx::type::destroyArrayAt(items + size, n - size);
+		n = size;
+	}
+}
+
+template<typename T, size_t N, typename A> void SmallList<T, N, A>::reserve(size_t size)
+{
+	if (size > m)
+		relocate(size);
+}
+
+template<typename T, size_t N, typename A> void SmallList<T, N, A>::compact()
+{
+	if (!isInline())
+		relocate(n > N ? n : N);
+}
+
+template<typename T, size_t N, typename A> void SmallList<T, N, A>::relocate(size_t size)
+{
+	if (size == m)
+		return;
+
+	if (size > N && !isInline() && nx::type::isTriviallyRelocatable<T>())
+	{
+		// Heap buffers are resized in place, or by remapping, if the allocator can
+		T * buffer = static_cast<T *>(mem::reallocateWith(allocator(), items, sizeof(T) * m, sizeof(T) * size, alignof(T)));
+		nx::type::confirm(buffer);
+
+		m = size;
+		items = buffer;
+		return;
+	}
+
+	T * buffer = size > N ? allocate(size) : local();
+	nx::type::confirm(buffer);
+
+	nx::type::createArrayAtByMove(buffer, items, n);
+	nx::type::destroyArrayAt(items, n);
+	release(items, m);
+
+	m = size;
+	items = buffer;
+}
+
+template<typename T, size_t N, typename A> void SmallList<T, N, A>::take(SmallList<T, N, A> & list)
+{
+	if (list.isInline())
+	{
+		nx::type::createArrayAtByMove(items, list.items, list.n);
+		nx::type::destroyArrayAt(list.items, list.n);
+		n = list.n;
+	}
+	else
+	{
+		n = list.n;
+		m = list.m;
+		items = list.items;
+		list.m = N;
+		list.items = list.local();
+	}
+	list.n = 0;
+}
+
+template<typename T, size_t N, typename A> void SmallList<T, N, A>::grow(size_t size)
+{
+	if (size > m)
+	{
+		// Exponential growth with a 1.5 base (starting from 16, or N if it's larger)
+		size_t x = m > 16 ? m : 16;
+		while (size > x)
+			x = x + (x >> 1);
+		relocate(x);
+	}
+}
+
+template<typename T, size_t N, typename A> void SmallList<T, N, A>::append(T && item)
+{
+	if (n + 1 > m)
+	{
+		// The item may be in the list, so it's moved out before the old buffer is freed
+		T copy(static_cast<T &&>(item));
+		grow(n + 1);
+		nx::type::createAt(items + n, static_cast<T &&>(copy));
+	}
+	else
+		nx::type::createAt(items + n, static_cast<T &&>(item));
+	n ++;
+}
+
+template<typename T, size_t N, typename A> void SmallList<T, N, A>::append(const T & item)
+{
+	if (n + 1 > m)
+	{
+		// The item may be in the list, so it's copied before the old buffer is freed
+		T copy(item);
+		grow(n + 1);
+		nx::type::createAt(items + n, static_cast<T &&>(copy));
+	}
+	else
+		nx::type::createAt(items + n, item);
+	n ++;
+}
+
+template<typename T, size_t N, typename A> void SmallList<T, N, A>::extend(SmallList<T, N, A> && list)
+{
+	if (list.n > 0)
+	{
+		grow(n + list.n);
+		nx::type::createArrayAtByMove(items + n, list.items, list.n);
+		n += list.n;
+	}
+}
+
+template<typename T, size_t N, typename A> void SmallList<T, N, A>::extend(const SmallList<T, N, A> & list)
+{
+	if (list.n > 0)
+	{
+		grow(n + list.n);
+		nx::type::createArrayAtByCopy(items + n, list.items, list.n);
+		n += list.n;
+	}
+}
+
+template<typename T, size_t N, typename A> SmallList<T, N, A> & SmallList<T, N, A>::operator = (SmallList<T, N, A> && list) noexcept(nx::type::hasNoexceptCreate<T, T>())
+{
+	if (this != & list)
+	{
+		nx::type::destroyArrayAt(items, n);
+		release(items, m);
+		n = 0;
+		m = N;
+		items = local();
+
+		allocator() = list.allocator();
+		take(list);
+	}
+	return * this;
+}
+
+template<typename T, size_t N, typename A> SmallList<T, N, A> & SmallList<T, N, A>::operator = (const SmallList<T, N, A> & list)
+{
+	if (this != & list)
+	{
+		nx::type::destroyArrayAt(items, n);
+		n = 0;
+		reserve(list.n);
+		nx::type::createArrayAtByCopy(items, list.items, list.n);
+		n = list.n;
+	}
+	return * this;
+}
+
+
+// ------------------------------------------------------------ //
+//		ChunkedList Implementation
+// ------------------------------------------------------------ //
+
+template<typename T, typename A> void ChunkedList<T, A>::reserve(size_t size)
+{
+	while (capacity() < size)
+	{
+		T * chunk = c < maxChunks ? static_cast<T *>(allocator().alloc(sizeof(T) * chunkSize(c), alignof(T))) : nullptr;
+		nx::type::confirm(chunk);
+		chunks[c ++] = chunk;
+	}
+}
+
+template<typename T, typename A> void ChunkedList<T, A>::clear() noexcept(nx::type::hasNoexceptDestroy<T>())
+{
+	for (size_t k = chunkCount(); k > 0; -- k)
+		nx::type::destroyArrayAt(chunks[k - 1], chunkLength(k - 1));
+	n = 0;
+}
+
+template<typename T, typename A> void ChunkedList<T, A>::release() noexcept
+{
+	for (size_t k = 0; k < c; ++ k)
+		allocator().free(chunks[k], sizeof(T) * chunkSize(k), alignof(T));
+	c = 0;
+}
+
+template<typename T, typename A> void ChunkedList<T, A>::take(ChunkedList<T, A> & list) noexcept
+{
+	for (size_t k = 0; k < list.c; ++ k)
+		chunks[k] = list.chunks[k];
+	n = list.n;
+	c = list.c;
+	list.n = 0;
+	list.c = 0;
+}
+
+template<typename T, typename A> void ChunkedList<T, A>::append(T && item)
+{
+	nx::type::createAt(slot(), static_cast<T &&>(item));
+	n ++;
+}
+
+template<typename T, typename A> void ChunkedList<T, A>::append(const T & item)
+{
+	nx::type::createAt(slot(), item);
+	n ++;
+}
+
+template<typename T, typename A> template<typename... TS> T & ChunkedList<T, A>::emplace(TS && ... args)
+{
+	T * item = nx::type::createAt(slot(), static_cast<TS &&>(args)...);
+	n ++;
+	return * item;
+}
+
+template<typename T, typename A> void ChunkedList<T, A>::extend(const T * first, size_t count)
+{
+	reserve(n + count);
+
+	// Copied a chunk at a time
+	while (count > 0)
+	{
+		size_t k = chunkOf(n);
+		size_t room = chunkStart(k) + chunkSize(k) - n;
+		size_t part = count < room ? count : room;
+		nx::type::createArrayAtByCopy(chunks[k] + (n - chunkStart(k)), first, part);
+		n += part;
+		first += part;
+		count -= part;
+	}
+}
+
+template<typename T, typename A> void ChunkedList<T, A>::extend(const ChunkedList<T, A> & list)
+{
+	reserve(n + list.n);
+	for (size_t k = 0, count = list.chunkCount(); k < count; ++ k)
+		extend(list.chunks[k], list.chunkLength(k));
+}
+
+template<typename T, typename A> template<typename F> void ChunkedList<T, A>::forEachChunk(F && f)
+{
+	for (size_t k = 0, count = chunkCount(); k < count; ++ k)
+		f(chunks[k], chunkLength(k));
+}
+
+template<typename T, typename A> template<typename F> void ChunkedList<T, A>::forEachChunk(F && f) const
+{
+	for (size_t k = 0, count = chunkCount(); k < count; ++ k)
+		f(static_cast<const T *>(chunks[k]), chunkLength(k));
+}
+
+template<typename T, typename A> ChunkedList<T, A> & ChunkedList<T, A>::operator = (ChunkedList<T, A> && list) noexcept
+{
+	if (this != & list)
+	{
+		clear();
+		release();
+		allocator() = list.allocator();
+		take(list);
+	}
+	return * this;
+}
+
+template<typename T, typename A> ChunkedList<T, A> & ChunkedList<T, A>::operator = (const ChunkedList<T, A> & list)
+{
+	if (this != & list)
+	{
+		clear();
+		extend(list);
+	}
+	return * this;
+}
+
+
+// ------------------------------------------------------------ //
+//		Deque Implementation
+// ------------------------------------------------------------ //
+
+template<typename T, typename A> Deque<T, A>::Deque(const Deque<T, A> & deque)
+	: A(deque.allocator()), h(0), n(0), m(0), items(nullptr)
+{
+	reserve(deque.n);
+	pushBack(deque.headSpan().first, deque.headSpan().second);
+	pushBack(deque.tailSpan().first, deque.tailSpan().second);
+}
+
+template<typename T, typename A> void Deque<T, A>::reserve(size_t size)
+{
+	if (size <= m)
+		return;
+
+	// Capacity is a power of two (starting from 16)
+	size_t x = m > 16 ? m : 16;
+	while (size > x)
+		x <<= 1;
+
+	Pair<T *, size_t> head = headSpan();
+	Pair<T *, size_t> tail = tailSpan();
+	if (nx::type::isTriviallyRelocatable<T>() && tail.second > 0)
+	{
+		// The buffer is resized in place (if the allocator can), and the head span is moved to the end of the buffer
+		T * buffer = static_cast<T *>(mem::reallocateWith(allocator(), items, sizeof(T) * m, sizeof(T) * x, alignof(T)));
+		nx::type::confirm(buffer);
+		__builtin_memmove(static_cast<void *>(buffer + x - head.second), static_cast<const void *>(buffer + h), sizeof(T) * head.second);
+		h = x - head.second;
+		m = x;
+		items = buffer;
+	}
+	else if (nx::type::isTriviallyRelocatable<T>())
+	{
+		T * buffer = static_cast<T *>(mem::reallocateWith(allocator(), items, sizeof(T) * m, sizeof(T) * x, alignof(T)));
+		nx::type::confirm(buffer);
+		m = x;
+		items = buffer;
+	}
+	else
+	{
+		// The items are moved to the start of the new buffer, in order
+		T * buffer = allocate(x);
+		nx::type::confirm(buffer);
+		nx::type::createArrayAtByMove(buffer, head.first, head.second);
+		nx::type::createArrayAtByMove(buffer + head.second, tail.first, tail.second);
+		nx::type::destroyArrayAt(tail.first, tail.second);
+		nx::type::destroyArrayAt(head.first, head.second);
+		release(items, m);
+		h = 0;
+		m = x;
+		items = buffer;
+	}
+}
+
+template<typename T, typename A> void Deque<T, A>::clear() noexcept(nx::type::hasNoexceptDestroy<T>())
+{
+	nx::type::destroyArrayAt(tailSpan().first, tailSpan().second);
+	nx::type::destroyArrayAt(headSpan().first, headSpan().second);
+	h = 0;
+	n = 0;
+}
+
+template<typename T, typename A> void Deque<T, A>::pushBack(T && item)
+{
+	emplaceBack(static_cast<T &&>(item));
+}
+
+template<typename T, typename A> void Deque<T, A>::pushBack(const T & item)
+{
+	emplaceBack(item);
+}
+
+template<typename T, typename A> void Deque<T, A>::pushFront(T && item)
+{
+	emplaceFront(static_cast<T &&>(item));
+}
+
+template<typename T, typename A> void Deque<T, A>::pushFront(const T & item)
+{
+	emplaceFront(item);
+}
+
+template<typename T, typename A> template<typename... TS> T & Deque<T, A>::emplaceBack(TS && ... args)
+{
+	if (n + 1 > m)
+	{
+		// The arguments may be items of the deque, so the new item is made before the old buffer is freed
+		T item(static_cast<TS &&>(args)...);
+		grow(n + 1);
+		return emplaceBack(static_cast<T &&>(item));
+	}
+	T * item = nx::type::createAt(items + ((h + n) & (m - 1)), static_cast<TS &&>(args)...);
+	n ++;
+	return * item;
+}
+
+template<typename T, typename A> template<typename... TS> T & Deque<T, A>::emplaceFront(TS && ... args)
+{
+	if (n + 1 > m)
+	{
+		// The arguments may be items of the deque, so the new item is made before the old buffer is freed
+		T item(static_cast<TS &&>(args)...);
+		grow(n + 1);
+		return emplaceFront(static_cast<T &&>(item));
+	}
+	size_t i = (h - 1) & (m - 1);
+	T * item = nx::type::createAt(items + i, static_cast<TS &&>(args)...);
+	h = i;
+	n ++;
+	return * item;
+}
+
+template<typename T, typename A> T Deque<T, A>::popBack() noexcept(nx::type::hasNoexceptCreate<T, T>())
+{
+	T & item = back();
+	T result(static_cast<T &&>(item));
+	nx::type::destroyAt(& item);
+	n --;
+	return result;
+}
+
+template<typename T, typename A> T Deque<T, A>::popFront() noexcept(nx::type::hasNoexceptCreate<T, T>())
+{
+	T & item = front();
+	T result(static_cast<T &&>(item));
+	nx::type::destroyAt(& item);
+	h = (h + 1) & (m - 1);
+	n --;
+	return result;
+}
+
+template<typename T, typename A> void Deque<T, A>::pushBack(const T * first, size_t count)
+{
+	if (count == 0)
+		return;
+	grow(n + count);
+
+	// Copied up to the end of the buffer, and the rest to its start
+	size_t start = (h + n) & (m - 1);
+	size_t part = count < m - start ? count : m - start;
+	nx::type::createArrayAtByCopy(items + start, first, part);
+	nx::type::createArrayAtByCopy(items, first + part, count - part);
+	n += count;
+}
+
+template<typename T, typename A> void Deque<T, A>::popFront(T * out, size_t count)
+{
+	if (count == 0)
+		return;
+
+	size_t part = count < m - h ? count : m - h;
+	nx::type::createArrayAtByMove(out, items + h, part);
+	nx::type::createArrayAtByMove(out + part, items, count - part);
+	nx::type::destroyArrayAt(items + h, part);
+	nx::type::destroyArrayAt(items, count - part);
+	h = (h + count) & (m - 1);
+	n -= count;
+}
+
+template<typename T, typename A> Deque<T, A> & Deque<T, A>::operator = (Deque<T, A> && deque) noexcept
+{
+	if (this != & deque)
+	{
+		clear();
+		release(items, m);
+		allocator() = deque.allocator();
+		h = deque.h;
+		n = deque.n;
+		m = deque.m;
+		items = deque.items;
+		deque.h = deque.n = deque.m = 0;
+		deque.items = nullptr;
+	}
+	return * this;
+}
+
+template<typename T, typename A> Deque<T, A> & Deque<T, A>::operator = (const Deque<T, A> & deque)
+{
+	if (this != & deque)
+	{
+		clear();
+		reserve(deque.n);
+		pushBack(deque.headSpan().first, deque.headSpan().second);
+		pushBack(deque.tailSpan().first, deque.tailSpan().second);
+	}
+	return * this;
+}
+
+
+// ------------------------------------------------------------ //
+//		Set Implementation
+// ------------------------------------------------------------ //
+
+template<typename T, typename A> Set<T, A>::Set(const Set<T, A> & set)
+	: A(set.allocator()), n(0), d(0), m(0), control(nullptr), slots(nullptr)
+{
+	reserve(set.n);
+	for (const T & item : set)
+		place(item, hashOf(item));
+}
+
+template<typename T, typename A> void Set<T, A>::reserve(size_t size)
+{
+	// Capacity is a power of two (starting from a group), with room for `size` items below 7/8 of it (an empty set
+	// stays unallocated)
+	if (size == 0 || size <= m / 8 * 7)
+		return;
+	size_t x = m > impl::HashGroup::size ? m : impl::HashGroup::size;
+	while (size > x / 8 * 7)
+		x <<= 1;
+	if (x > m)
+		rehash(x);
+}
+
+template<typename T, typename A> void Set<T, A>::clear() noexcept(nx::type::hasNoexceptDestroy<T>())
+{
+	if (!nx::type::hasTrivialDestroy<T>())
+		for (T & item : * this)
+			nx::type::destroyAt(& item);
+	if (control)
+		__builtin_memset(control, impl::HashGroup::empty, m);
+	n = 0;
+	d = 0;
+}
+
+template<typename T, typename A> bool Set<T, A>::insert(T && item)
+{
+	uintptr_t h = hashOf(item);
+	if (locate(item, h) != notFound)
+		return false;
+	grow();
+	place(rvalue(item), h);
+	return true;
+}
+
+template<typename T, typename A> bool Set<T, A>::insert(const T & item)
+{
+	uintptr_t h = hashOf(item);
+	if (locate(item, h) != notFound)
+		return false;
+	grow();
+	place(item, h);
+	return true;
+}
+
+template<typename T, typename A> bool Set<T, A>::erase(const T & item) noexcept(nx::type::hasNoexceptDestroy<T>())
+{
+	size_t i = locate(item, hashOf(item));
+	if (i == notFound)
+		return false;
+	nx::type::destroyAt(slots + i);
+	n --;
+
+	// A group with an empty slot never had a probe go past it, so the slot can be empty again
+	if (impl::HashGroup(control + (i & ~(impl::HashGroup::size - 1))).matchEmpty() != 0)
+		control[i] = impl::HashGroup::empty;
+	else
+	{
+		control[i] = impl::HashGroup::deleted;
+		d ++;
+	}
+	return true;
+}
+
+template<typename T, typename A> size_t Set<T, A>::insertAll(const T * items, size_t count)
+{
+	if (count == 0)
+		return 0;
+	reserve(n + count);
+
+	// Every group of the batch is requested, before the first one is probed
+	size_t added = 0;
+	uintptr_t hashes[batch];
+	for (size_t first = 0; first < count; first += batch)
+	{
+		size_t k = count - first < batch ? count - first : batch;
+		for (size_t j = 0; j < k; ++ j)
+		{
+			hashes[j] = hashOf(items[first + j]);
+			__builtin_prefetch(groupOf(hashes[j]));
+		}
+		for (size_t j = 0; j < k; ++ j)
+			if (locate(items[first + j], hashes[j]) == notFound)
+			{
+				grow();
+				place(items[first + j], hashes[j]);
+				added ++;
+			}
+	}
+	return added;
+}
+
+template<typename T, typename A> bool Set<T, A>::containsAll(const T * items, size_t count) const noexcept
+{
+	if (count == 0)
+		return true;
+	if (n == 0)
+		return false;
+
+	uintptr_t hashes[batch];
+	for (size_t first = 0; first < count; first += batch)
+	{
+		size_t k = count - first < batch ? count - first : batch;
+		for (size_t j = 0; j < k; ++ j)
+		{
+			hashes[j] = hashOf(items[first + j]);
+			__builtin_prefetch(groupOf(hashes[j]));
+		}
+		for (size_t j = 0; j < k; ++ j)
+			if (locate(items[first + j], hashes[j]) == notFound)
+				return false;
+	}
+	return true;
+}
+
+template<typename T, typename A> Set<T, A> & Set<T, A>::operator = (Set<T, A> && set) noexcept
+{
+	if (this != & set)
+	{
+		clear();
+		release();
+		allocator() = set.allocator();
+		n = set.n;
+		d = set.d;
+		m = set.m;
+		control = set.control;
+		slots = set.slots;
+		set.forget();
+	}
+	return * this;
+}
+
+template<typename T, typename A> Set<T, A> & Set<T, A>::operator = (const Set<T, A> & set)
+{
+	if (this != & set)
+	{
+		clear();
+		reserve(set.n);
+		for (const T & item : set)
+			place(item, hashOf(item));
+	}
+	return * this;
+}
+
+template<typename T, typename A> size_t Set<T, A>::locate(const T & item, uintptr_t h) const noexcept
+{
+	if (m == 0)
+		return notFound;
+
+	// Groups are probed in order, until a group with an empty slot (there is always one, below 7/8 of the capacity)
+	size_t mask = m / impl::HashGroup::size - 1;
+	byte tag = impl::HashGroup::tagOf(h);
+	for (size_t g = h & mask; ; g = (g + 1) & mask)
+	{
+		impl::HashGroup group(control + g * impl::HashGroup::size);
+		for (uint64_t bits = group.match(tag); bits != 0; bits = impl::HashGroup::next(bits))
+		{
+			size_t i = g * impl::HashGroup::size + impl::HashGroup::first(bits);
+			if (slots[i] == item)
+				return i;
+		}
+		if (group.matchEmpty() != 0)
+			return notFound;
+	}
+}
+
+template<typename T, typename A> size_t Set<T, A>::vacancy(uintptr_t h) const noexcept
+{
+	size_t mask = m / impl::HashGroup::size - 1;
+	for (size_t g = h & mask; ; g = (g + 1) & mask)
+	{
+		uint64_t bits = impl::HashGroup(control + g * impl::HashGroup::size).matchFree();
+		if (bits != 0)
+			return g * impl::HashGroup::size + impl::HashGroup::first(bits);
+	}
+}
+
+template<typename T, typename A> template<typename U> void Set<T, A>::place(U && item, uintptr_t h)
+{
+	size_t i = vacancy(h);
+	nx::type::createAt(slots + i, forward<U>(item));
+	if (control[i] == impl::HashGroup::deleted)
+		d --;
+	control[i] = impl::HashGroup::tagOf(h);
+	n ++;
+}
+
+template<typename T, typename A> void Set<T, A>::grow()
+{
+	// Deleted slots are dropped, and the capacity is only doubled, if the set is at least half full
+	if (n + d + 1 > m / 8 * 7)
+		rehash(m == 0 ? impl::HashGroup::size : n + 1 > m / 2 ? 2 * m : m);
+}
+
+template<typename T, typename A> void Set<T, A>::rehash(size_t capacity)
+{
+	byte * buffer = static_cast<byte *>(allocator().alloc(sizeOf(capacity), align));
+	nx::type::confirm(buffer);
+	__builtin_memset(buffer, impl::HashGroup::empty, capacity);
+
+	byte * oldControl = control;
+	T * oldSlots = slots;
+	size_t oldCapacity = m;
+	control = buffer;
+	slots = reinterpret_cast<T *>(buffer + offsetOf(capacity));
+	m = capacity;
+	d = 0;
+
+	// Items are moved to the first free slot of their probe sequence (as bytes, if they can be)
+	for (size_t i = 0; i < oldCapacity; ++ i)
+		if (!(oldControl[i] & 0x80))
+		{
+			uintptr_t h = hashOf(oldSlots[i]);
+			size_t j = vacancy(h);
+			if (nx::type::isTriviallyRelocatable<T>())
+				__builtin_memcpy(static_cast<void *>(slots + j), static_cast<const void *>(oldSlots + i), sizeof(T));
+			else
+			{
+				nx::type::createAt(slots + j, rvalue(oldSlots[i]));
+				nx::type::destroyAt(oldSlots + i);
+			}
+			control[j] = impl::HashGroup::tagOf(h);
+		}
+
+	if (oldControl)
+		allocator().free(oldControl, sizeOf(oldCapacity), align);
+}
+
+template<typename T, typename A> void Set<T, A>::release() noexcept
+{
+	if (control)
+		allocator().free(control, sizeOf(m), align);
+}
+
+
+// ------------------------------------------------------------ //
+//		IntSet Implementation
+// ------------------------------------------------------------ //
+
+template<typename A> IntSet<A>::IntSet(const IntSet<A> & set)
+	: A(set.allocator()), containers(set.allocator()), n(set.n)
+{
+	containers.reserve(set.containers.size());
+	for (const Container & c : set.containers)
+		containers.append(copy(c));
+}
+
+template<typename A> bool IntSet<A>::contains(uint32_t value) const noexcept
+{
+	uint16_t key = static_cast<uint16_t>(value >> 16);
+	size_t i = find(key);
+	return i < containers.size() && containers[i].key == key && has(containers[i], static_cast<uint16_t>(value));
+}
+
+template<typename A> bool IntSet<A>::add(uint32_t value)
+{
+	uint16_t key = static_cast<uint16_t>(value >> 16);
+	size_t i = find(key);
+	if (i == containers.size() || containers[i].key != key)
+		containers.insert(i, createArray(key, 4));
+	if (!addTo(containers[i], static_cast<uint16_t>(value)))
+		return false;
+	n ++;
+	return true;
+}
+
+template<typename A> bool IntSet<A>::remove(uint32_t value)
+{
+	uint16_t key = static_cast<uint16_t>(value >> 16);
+	size_t i = find(key);
+	if (i == containers.size() || containers[i].key != key || !removeFrom(containers[i], static_cast<uint16_t>(value)))
+		return false;
+	n --;
+
+	// Empty containers are dropped (containers are trivially copyable)
+	if (containers[i].count == 0)
+	{
+		release(containers[i]);
+		Container * data = containers.data();
+		__builtin_memmove(static_cast<void *>(data + i), static_cast<const void *>(data + i + 1), sizeof(Container) * (containers.size() - i - 1));
+		containers.resize(containers.size() - 1);
+	}
+	return true;
+}
+
+template<typename A> void IntSet<A>::addAll(const uint32_t * values, size_t count)
+{
+	for (size_t i = 0; i < count; ++ i)
+		add(values[i]);
+}
+
+template<typename A> void IntSet<A>::clear() noexcept
+{
+	for (Container & c : containers)
+		release(c);
+	containers.resize(0);
+	n = 0;
+}
+
+template<typename A> void IntSet<A>::optimize()
+{
+	for (Container & c : containers)
+	{
+		size_t runs = runCount(c);
+		size_t bytes = c.kind == Kind::array ? sizeof(uint16_t) * c.count : c.kind == Kind::bitmap ? sizeof(uint64_t) * bitmapWords : sizeof(Run) * runs;
+		if (sizeof(Run) * runs < bytes)
+			toRuns(c, runs);
+	}
+}
+
+template<typename A> void IntSet<A>::unite(const IntSet<A> & set)
+{
+	if (this == & set)
+		return;
+
+	// The containers of both sets are merged by key into a new list
+	List<Container, A> result(allocator());
+	result.reserve(containers.size() + set.containers.size());
+	size_t i = 0;
+	size_t j = 0;
+	n = 0;
+	while (i < containers.size() || j < set.containers.size())
+	{
+		if (j == set.containers.size() || (i < containers.size() && containers[i].key < set.containers[j].key))
+			result.append(containers[i ++]);
+		else if (i == containers.size() || set.containers[j].key < containers[i].key)
+			result.append(copy(set.containers[j ++]));
+		else
+		{
+			uniteWith(containers[i], set.containers[j ++]);
+			result.append(containers[i ++]);
+		}
+		n += result[result.size() - 1].count;
+	}
+	containers = rvalue(result);
+}
+
+template<typename A> void IntSet<A>::intersect(const IntSet<A> & set)
+{
+	if (this == & set)
+		return;
+
+	// Containers are kept (in place), if they have a matching container, and they are not empty after the intersection
+	size_t k = 0;
+	size_t j = 0;
+	n = 0;
+	for (size_t i = 0; i < containers.size(); ++ i)
+	{
+		Container & c = containers[i];
+		while (j < set.containers.size() && set.containers[j].key < c.key)
+			++ j;
+		if (j < set.containers.size() && set.containers[j].key == c.key)
+			intersectWith(c, set.containers[j]);
+		else
+			c.count = 0;
+
+		if (c.count == 0)
+			release(c);
+		else
+		{
+			n += c.count;
+			containers[k ++] = c;
+		}
+	}
+	containers.resize(k);
+}
+
+template<typename A> void IntSet<A>::subtract(const IntSet<A> & set)
+{
+	if (this == & set)
+	{
+		clear();
+		return;
+	}
+
+	size_t k = 0;
+	size_t j = 0;
+	n = 0;
+	for (size_t i = 0; i < containers.size(); ++ i)
+	{
+		Container & c = containers[i];
+		while (j < set.containers.size() && set.containers[j].key < c.key)
+			++ j;
+		if (j < set.containers.size() && set.containers[j].key == c.key)
+			subtractWith(c, set.containers[j]);
+
+		if (c.count == 0)
+			release(c);
+		else
+		{
+			n += c.count;
+			containers[k ++] = c;
+		}
+	}
+	containers.resize(k);
+}
+
+template<typename A> size_t IntSet<A>::intersectionSize(const IntSet<A> & set) const noexcept
+{
+	size_t total = 0;
+	size_t i = 0;
+	size_t j = 0;
+	while (i < containers.size() && j < set.containers.size())
+	{
+		if (containers[i].key < set.containers[j].key)
+			++ i;
+		else if (set.containers[j].key < containers[i].key)
+			++ j;
+		else
+			total += intersectionSize(containers[i ++], set.containers[j ++]);
+	}
+	return total;
+}
+
+template<typename A> template<typename F> void IntSet<A>::forEach(F && func) const
+{
+	for (const Container & c : containers)
+	{
+		uint32_t high = uint32_t(c.key) << 16;
+		each(c, [&] (uint16_t low) {func(high | low);});
+	}
+}
+
+template<typename A> IntSet<A> & IntSet<A>::operator = (IntSet<A> && set) noexcept
+{
+	if (this != & set)
+	{
+		clear();
+		allocator() = set.allocator();
+		containers = rvalue(set.containers);
+		n = set.n;
+		set.n = 0;
+	}
+	return * this;
+}
+
+template<typename A> IntSet<A> & IntSet<A>::operator = (const IntSet<A> & set)
+{
+	if (this != & set)
+	{
+		clear();
+		containers.reserve(set.containers.size());
+		for (const Container & c : set.containers)
+			containers.append(copy(c));
+		n = set.n;
+	}
+	return * this;
+}
+
+template<typename A> template<typename U> U * IntSet<A>::allocate(size_t count)
+{
+	U * data = static_cast<U *>(allocator().alloc(sizeof(U) * count, alignof(U)));
+	nx::type::confirm(data);
+	return data;
+}
+
+template<typename A> uint64_t * IntSet<A>::allocateWords()
+{
+	// Bitmaps are aligned to cache lines, for the vectorized loops
+	uint64_t * words = static_cast<uint64_t *>(allocator().alloc(sizeof(uint64_t) * bitmapWords, 64));
+	nx::type::confirm(words);
+	return words;
+}
+
+template<typename A> void IntSet<A>::release(Container & c) noexcept
+{
+	switch (c.kind)
+	{
+		case Kind::array: release(c.values, c.capacity); break;
+		case Kind::bitmap: allocator().free(c.words, sizeof(uint64_t) * bitmapWords, 64); break;
+		case Kind::runs: release(c.runs, c.capacity); break;
+	}
+}
+
+template<typename A> size_t IntSet<A>::find(uint16_t key) const noexcept
+{
+	size_t first = 0;
+	size_t last = containers.size();
+	while (first < last)
+	{
+		size_t mid = (first + last) / 2;
+		if (containers[mid].key < key)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+	return first;
+}
+
+template<typename A> typename IntSet<A>::Container IntSet<A>::createArray(uint16_t key, uint32_t capacity)
+{
+	Container c;
+	c.key = key;
+	c.kind = Kind::array;
+	c.count = 0;
+	c.length = 0;
+	c.capacity = capacity;
+	c.values = allocate<uint16_t>(capacity);
+	return c;
+}
+
+template<typename A> typename IntSet<A>::Container IntSet<A>::copy(const Container & c)
+{
+	Container result = c;
+	switch (c.kind)
+	{
+		case Kind::array:
+			result.values = allocate<uint16_t>(c.capacity);
+			__builtin_memcpy(result.values, c.values, sizeof(uint16_t) * c.length);
+			break;
+		case Kind::bitmap:
+			result.words = allocateWords();
+			__builtin_memcpy(result.words, c.words, sizeof(uint64_t) * bitmapWords);
+			break;
+		case Kind::runs:
+			result.runs = allocate<Run>(c.capacity);
+			__builtin_memcpy(static_cast<void *>(result.runs), static_cast<const void *>(c.runs), sizeof(Run) * c.length);
+			break;
+	}
+	return result;
+}
+
+template<typename A> bool IntSet<A>::has(const Container & c, uint16_t low) noexcept
+{
+	switch (c.kind)
+	{
+		case Kind::array:
+		{
+			uint32_t first = 0;
+			uint32_t last = c.length;
+			while (first < last)
+			{
+				uint32_t mid = (first + last) / 2;
+				if (c.values[mid] < low)
+					first = mid + 1;
+				else
+					last = mid;
+			}
+			return first < c.length && c.values[first] == low;
+		}
+		case Kind::bitmap:
+			return (c.words[low >> 6] >> (low & 63)) & 1;
+		case Kind::runs:
+		{
+			// Last run, that starts before the value
+			uint32_t first = 0;
+			uint32_t last = c.length;
+			while (first < last)
+			{
+				uint32_t mid = (first + last) / 2;
+				if (c.runs[mid].first <= low)
+					first = mid + 1;
+				else
+					last = mid;
+			}
+			return first > 0 && low <= c.runs[first - 1].last;
+		}
+	}
+	return false;
+}
+
+template<typename A> template<typename F> void IntSet<A>::each(const Container & c, F && func)
+{
+	switch (c.kind)
+	{
+		case Kind::array:
+			for (uint32_t i = 0; i < c.length; ++ i)
+				func(c.values[i]);
+			break;
+		case Kind::bitmap:
+			for (size_t i = 0; i < bitmapWords; ++ i)
+				for (uint64_t word = c.words[i]; word != 0; word &= word - 1)
+					func(static_cast<uint16_t>(i * 64 + __builtin_ctzll(word)));
+			break;
+		case Kind::runs:
+			for (uint32_t i = 0; i < c.length; ++ i)
+				for (uint32_t low = c.runs[i].first; low <= c.runs[i].last; ++ low)
+					func(static_cast<uint16_t>(low));
+			break;
+	}
+}
+
+template<typename A> void IntSet<A>::fill(const Container & c, uint64_t * words) noexcept
+{
+	if (c.kind == Kind::bitmap)
+	{
+		__builtin_memcpy(words, c.words, sizeof(uint64_t) * bitmapWords);
+		return;
+	}
+	__builtin_memset(words, 0, sizeof(uint64_t) * bitmapWords);
+	if (c.kind == Kind::array)
+		for (uint32_t i = 0; i < c.length; ++ i)
+			words[c.values[i] >> 6] |= uint64_t(1) << (c.values[i] & 63);
+	else
+		for (uint32_t i = 0; i < c.length; ++ i)
+			setRange(words, c.runs[i].first, c.runs[i].last);
+}
+
+template<typename A> void IntSet<A>::setRange(uint64_t * words, uint16_t first, uint16_t last) noexcept
+{
+	size_t a = first >> 6;
+	size_t b = last >> 6;
+	uint64_t head = ~uint64_t(0) << (first & 63);
+	uint64_t tail = ~uint64_t(0) >> (63 - (last & 63));
+	if (a == b)
+	{
+		words[a] |= head & tail;
+		return;
+	}
+	words[a] |= head;
+	for (size_t i = a + 1; i < b; ++ i)
+		words[i] = ~uint64_t(0);
+	words[b] |= tail;
+}
+
+template<typename A> uint32_t IntSet<A>::popcount(const uint64_t * words) noexcept
+{
+	uint32_t count = 0;
+	for (size_t i = 0; i < bitmapWords; ++ i)
+		count += static_cast<uint32_t>(__builtin_popcountll(words[i]));
+	return count;
+}
+
+template<typename A> size_t IntSet<A>::runCount(const Container & c) noexcept
+{
+	size_t runs = 0;
+	switch (c.kind)
+	{
+		case Kind::array:
+			for (uint32_t i = 0; i < c.length; ++ i)
+				runs += i == 0 || c.values[i] != c.values[i - 1] + 1;
+			break;
+		case Kind::bitmap:
+		{
+			// Runs start at set bits, that follow a clear bit (the carry is the last bit of the previous word)
+			uint64_t carry = 0;
+			for (size_t i = 0; i < bitmapWords; ++ i)
+			{
+				uint64_t word = c.words[i];
+				runs += static_cast<size_t>(__builtin_popcountll(word & ~((word << 1) | carry)));
+				carry = word >> 63;
+			}
+			break;
+		}
+		case Kind::runs:
+			runs = c.length;
+			break;
+	}
+	return runs;
+}
+
+template<typename A> void IntSet<A>::toArray(Container & c)
+{
+	uint16_t * values = allocate<uint16_t>(c.count);
+	uint32_t k = 0;
+	each(c, [&] (uint16_t low) {values[k ++] = low;});
+	release(c);
+	c.kind = Kind::array;
+	c.length = c.count;
+	c.capacity = c.count;
+	c.values = values;
+}
+
+template<typename A> void IntSet<A>::toBitmap(Container & c)
+{
+	uint64_t * words = allocateWords();
+	fill(c, words);
+	release(c);
+	c.kind = Kind::bitmap;
+	c.length = 0;
+	c.capacity = 0;
+	c.words = words;
+}
+
+template<typename A> void IntSet<A>::toRuns(Container & c, size_t count)
+{
+	Run * runs = allocate<Run>(count);
+	uint32_t k = 0;
+	each(c, [&] (uint16_t low)
+		{
+			if (k > 0 && runs[k - 1].last + 1 == low)
+				runs[k - 1].last = low;
+			else
+				runs[k ++] = Run{low, low};
+		}
+	);
+	release(c);
+	c.kind = Kind::runs;
+	c.length = k;
+	c.capacity = k;
+	c.runs = runs;
+}
+
+template<typename A> void IntSet<A>::expand(Container & c)
+{
+	if (c.kind == Kind::runs)
+		c.count > arrayLimit ? toBitmap(c) : toArray(c);
+}
+
+template<typename A> void IntSet<A>::shrink(Container & c)
+{
+	if (c.kind == Kind::bitmap && c.count <= arrayLimit && c.count > 0)
+		toArray(c);
+}
+
+template<typename A> bool IntSet<A>::addTo(Container & c, uint16_t low)
+{
+	expand(c);
+	if (c.kind == Kind::array)
+	{
+		uint32_t first = 0;
+		uint32_t last = c.length;
+		while (first < last)
+		{
+			uint32_t mid = (first + last) / 2;
+			if (c.values[mid] < low)
+				first = mid + 1;
+			else
+				last = mid;
+		}
+		if (first < c.length && c.values[first] == low)
+			return false;
+
+		if (c.length < arrayLimit)
+		{
+			if (c.length == c.capacity)
+			{
+				uint32_t x = 2 * c.capacity < arrayLimit ? 2 * c.capacity : arrayLimit;
+				c.values = static_cast<uint16_t *>(mem::reallocateWith(allocator(), c.values, sizeof(uint16_t) * c.capacity, sizeof(uint16_t) * x, alignof(uint16_t)));
+				nx::type::confirm(c.values);
+				c.capacity = x;
+			}
+			__builtin_memmove(c.values + first + 1, c.values + first, sizeof(uint16_t) * (c.length - first));
+			c.values[first] = low;
+			c.length ++;
+			c.count ++;
+			return true;
+		}
+
+		// Full arrays turn into bitmaps
+		toBitmap(c);
+	}
+
+	uint64_t bit = uint64_t(1) << (low & 63);
+	if (c.words[low >> 6] & bit)
+		return false;
+	c.words[low >> 6] |= bit;
+	c.count ++;
+	return true;
+}
+
+template<typename A> bool IntSet<A>::removeFrom(Container & c, uint16_t low)
+{
+	if (!has(c, low))
+		return false;
+	expand(c);
+	if (c.kind == Kind::array)
+	{
+		uint16_t * end = c.values + c.length;
+		uint16_t * value = c.values;
+		while (* value != low)
+			++ value;
+		__builtin_memmove(value, value + 1, sizeof(uint16_t) * (end - value - 1));
+		c.length --;
+		c.count --;
+	}
+	else
+	{
+		c.words[low >> 6] &= ~(uint64_t(1) << (low & 63));
+		c.count --;
+		shrink(c);
+	}
+	return true;
+}
+
+template<typename A> void IntSet<A>::uniteWith(Container & c, const Container & other)
+{
+	expand(c);
+
+	// Arrays are merged, if the result is still an array
+	if (c.kind == Kind::array && other.kind == Kind::array && c.count + other.count <= arrayLimit)
+	{
+		uint32_t size = c.count + other.count;
+		uint16_t * values = allocate<uint16_t>(size);
+		uint32_t i = 0;
+		uint32_t j = 0;
+		uint32_t k = 0;
+		while (i < c.length && j < other.length)
+		{
+			uint16_t a = c.values[i];
+			uint16_t b = other.values[j];
+			values[k ++] = a < b ? a : b;
+			i += a <= b;
+			j += b <= a;
+		}
+		while (i < c.length)
+			values[k ++] = c.values[i ++];
+		while (j < other.length)
+			values[k ++] = other.values[j ++];
+		release(c);
+		c.count = c.length = k;
+		c.capacity = size;
+		c.values = values;
+		return;
+	}
+
+	if (c.kind == Kind::array)
+		toBitmap(c);
+	switch (other.kind)
+	{
+		case Kind::array:
+			for (uint32_t i = 0; i < other.length; ++ i)
+				c.words[other.values[i] >> 6] |= uint64_t(1) << (other.values[i] & 63);
+			break;
+		case Kind::bitmap:
+			for (size_t i = 0; i < bitmapWords; ++ i)
+				c.words[i] |= other.words[i];
+			break;
+		case Kind::runs:
+			for (uint32_t i = 0; i < other.length; ++ i)
+				setRange(c.words, other.runs[i].first, other.runs[i].last);
+			break;
+	}
+	c.count = popcount(c.words);
+}
+
+template<typename A> void IntSet<A>::intersectWith(Container & c, const Container & other)
+{
+	expand(c);
+	if (c.kind == Kind::array)
+	{
+		// Values are filtered in place
+		uint32_t k = 0;
+		if (other.kind == Kind::array)
+		{
+			uint32_t j = 0;
+			for (uint32_t i = 0; i < c.length; ++ i)
+			{
+				while (j < other.length && other.values[j] < c.values[i])
+					++ j;
+				if (j < other.length && other.values[j] == c.values[i])
+					c.values[k ++] = c.values[i];
+			}
+		}
+		else
+			for (uint32_t i = 0; i < c.length; ++ i)
+				if (has(other, c.values[i]))
+					c.values[k ++] = c.values[i];
+		c.count = c.length = k;
+	}
+	else if (other.kind == Kind::array)
+	{
+		// The result is at most as large as the array
+		uint16_t * values = allocate<uint16_t>(other.length > 0 ? other.length : 1);
+		uint32_t k = 0;
+		for (uint32_t i = 0; i < other.length; ++ i)
+			if (has(c, other.values[i]))
+				values[k ++] = other.values[i];
+		release(c);
+		c.kind = Kind::array;
+		c.count = c.length = k;
+		c.capacity = other.length > 0 ? other.length : 1;
+		c.values = values;
+	}
+	else
+	{
+		uint64_t buffer[bitmapWords];
+		const uint64_t * words = other.words;
+		if (other.kind == Kind::runs)
+		{
+			fill(other, buffer);
+			words = buffer;
+		}
+		for (size_t i = 0; i < bitmapWords; ++ i)
+			c.words[i] &= words[i];
+		c.count = popcount(c.words);
+		shrink(c);
+	}
+}
+
+template<typename A> void IntSet<A>::subtractWith(Container & c, const Container & other)
+{
+	expand(c);
+	if (c.kind == Kind::array)
+	{
+		uint32_t k = 0;
+		for (uint32_t i = 0; i < c.length; ++ i)
+			if (!has(other, c.values[i]))
+				c.values[k ++] = c.values[i];
+		c.count = c.length = k;
+		return;
+	}
+
+	switch (other.kind)
+	{
+		case Kind::array:
+			for (uint32_t i = 0; i < other.length; ++ i)
+				c.words[other.values[i] >> 6] &= ~(uint64_t(1) << (other.values[i] & 63));
+			break;
+		case Kind::bitmap:
+			for (size_t i = 0; i < bitmapWords; ++ i)
+				c.words[i] &= ~other.words[i];
+			break;
+		case Kind::runs:
+		{
+			uint64_t buffer[bitmapWords];
+			fill(other, buffer);
+			for (size_t i = 0; i < bitmapWords; ++ i)
+				c.words[i] &= ~buffer[i];
+			break;
+		}
+	}
+	c.count = popcount(c.words);
+	shrink(c);
+}
+
+template<typename A> uint32_t IntSet<A>::intersectionSize(const Container & c, const Container & other) noexcept
+{
+	// Arrays are looked up in the other container, everything else is counted as bitmaps
+	if (c.kind == Kind::array || other.kind == Kind::array)
+	{
+		const Container & small = c.kind == Kind::array ? c : other;
+		const Container & large = c.kind == Kind::array ? other : c;
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < small.length; ++ i)
+			count += has(large, small.values[i]);
+		return count;
+	}
+
+	uint64_t left[bitmapWords];
+	uint64_t right[bitmapWords];
+	const uint64_t * a = c.kind == Kind::bitmap ? c.words : (fill(c, left), left);
+	const uint64_t * b = other.kind == Kind::bitmap ? other.words : (fill(other, right), right);
+	uint32_t count = 0;
+	for (size_t i = 0; i < bitmapWords; ++ i)
+		count += static_cast<uint32_t>(__builtin_popcountll(a[i] & b[i]));
+	return count;
+}
+
+
+// ------------------------------------------------------------ //
+//		Dictionary Implementation
+// ------------------------------------------------------------ //
+
+/**
+	[CLASS] Dictionary Node - Stores dictionary entries with their hashes
+	
+	Implementation:
+	
+	The hash value 0 is remapped, and used to indicate empty nodes. Empty nodes are nodes, without a constructed entry
+	inside them. These nodes are managed by the dictionary: erased nodes stay empty until the next rehash, which drops
+	them from the node list.
+ */
+template<typename K, typename V, typename A> struct Dictionary<K, V, A>::Node
+{
+	// Fields
+	uintptr_t hash;
+	union
+	{
+		Entry entry;
+	};
+	
+	// Constructors & destructors
+	Node() noexcept
+		: hash(0) {}
+	~Node()
+		{if (hash != 0) destroy();}
+	
+	// Create and destroy the entry
+	template<typename ... TS> void create(TS && ... args) noexcept(nx::type::hasNoexceptCreate<Entry, TS ...>())
+		{nx::type::createAt(& entry, forward<TS &&>(args) ...);}
+	void destroy() noexcept(nx::type::hasNoexceptDestroy<Entry>())
+		{nx::type::destroyAt(& entry);}
 		
-	Type prev() override
-		{return iterator.prev();}
-	bool hasPrev() override
-		{return iterator.hasPrev();}
+	// Copy and move isn't needed
+	Node & operator = (Node && node) = delete;
+	Node & operator = (const Node & node) = delete;
+};
+
+template<typename K, typename V, typename A> Dictionary<K, V, A>::Dictionary(const Dictionary<K, V, A> & dict)
+	: A(dict.allocator()), n(0), u(0), m(0), nodes(nullptr), table(nullptr)
+{
+	reserve(dict.n);
+	for (const Node * node = dict.nodes; node != dict.nodes + dict.u; ++ node)
+		if (node->hash != 0)
+			append(node->hash, node->entry.first, node->entry.second);
+}
+
+template<typename K, typename V, typename A> void Dictionary<K, V, A>::reserve(size_t size)
+{
+	if (size <= m)
+		return;
+
+	// Capacity is a power of two (starting from 8)
+	size_t x = m > 8 ? m : 8;
+	while (size > x)
+		x <<= 1;
+	rehash(x);
+}
+
+template<typename K, typename V, typename A> void Dictionary<K, V, A>::compact()
+{
+	if (n == 0)
+	{
+		release();
+		forget();
+		return;
+	}
+
+	// Smallest capacity, that fits every entry
+	size_t x = 8;
+	while (n > x)
+		x <<= 1;
+	if (x != m || u != n)
+		rehash(x);
+}
+
+template<typename K, typename V, typename A> void Dictionary<K, V, A>::clear() noexcept(nx::type::hasNoexceptDestroy<Entry>())
+{
+	for (Node * node = nodes; node != nodes + u; ++ node)
+		if (node->hash != 0)
+		{
+			node->destroy();
+			node->hash = 0;
+		}
+	if (table)
+		__builtin_memset(table, impl::HashGroup::empty, 2 * m);
+	n = 0;
+	u = 0;
+}
+
+template<typename K, typename V, typename A> const V & Dictionary<K, V, A>::get(const K & key, const V & def) const noexcept
+{
+	size_t i = locate(key, hashOf(key));
+	return i != notFound ? nodes[i].entry.second : def;
+}
+
+template<typename K, typename V, typename A> size_t Dictionary<K, V, A>::getMany(const K * keys, size_t count, V ** values) noexcept
+{
+	size_t found = 0;
+	size_t indices[batch];
+	for (size_t first = 0; first < count; first += batch)
+	{
+		size_t k = count - first < batch ? count - first : batch;
+		locateMany(keys + first, k, indices);
+		for (size_t j = 0; j < k; ++ j)
+		{
+			values[first + j] = indices[j] != notFound ? & nodes[indices[j]].entry.second : nullptr;
+			found += indices[j] != notFound;
+		}
+	}
+	return found;
+}
+
+template<typename K, typename V, typename A> size_t Dictionary<K, V, A>::getMany(const K * keys, size_t count, const V ** values) const noexcept
+{
+	size_t found = 0;
+	size_t indices[batch];
+	for (size_t first = 0; first < count; first += batch)
+	{
+		size_t k = count - first < batch ? count - first : batch;
+		locateMany(keys + first, k, indices);
+		for (size_t j = 0; j < k; ++ j)
+		{
+			values[first + j] = indices[j] != notFound ? & nodes[indices[j]].entry.second : nullptr;
+			found += indices[j] != notFound;
+		}
+	}
+	return found;
+}
+
+template<typename K, typename V, typename A> size_t Dictionary<K, V, A>::containsMany(const K * keys, size_t count, bool * found) const noexcept
+{
+	size_t total = 0;
+	size_t indices[batch];
+	for (size_t first = 0; first < count; first += batch)
+	{
+		size_t k = count - first < batch ? count - first : batch;
+		locateMany(keys + first, k, indices);
+		for (size_t j = 0; j < k; ++ j)
+		{
+			found[first + j] = indices[j] != notFound;
+			total += indices[j] != notFound;
+		}
+	}
+	return total;
+}
+
+template<typename K, typename V, typename A> template<typename KK, typename VV> bool Dictionary<K, V, A>::insert(KK && key, VV && value)
+{
+	uintptr_t h = hashOf(key);
+	size_t i = locate(key, h);
+	if (i != notFound)
+	{
+		nodes[i].entry.second = forward<VV>(value);
+		return false;
+	}
+	append(h, forward<KK>(key), forward<VV>(value));
+	return true;
+}
 
-private:
-	T iterator;
-};
-	
-// Close namespace "nx::iter"
+template<typename K, typename V, typename A> bool Dictionary<K, V, A>::erase(const K & key) noexcept(nx::type::hasNoexceptDestroy<Entry>())
+{
+	size_t i = locate(key, hashOf(key));
+	if (i == notFound)
+		return false;
+
+	// The node stays in the index table, but it won't match any key (erased nodes are dropped by the next rehash)
+	nodes[i].destroy();
+	nodes[i].hash = 0;
+	n --;
+	return true;
 }
 
+template<typename K, typename V, typename A> Dictionary<K, V, A> & Dictionary<K, V, A>::operator = (Dictionary<K, V, A> && dict) noexcept
+{
+	if (this != & dict)
+	{
+		clear();
+		release();
+		allocator() = dict.allocator();
+		n = dict.n;
+		u = dict.u;
+		m = dict.m;
+		nodes = dict.nodes;
+		table = dict.table;
+		dict.forget();
+	}
+	return * this;
+}
 
-// ------------------------------------------------------------ //
-//		Utility functions
-// ------------------------------------------------------------ //
+template<typename K, typename V, typename A> Dictionary<K, V, A> & Dictionary<K, V, A>::operator = (const Dictionary<K, V, A> & dict)
+{
+	if (this != & dict)
+	{
+		clear();
+		reserve(dict.n);
+		for (const Node * node = dict.nodes; node != dict.nodes + dict.u; ++ node)
+			if (node->hash != 0)
+				append(node->hash, node->entry.first, node->entry.second);
+	}
+	return * this;
+}
 
-template<typename T> T * addressof(T & obj) noexcept
-	{return reinterpret_cast<T*>(& const_cast<char&>(reinterpret_cast<const volatile char &>(obj)));}
+template<typename K, typename V, typename A> V & Dictionary<K, V, A>::operator [] (const K & key)
+{
+	uintptr_t h = hashOf(key);
+	size_t i = locate(key, h);
+	return i != notFound ? nodes[i].entry.second : append(h, key, V()).second;
+}
 
-template<typename T> constexpr uintptr_t getaddress(T & obj) noexcept
-	{return & reinterpret_cast<const volatile char &>(obj) - reinterpret_cast<const volatile char *>(nullptr);}
-	
-template<typename T> constexpr T & useaddress(uintptr_t addr) noexcept
-	{return * (reinterpret_cast<const volatile char *>(nullptr) + addr);}
-	
-template<typename T> void swap(T & left, T & right) noexcept(nx::type::hasNoexceptCreate<T, T>() && nx::type::hasNoexceptMove<T>())
+template<typename K, typename V, typename A> const V & Dictionary<K, V, A>::operator [] (const K & key) const noexcept
 {
-	T l = rvalue(left);
-	T r = rvalue(right);
-	left = rvalue(r);
-	right = rvalue(l);
+	static const V empty = V();
+	return get(key, empty);
 }
 
-// ------------------------------------------------------------ //
-//		List Implementation
-// ------------------------------------------------------------ //
+template<typename K, typename V, typename A> size_t Dictionary<K, V, A>::locate(const K & key, uintptr_t h) const noexcept
+{
+	switch (widthOf(m))
+	{
+		case 1: return locateIn<uint8_t>(key, h);
+		case 2: return locateIn<uint16_t>(key, h);
+		case 4: return locateIn<uint32_t>(key, h);
+		default: return locateIn<uint64_t>(key, h);
+	}
+}
 
-template<typename T> List<T>::List(const List<T> & list) noexcept(nx::type::hasNoexceptCreate<T, const T &>())
-	: n(0), m(0), items(nullptr)
+template<typename K, typename V, typename A> template<typename I> size_t Dictionary<K, V, A>::locateIn(const K & key, uintptr_t h) const noexcept
 {
-	if (list.n > 0)
+	if (m == 0)
+		return notFound;
+
+	// Groups are probed in order, until a group with an empty slot (the table is at most half full, so the search ends)
+	const I * slots = reinterpret_cast<const I *>(table + 2 * m);
+	size_t mask = 2 * m / impl::HashGroup::size - 1;
+	byte tag = impl::HashGroup::tagOf(h);
+	for (size_t g = h & mask; ; g = (g + 1) & mask)
 	{
-		reserve(list.n);
-		nx::type::createArrayAtByCopy(items, list.items, list.n);
-		n = list.n;
+		impl::HashGroup group(table + g * impl::HashGroup::size);
+		for (uint64_t bits = group.match(tag); bits != 0; bits = impl::HashGroup::next(bits))
+		{
+			size_t i = slots[g * impl::HashGroup::size + impl::HashGroup::first(bits)];
+			const Node & node = nodes[i];
+			if (node.hash == h && node.entry.first == key)
+				return i;
+		}
+		if (group.matchEmpty() != 0)
+			return notFound;
 	}
 }
 
-template<typename T> void List<T>::resize(size_t size)
+template<typename K, typename V, typename A> void Dictionary<K, V, A>::locateMany(const K * keys, size_t count, size_t * indices) const noexcept
 {
-	reserve(size);
-	if (size > n)
+	switch (widthOf(m))
 	{
-		nx::type::createArrayAt(items + n, size - n);
-		n = size;
+		case 1: locateManyIn<uint8_t>(keys, count, indices); break;
+		case 2: locateManyIn<uint16_t>(keys, count, indices); break;
+		case 4: locateManyIn<uint32_t>(keys, count, indices); break;
+		default: locateManyIn<uint64_t>(keys, count, indices); break;
 	}
-	if (size < n)
+}
+
+template<typename K, typename V, typename A> template<typename I> void Dictionary<K, V, A>::locateManyIn(const K * keys, size_t count, size_t * indices) const noexcept
+{
+	if (n == 0)
 	{
-		nx::type::destroyArrayAt(items + size, n - size);
-		n = size;
+		for (size_t j = 0; j < count; ++ j)
+			indices[j] = notFound;
+		return;
+	}
+
+	// The control bytes and the indices of the first group of every key are requested first
+	const I * slots = reinterpret_cast<const I *>(table + 2 * m);
+	size_t mask = 2 * m / impl::HashGroup::size - 1;
+	uintptr_t hashes[batch];
+	for (size_t j = 0; j < count; ++ j)
+	{
+		hashes[j] = hashOf(keys[j]);
+		size_t g = hashes[j] & mask;
+		__builtin_prefetch(table + g * impl::HashGroup::size);
+		__builtin_prefetch(slots + g * impl::HashGroup::size);
+	}
+
+	// Then the node of the first match in each group (usually the node of the key)
+	for (size_t j = 0; j < count; ++ j)
+	{
+		size_t g = hashes[j] & mask;
+		uint64_t bits = impl::HashGroup(table + g * impl::HashGroup::size).match(impl::HashGroup::tagOf(hashes[j]));
+		if (bits != 0)
+			__builtin_prefetch(nodes + slots[g * impl::HashGroup::size + impl::HashGroup::first(bits)]);
+	}
+
+	// And the keys are resolved, when their memory has (probably) arrived
+	for (size_t j = 0; j < count; ++ j)
+		indices[j] = locateIn<I>(keys[j], hashes[j]);
+}
+
+template<typename K, typename V, typename A> void Dictionary<K, V, A>::link(size_t i, uintptr_t h) noexcept
+{
+	switch (widthOf(m))
+	{
+		case 1: linkIn<uint8_t>(i, h); break;
+		case 2: linkIn<uint16_t>(i, h); break;
+		case 4: linkIn<uint32_t>(i, h); break;
+		default: linkIn<uint64_t>(i, h); break;
 	}
 }
 
-template<typename T> void List<T>::reserve(size_t size)
+template<typename K, typename V, typename A> template<typename I> void Dictionary<K, V, A>::linkIn(size_t i, uintptr_t h) noexcept
 {
-	if (size > m)
+	I * slots = reinterpret_cast<I *>(table + 2 * m);
+	size_t mask = 2 * m / impl::HashGroup::size - 1;
+	size_t g = h & mask;
+	uint64_t bits = impl::HashGroup(table + g * impl::HashGroup::size).matchFree();
+	while (bits == 0)
 	{
-		List list;
-		list.items = nx::type::alloc<T>(sizeof(T) * size);
-		nx::type::confirm(list.items);
-		
-		if (items)
+		g = (g + 1) & mask;
+		bits = impl::HashGroup(table + g * impl::HashGroup::size).matchFree();
+	}
+
+	size_t j = g * impl::HashGroup::size + impl::HashGroup::first(bits);
+	table[j] = impl::HashGroup::tagOf(h);
+	slots[j] = static_cast<I>(i);
+}
+
+template<typename K, typename V, typename A> template<typename... TS> typename Dictionary<K, V, A>::Entry & Dictionary<K, V, A>::append(uintptr_t h, TS && ... args)
+{
+	// Make room for the node - compact if at least half of the nodes are erased, grow otherwise (the arguments may be
+	// in the old nodes, so the entry is made before they are freed)
+	if (u == m)
+	{
+		Entry entry(forward<TS>(args) ...);
+		rehash(m == 0 ? 8 : n <= m / 2 ? m : 2 * m);
+		return append(h, rvalue(entry));
+	}
+
+	// The hash is set after the entry, so a throwing constructor leaves an empty node
+	Node & node = nodes[u];
+	node.create(forward<TS>(args) ...);
+	node.hash = h;
+	link(u, h);
+	u ++;
+	n ++;
+	return node.entry;
+}
+
+template<typename K, typename V, typename A> void Dictionary<K, V, A>::rehash(size_t capacity)
+{
+	Node * buffer = static_cast<Node *>(allocator().alloc(sizeof(Node) * capacity, alignof(Node)));
+	nx::type::confirm(buffer);
+	byte * index = static_cast<byte *>(allocator().alloc(tableSize(capacity), 16));
+	if (!index)
+		allocator().free(buffer, sizeof(Node) * capacity, alignof(Node));
+	nx::type::confirm(index);
+	__builtin_memset(index, impl::HashGroup::empty, 2 * capacity);
+
+	// Live entries are moved in insertion order (as bytes, if they can be), and every node of the old list is left empty
+	size_t j = 0;
+	for (size_t i = 0; i < u; ++ i)
+		if (nodes[i].hash != 0)
 		{
-			nx::type::createArrayAtByMove(list.items, items, n);
-			nx::type::destroyArrayAt(items, n);
-			nx::type::free(items);
+			if (nx::type::isTriviallyRelocatable<Entry>())
+				__builtin_memcpy(static_cast<void *>(buffer + j), static_cast<const void *>(nodes + i), sizeof(Node));
+			else
+			{
+				nx::type::createAt(buffer + j);
+				buffer[j].create(rvalue(nodes[i].entry));
+				buffer[j].hash = nodes[i].hash;
+				nodes[i].destroy();
+			}
+			nodes[i].hash = 0;
+			++ j;
 		}
-		
-		m = size;
-		items = list.items;
-		list.items = nullptr;
-	}
+	for (size_t i = j; i < capacity; ++ i)
+		nx::type::createAt(buffer + i);
+
+	release();
+	u = j;
+	m = capacity;
+	nodes = buffer;
+	table = index;
+	for (size_t i = 0; i < u; ++ i)
+		link(i, nodes[i].hash);
 }
 
-template<typename T> void List<T>::compact()
+template<typename K, typename V, typename A> void Dictionary<K, V, A>::release() noexcept
 {
-	if (items)
+	// Empty nodes have nothing to destroy
+	if (nodes)
+		allocator().free(nodes, sizeof(Node) * m, alignof(Node));
+	if (table)
+		allocator().free(table, tableSize(m), 16);
+}
+
+
+// ------------------------------------------------------------ //
+//		ConcurrentDictionary Implementation
+// ------------------------------------------------------------ //
+
+// Node - immutable after it's published, except the link to the next node
+template<typename K, typename V, typename A> struct ConcurrentDictionary<K, V, A>::Node
+{
+	uintptr_t hash;
+	Node *    next;
+	Entry     entry;
+
+	Node(uintptr_t hash, const K & key, const V & value)
+		: hash(hash), next(nullptr), entry(key, value) {}
+};
+
+// Table - header of the bucket array (the buckets follow the header)
+template<typename K, typename V, typename A> struct ConcurrentDictionary<K, V, A>::Table
+{
+	// Number of buckets, and the table the buckets are moved to
+	size_t  size;
+	Table * next;
+
+	// Number of buckets claimed by writers, and the number of buckets moved
+	size_t  claimed;
+	size_t  done;
+
+	inline Node ** buckets() noexcept
+		{return reinterpret_cast<Node **>(this + 1);}
+	inline Node * const * buckets() const noexcept
+		{return reinterpret_cast<Node * const *>(this + 1);}
+};
+
+// Guard - publishes the epoch of the calling thread, while it's in the dictionary
+template<typename K, typename V, typename A> class ConcurrentDictionary<K, V, A>::Guard
+{
+public:
+	explicit Guard(const ConcurrentDictionary & dict) noexcept
+		: dict(dict), i(mem::threadIndex()), nested(false)
 	{
-		if (n > 0)
+		if (i < mem::maxThreads)
 		{
-			List list;
-			list.items = nx::type::alloc<T>(sizeof(T) * n);
-			nx::type::confirm(list.items);
-			
-			nx::type::createArrayAtByMove(list.items, items, n);
-			nx::type::destroyArrayAt(items, n);
-			nx::type::free(items);
-			
-			m = n;
-			items = list.items;
-			list.items = nullptr;
+			// Only the thread itself writes its slot, so a nested guard sees its own epoch
+			uint64_t & slot = dict.slots[i].epoch;
+			if (__atomic_load_n(& slot, __ATOMIC_RELAXED) != 0)
+			{
+				nested = true;
+				return;
+			}
+			__atomic_store_n(& slot, __atomic_load_n(& dict.epoch, __ATOMIC_SEQ_CST), __ATOMIC_RELAXED);
 		}
 		else
+			__atomic_fetch_add(& dict.others, 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+
+	~Guard()
+	{
+		if (nested)
+			return;
+		if (i < mem::maxThreads)
+			__atomic_store_n(& dict.slots[i].epoch, 0, __ATOMIC_RELEASE);
+		else
+			__atomic_fetch_sub(& dict.others, 1, __ATOMIC_RELEASE);
+	}
+
+private:
+	const ConcurrentDictionary & dict;
+	size_t i;
+	bool   nested;
+};
+
+template<typename K, typename V, typename A> void ConcurrentDictionary<K, V, A>::Lock::lock() noexcept
+{
+	while (__atomic_exchange_n(& flag, 1, __ATOMIC_ACQUIRE))
+		while (__atomic_load_n(& flag, __ATOMIC_RELAXED))
 		{
-			m = 0;
-			items = nullptr;
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#endif
 		}
-	}
 }
 
-template<typename T> void List<T>::append(T && item)
+template<typename K, typename V, typename A> ConcurrentDictionary<K, V, A>::~ConcurrentDictionary()
 {
-	if (n + 1 > m)
+	// Nobody is in the dictionary anymore, so everything can be released
+	for (const Retired & item : retired)
+		item.node ? releaseNode(item.node) : releaseTable(item.table);
+
+	for (Table * t = table; t; )
 	{
-		// Exponential growth with a 1.5 base (starting from 16)
-		m = m > 16 ? m : 16; 
-		reserve(m + (m >> 1));
+		for (size_t i = 0; i < t->size; ++ i)
+			for (Node * node = t->buckets()[i]; node && node != moved(); )
+			{
+				Node * next = node->next;
+				releaseNode(node);
+				node = next;
+			}
+		Table * next = t->next;
+		releaseTable(t);
+		t = next;
 	}
-	
-	nx::type::createAt(items + n, static_cast<T &&>(item));
-	n ++;
+
+	allocator().free(locks, sizeof(Lock) * stripes, 64);
+	allocator().free(slots, sizeof(Slot) * mem::maxThreads, 64);
 }
 
-template<typename T> void List<T>::append(const T & item)
+template<typename K, typename V, typename A> bool ConcurrentDictionary<K, V, A>::get(const K & key, V & value) const
 {
-	if (n + 1 > m)
-	{
-		// Exponential growth with a 1.5 base (starting from 16)
-		m = m > 16 ? m : 16;
-		reserve(m + (m >> 1));
-	}
-	
-	nx::type::createAt(items + n, item);
-	n ++;
+	Guard guard(* this);
+	const Node * node = find(key, hashOf(key));
+	if (!node)
+		return false;
+	value = node->entry.second;
+	return true;
 }
 
-template<typename T> void List<T>::extend(List<T> && list)
+template<typename K, typename V, typename A> V ConcurrentDictionary<K, V, A>::get(const K & key, const V & def) const
 {
-	if (list.n > 0)
-	{
-		size_t x = m > 16 ? m : 16;
-		while (n + list.n > x)
+	Guard guard(* this);
+	const Node * node = find(key, hashOf(key));
+	return node ? node->entry.second : def;
+}
+
+template<typename K, typename V, typename A> bool ConcurrentDictionary<K, V, A>::contains(const K & key) const noexcept
+{
+	Guard guard(* this);
+	return find(key, hashOf(key)) != nullptr;
+}
+
+template<typename K, typename V, typename A> template<typename F> void ConcurrentDictionary<K, V, A>::forEach(F && func) const
+{
+	Guard guard(* this);
+	const Table * t = __atomic_load_n(& table, __ATOMIC_ACQUIRE);
+	for (size_t i = 0; i < t->size; ++ i)
+		forEachIn(t, i, func);
+}
+
+template<typename K, typename V, typename A> bool ConcurrentDictionary<K, V, A>::insert(const K & key, const V & value)
+{
+	uintptr_t h = hashOf(key);
+	Guard guard(* this);
+	help();
+
+	// The node is created before the lock is taken, so the lock is only held for a few loads and stores
+	Node * fresh = createNode(h, key, value);
+	Lock & lock = locks[h & (stripes - 1)];
+	lock.lock();
+	Node ** bucket = bucketOf(h);
+	for (Node ** link = bucket; Node * node = __atomic_load_n(link, __ATOMIC_ACQUIRE); link = & node->next)
+		if (node->hash == h && node->entry.first == key)
 		{
-			x = x + (x >> 1);
+			// Readers see either the old node or the new one, but never a half written value
+			fresh->next = node->next;
+			__atomic_store_n(link, fresh, __ATOMIC_RELEASE);
+			lock.unlock();
+			retire(node, nullptr);
+			return false;
 		}
-		reserve(x);
 
-		nx::type::createArrayAtByMove(items + n, list.items, list.n);
-		n += list.n;
-	}
+	fresh->next = * bucket;
+	__atomic_store_n(bucket, fresh, __ATOMIC_RELEASE);
+	size_t count = __atomic_add_fetch(& n, 1, __ATOMIC_RELAXED);
+	lock.unlock();
+
+	Table * t = __atomic_load_n(& table, __ATOMIC_ACQUIRE);
+	if (count > t->size / 4 * 3)
+		grow(t);
+	return true;
 }
 
-template<typename T> void List<T>::extend(const List<T> & list)
+template<typename K, typename V, typename A> bool ConcurrentDictionary<K, V, A>::erase(const K & key)
 {
-	if (list.n > 0)
+	uintptr_t h = hashOf(key);
+	Guard guard(* this);
+	help();
+
+	Lock & lock = locks[h & (stripes - 1)];
+	lock.lock();
+	for (Node ** link = bucketOf(h); Node * node = __atomic_load_n(link, __ATOMIC_ACQUIRE); link = & node->next)
+		if (node->hash == h && node->entry.first == key)
+		{
+			// Readers on the node can still follow its link
+			__atomic_store_n(link, node->next, __ATOMIC_RELEASE);
+			__atomic_sub_fetch(& n, 1, __ATOMIC_RELAXED);
+			lock.unlock();
+			retire(node, nullptr);
+			return true;
+		}
+	lock.unlock();
+	return false;
+}
+
+template<typename K, typename V, typename A> void ConcurrentDictionary<K, V, A>::init()
+{
+	n = 0;
+	epoch = 1;
+	others = 0;
+	retireLock.flag = 0;
+	collectAt = collectLimit;
+
+	locks = static_cast<Lock *>(allocator().alloc(sizeof(Lock) * stripes, 64));
+	slots = static_cast<Slot *>(allocator().alloc(sizeof(Slot) * mem::maxThreads, 64));
+	nx::type::confirm(locks, slots);
+	__builtin_memset(static_cast<void *>(locks), 0, sizeof(Lock) * stripes);
+	__builtin_memset(static_cast<void *>(slots), 0, sizeof(Slot) * mem::maxThreads);
+	table = createTable(stripes);
+}
+
+template<typename K, typename V, typename A> typename ConcurrentDictionary<K, V, A>::Node * ConcurrentDictionary<K, V, A>::createNode(uintptr_t h, const K & key, const V & value)
+{
+	Node * node = static_cast<Node *>(allocator().alloc(sizeof(Node), alignof(Node)));
+	nx::type::confirm(node);
+	return nx::type::createAt(node, h, key, value);
+}
+
+template<typename K, typename V, typename A> void ConcurrentDictionary<K, V, A>::releaseNode(Node * node) noexcept
+{
+	nx::type::destroyAt(node);
+	allocator().free(node, sizeof(Node), alignof(Node));
+}
+
+template<typename K, typename V, typename A> typename ConcurrentDictionary<K, V, A>::Table * ConcurrentDictionary<K, V, A>::createTable(size_t size)
+{
+	Table * t = static_cast<Table *>(allocator().alloc(sizeof(Table) + sizeof(Node *) * size, alignof(Table)));
+	nx::type::confirm(t);
+	t->size = size;
+	t->next = nullptr;
+	t->claimed = 0;
+	t->done = 0;
+	__builtin_memset(static_cast<void *>(t->buckets()), 0, sizeof(Node *) * size);
+	return t;
+}
+
+template<typename K, typename V, typename A> void ConcurrentDictionary<K, V, A>::releaseTable(Table * t) noexcept
+{
+	allocator().free(t, sizeof(Table) + sizeof(Node *) * t->size, alignof(Table));
+}
+
+template<typename K, typename V, typename A> const typename ConcurrentDictionary<K, V, A>::Node * ConcurrentDictionary<K, V, A>::find(const K & key, uintptr_t h) const noexcept
+{
+	const Table * t = __atomic_load_n(& table, __ATOMIC_ACQUIRE);
+	for (;;)
 	{
-		size_t x = m > 16 ? m : 16;
-		while (n + list.n > x)
+		const Node * node = __atomic_load_n(& t->buckets()[h & (t->size - 1)], __ATOMIC_ACQUIRE);
+		if (node == moved())
 		{
-			x = x + (x >> 1);
+			t = __atomic_load_n(& t->next, __ATOMIC_ACQUIRE);
+			continue;
 		}
-		reserve(x);
 
-		nx::type::createArrayAtByCopy(items + n, list.items, list.n);
-		n += list.n;
+		for (; node; node = __atomic_load_n(& node->next, __ATOMIC_ACQUIRE))
+			if (node->hash == h && node->entry.first == key)
+				return node;
+		return nullptr;
 	}
 }
 
-template<typename T> List<T> & List<T>::operator = (List<T> && list) noexcept
+template<typename K, typename V, typename A> typename ConcurrentDictionary<K, V, A>::Node ** ConcurrentDictionary<K, V, A>::bucketOf(uintptr_t h) const noexcept
 {
-	swap(* this, list);
-	return * this;
+	// The lock of the hash is held, so the bucket can't be moved while it's used
+	Table * t = __atomic_load_n(& table, __ATOMIC_ACQUIRE);
+	for (;;)
+	{
+		Node ** bucket = & t->buckets()[h & (t->size - 1)];
+		if (__atomic_load_n(bucket, __ATOMIC_ACQUIRE) != moved())
+			return bucket;
+		t = __atomic_load_n(& t->next, __ATOMIC_ACQUIRE);
+	}
 }
 
-template<typename T> List<T> & List<T>::operator = (const List<T> & list)
+template<typename K, typename V, typename A> template<typename F> void ConcurrentDictionary<K, V, A>::forEachIn(const Table * t, size_t i, F & func) const
 {
-	// TODO: use operator = here
-	return * this;
+	const Node * node = __atomic_load_n(& t->buckets()[i], __ATOMIC_ACQUIRE);
+	if (node == moved())
+	{
+		const Table * next = __atomic_load_n(& t->next, __ATOMIC_ACQUIRE);
+		forEachIn(next, i, func);
+		forEachIn(next, i + t->size, func);
+		return;
+	}
+	for (; node; node = __atomic_load_n(& node->next, __ATOMIC_ACQUIRE))
+		func(node->entry.first, node->entry.second);
 }
 
-template<typename T> void swap(List<T> & left, List<T> & right) noexcept
+template<typename K, typename V, typename A> void ConcurrentDictionary<K, V, A>::grow(Table * t)
 {
-	swap(left.n, right.n);
-	swap(left.m, right.m);
-	swap(left.items, right.items);
+	// Only one resize at a time (a table, that was already moved on, has a next table too)
+	if (__atomic_load_n(& t->next, __ATOMIC_ACQUIRE) != nullptr)
+		return;
+	Table * next = createTable(2 * t->size);
+	Table * expected = nullptr;
+	if (!__atomic_compare_exchange_n(& t->next, & expected, next, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+	{
+		releaseTable(next);
+		return;
+	}
+	help();
 }
 
+template<typename K, typename V, typename A> void ConcurrentDictionary<K, V, A>::help()
+{
+	Table * t = __atomic_load_n(& table, __ATOMIC_ACQUIRE);
+	if (__atomic_load_n(& t->next, __ATOMIC_ACQUIRE) == nullptr)
+		return;
+
+	size_t first = __atomic_fetch_add(& t->claimed, moveChunk, __ATOMIC_RELAXED);
+	if (first >= t->size)
+		return;
+	size_t last = first + moveChunk < t->size ? first + moveChunk : t->size;
+	for (size_t i = first; i < last; ++ i)
+		move(t, i);
+
+	// The writer, that moves the last bucket, switches to the new table
+	if (__atomic_add_fetch(& t->done, last - first, __ATOMIC_ACQ_REL) == t->size)
+	{
+		__atomic_store_n(& table, t->next, __ATOMIC_RELEASE);
+		retire(nullptr, t);
+	}
+}
 
-// ------------------------------------------------------------ //
-//		Set Implementation
-// ------------------------------------------------------------ //
+template<typename K, typename V, typename A> void ConcurrentDictionary<K, V, A>::move(Table * t, size_t i)
+{
+	Table * next = __atomic_load_n(& t->next, __ATOMIC_ACQUIRE);
+	Lock & lock = locks[i & (stripes - 1)];
+	lock.lock();
+
+	// The nodes are copied (readers may still be on the old chain), to buckets i and i + size of the new table. Nobody
+	// else writes these buckets, until the old bucket is marked.
+	Node * head = __atomic_load_n(& t->buckets()[i], __ATOMIC_ACQUIRE);
+	for (Node * node = head; node; node = node->next)
+	{
+		Node * copy = createNode(node->hash, node->entry.first, node->entry.second);
+		Node ** bucket = & next->buckets()[node->hash & (next->size - 1)];
+		copy->next = * bucket;
+		__atomic_store_n(bucket, copy, __ATOMIC_RELEASE);
+	}
+	__atomic_store_n(& t->buckets()[i], moved(), __ATOMIC_RELEASE);
+	lock.unlock();
 
-// ------------------------------------------------------------ //
-//		Dictionary Implementation
-// ------------------------------------------------------------ //
+	while (head)
+	{
+		Node * node = head;
+		head = head->next;
+		retire(node, nullptr);
+	}
+}
 
-/**
-	[CLASS] Dictionary Node - Stores dictionary entries with their hashes
-	
-	Implementation:
-	
-	The hash value 0 is remapped, and used to indicate empty nodes. Empty nodes are nodes, without a constructed entry
-	inside them. These nodes are managed by the 
- */
-template<typename K, typename V> struct Dictionary<K, V>::Node
+template<typename K, typename V, typename A> void ConcurrentDictionary<K, V, A>::retire(Node * node, Table * t)
 {
-	// Fields
-	uintptr_t hash;
-	union
+	// The object is unlinked, so only readers, that entered before this epoch, can still see it
+	Retired item = {node, t, __atomic_load_n(& epoch, __ATOMIC_SEQ_CST)};
+	retireLock.lock();
+	retired.append(item);
+	if (retired.size() >= collectAt)
+		collect();
+	retireLock.unlock();
+}
+
+template<typename K, typename V, typename A> void ConcurrentDictionary<K, V, A>::collect() noexcept
+{
+	// The epoch advances, when every reader is in the current epoch (or not in the dictionary)
+	uint64_t e = __atomic_load_n(& epoch, __ATOMIC_SEQ_CST);
+	bool advance = __atomic_load_n(& others, __ATOMIC_SEQ_CST) == 0;
+	for (size_t i = 0; advance && i < mem::maxThreads; ++ i)
 	{
-		Entry entry;
-	};
-	
-	// Constructors & destructors
-	Node() noexcept
-		: hash(0) {}
-	~Node()
-		{if (hash != 0) destroy();}
-	
-	// Create and destroy the entry
-	template<typename ... TS> void create(TS && ... args) noexcept(nx::type::hasNoexceptCreate<Entry, TS ...>())
-		{nx::type::createAt(& entry, forward<TS &&>(args) ...);}
-	void destroy() noexcept(nx::type::hasNoexceptDestroy<Entry>())
-		{nx::type::destroyAt(& entry);}
-		
-	// Copy and move isn't needed
-	Node & operator = (Node && node) = delete;
-	Node & operator = (const Node & node) = delete;
-};
+		uint64_t x = __atomic_load_n(& slots[i].epoch, __ATOMIC_SEQ_CST);
+		advance = x == 0 || x == e;
+	}
+	if (advance)
+		__atomic_store_n(& epoch, ++ e, __ATOMIC_SEQ_CST);
+
+	// Objects retired two epochs ago can't be seen by any reader
+	size_t j = 0;
+	for (size_t i = 0; i < retired.size(); ++ i)
+	{
+		Retired & item = retired[i];
+		if (item.epoch + 2 <= e)
+			item.node ? releaseNode(item.node) : releaseTable(item.table);
+		else
+			retired[j ++] = item;
+	}
+	retired.resize(j);
+
+	// A reader, that stays in the dictionary, holds back every object retired after it entered
+	collectAt = 2 * j + collectLimit;
+}
 
 // Close namespace "nx"
 }
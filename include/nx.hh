@@ -4,5 +4,6 @@
 // Local includes
 #include "nx-core.hh"
 #include "nx-new.hh"
+#include "nx-mem.hh"
 #include "nx-ptr.hh"
 #include "nx-type.hh"
@@ -0,0 +1,59 @@
+// Header include
+#include "nx-mem.hh"
+
+// Namespace "nx::mem"
+namespace nx { namespace mem {
+
+// Anonymous namespace - Thread indices
+namespace {
+
+// Indices in use (one bit per index)
+uint64_t threadIndices = 0;
+
+// Releases the index of the thread, when it exits
+struct ThreadIndexGuard
+{
+	size_t * index = nullptr;
+
+	~ThreadIndexGuard() noexcept
+	{
+		if (!index || * index > maxThreads)
+			return;
+
+		// Code running later in the exit of this thread must not use the index anymore
+		size_t value = * index - 1;
+		* index = maxThreads + 1;
+		__atomic_fetch_and(& threadIndices, ~(uint64_t(1) << value), __ATOMIC_RELEASE);
+	}
+};
+
+thread_local ThreadIndexGuard threadIndexGuard;
+
+// Close anonymous namespace
+}
+
+static_assert(maxThreads <= 64, "Thread indices are allocated from a 64 bit mask");
+
+size_t claimThreadIndex(size_t & index) noexcept
+{
+	uint64_t used = __atomic_load_n(& threadIndices, __ATOMIC_RELAXED);
+	for (;;)
+	{
+		if (~used == 0)
+		{
+			index = maxThreads + 1;
+			return maxThreads;
+		}
+
+		size_t value = __builtin_ctzll(~used);
+		if (__atomic_compare_exchange_n(& threadIndices, & used, used | (uint64_t(1) << value), true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			index = value + 1;
+			threadIndexGuard.index = & index;
+			return value;
+		}
+	}
+}
+
+// Close namespace "nx::mem"
+}}
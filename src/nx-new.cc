@@ -2,24 +2,1497 @@
 #include "nx-new.hh"
 
 // Standard includes
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#if defined(__GLIBC__)
+	#include <malloc.h>
+	#include <execinfo.h>
+#endif
+
+// Platform includes
+#if defined(_WIN32)
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+#endif
+
+/**
+	Global allocator
+
+	Small allocations (up to 32 KB) are rounded up to one of 40 size classes, and served from per-thread caches. Each
+	thread cache is a set of singly linked free lists (one per size class), that can be used without any locking. When
+	a thread cache runs dry, it is refilled with a batch of blocks from the central free list of that size class, and
+	when it grows too long, a batch is flushed back. The central free lists carve new blocks from spans, which are
+	allocated from large regions requested from the OS.
+
+	Memory is requested from the OS in 64 KB aligned chunks, and every chunk belonging to the allocator is recorded in
+	the chunk map, along with its size class. This is how `operator delete` finds the size class of a block, and how it
+	recognizes large blocks, that were passed on to `malloc`.
+
+	Allocations above the map threshold are mapped from the OS directly. The mapping starts with a header (holding its
+	length), and its first chunk is recorded in the chunk map with a special class, so it can be unmapped when freed.
+
+	Statistics are counted per thread (a single non-atomic increment on the fast path), and only aggregated when they
+	are read. Live bytes are published to a global counter on the slow paths, to keep track of the peak.
+
+	The sampling heap profiler counts down the allocated bytes in every thread, and records a stack trace, when the
+	countdown runs out. Sampled addresses are kept in a lock-free table, so their deallocation can be recorded as well.
+	While the profiler is stopped, the fast paths only pay for the countdown, and a flag check on deallocation.
+
+	Failed allocations are retried after the reclaim callbacks of the application released memory. This is outside of
+	the fast paths, which only check the result for null.
+ */
+
+// Namespace "nx::mem"
+namespace nx { namespace mem {
+
+// Anonymous namespace - Internals of the global allocator
+namespace {
+
+// ------------------------------------------------------------ //
+//		Constants
+// ------------------------------------------------------------ //
+
+// Chunks are the granularity of the chunk map, and the alignment of all memory requested from the OS
+constexpr size_t CHUNK_BITS = 16;
+constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+
+// New regions are requested from the OS in these units
+constexpr size_t REGION_SIZE = 64 * CHUNK_SIZE;
+
+// Allocations up to this size are served from size classes, larger ones are passed on to malloc
+constexpr size_t SMALL_LIMIT = 32768;
+
+// Number of size classes (size class 0 is reserved for memory, that doesn't belong to the allocator)
+constexpr size_t CLASSES = 41;
+
+// Chunk map class of directly mapped blocks
+constexpr size_t MAPPED_CLASS = 255;
+
+// Size of (transparent or explicit) huge pages
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// Natural alignment of all blocks
+constexpr size_t NEW_ALIGNMENT = nx::type::newAlignment;
+
+// Chunk map layout - addresses are at most 48 bits wide on 64 bit platforms
+constexpr size_t ADDRESS_BITS = sizeof(void *) == 8 ? 48 : 32;
+constexpr size_t MAP_BITS = ADDRESS_BITS - CHUNK_BITS;
+constexpr size_t LEAF_BITS = MAP_BITS < 16 ? MAP_BITS : 16;
+constexpr size_t ROOT_BITS = MAP_BITS - LEAF_BITS;
+
+// ------------------------------------------------------------ //
+//		Size classes
+// ------------------------------------------------------------ //
+
+// Index of the highest set bit
+inline size_t highestBit(size_t x) noexcept
+{
+	return 63 - __builtin_clzll(static_cast<unsigned long long>(x));
+}
+
+// Size class of an allocation - sizes up to 128 bytes are rounded to 16 bytes, larger ones to a quarter of their power of two
+inline size_t classOf(size_t size) noexcept
+{
+	if (size <= 128)
+		return size ? (size + 15) >> 4 : 1;
+
+	size_t k = highestBit(size - 1);
+	return ((k - 7) << 2) + ((size - 1) >> (k - 2)) + 5;
+}
+
+// Block size of a size class
+inline size_t classSize(size_t c) noexcept
+{
+	if (c <= 8)
+		return c << 4;
+
+	size_t k = 7 + ((c - 9) >> 2);
+	return (size_t(1) << k) + (((c - 9) & 3) + 1) * (size_t(1) << (k - 2));
+}
+
+// Number of blocks moved between the thread cache and the central free list at once
+inline size_t batchOf(size_t c) noexcept
+{
+	size_t n = SMALL_LIMIT / classSize(c);
+	return n < 2 ? 2 : n > 64 ? 64 : n;
+}
+
+// Size of the spans, that the blocks of a size class are carved from (at least 8 blocks, rounded to chunks)
+inline size_t spanOf(size_t c) noexcept
+{
+	return (8 * classSize(c) + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1);
+}
+
+// ------------------------------------------------------------ //
+//		Synchronization
+// ------------------------------------------------------------ //
+
+// Spin lock - allocator locks are only held for a few instructions (except when new memory is requested from the OS)
+struct Lock
+{
+	int flag;
+
+	void lock() noexcept
+	{
+		while (__atomic_exchange_n(& flag, 1, __ATOMIC_ACQUIRE))
+			while (__atomic_load_n(& flag, __ATOMIC_RELAXED))
+			{
+#if defined(__x86_64__) || defined(__i386__)
+				__builtin_ia32_pause();
+#endif
+			}
+	}
+
+	void unlock() noexcept
+		{__atomic_store_n(& flag, 0, __ATOMIC_RELEASE);}
+};
+
+// Scoped lock
+struct Locked
+{
+	Lock & target;
+
+	Locked(Lock & lock) noexcept
+		: target(lock) {target.lock();}
+	~Locked() noexcept
+		{target.unlock();}
+};
+
+// ------------------------------------------------------------ //
+//		Operating system
+// ------------------------------------------------------------ //
+
+// Request memory from the OS (size is a multiple of the chunk size, align is a power of two, at least the chunk size)
+void * mapAligned(size_t size, size_t align) noexcept
+{
+#if defined(_WIN32)
+	// VirtualAlloc returns memory aligned to the allocation granularity (64 KB), larger alignments are not supported
+	return skip(align), VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	// Map an extra alignment, and trim the unaligned head and tail
+	void * ptr = mmap(nullptr, size + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return nullptr;
+
+	uintptr_t base = reinterpret_cast<uintptr_t>(ptr);
+	uintptr_t aligned = (base + align - 1) & ~(align - 1);
+	if (aligned > base)
+		munmap(ptr, aligned - base);
+	munmap(reinterpret_cast<void *>(aligned + size), base + align - aligned);
+	return reinterpret_cast<void *>(aligned);
+#endif
+}
+
+// Request memory from the OS (aligned to the chunk size)
+inline void * mapChunks(size_t size) noexcept
+{
+	return mapAligned(size, CHUNK_SIZE);
+}
+
+// Request memory for a directly mapped block (the size may be rounded up to the huge page size, and the mode is set to
+// the one actually used)
+void * mapDirect(size_t & size, HugePages & mode) noexcept
+{
+#if defined(_WIN32)
+	mode = HugePages::none;
+	return mapChunks(size);
+#else
+	#if defined(MAP_HUGETLB)
+	// Explicit huge pages are aligned to their size, and fall back to normal pages, if none are available
+	if (mode == HugePages::hugetlb)
+	{
+		size_t rounded = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+		void * ptr = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED)
+		{
+			size = rounded;
+			return ptr;
+		}
+		mode = HugePages::transparent;
+	}
+	#endif
+
+	// Transparent huge pages can only back huge page aligned memory
+	bool huge = mode != HugePages::none && size >= HUGE_PAGE_SIZE;
+	void * ptr = mapAligned(size, huge ? HUGE_PAGE_SIZE : CHUNK_SIZE);
+	#if defined(MADV_HUGEPAGE)
+	if (ptr && huge)
+		madvise(ptr, size, MADV_HUGEPAGE);
+	#endif
+	return ptr;
+#endif
+}
+
+// Return memory to the OS
+void unmap(void * ptr, size_t size) noexcept
+{
+#if defined(_WIN32)
+	skip(size), VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+	munmap(ptr, size);
+#endif
+}
+
+// ------------------------------------------------------------ //
+//		Chunk map
+// ------------------------------------------------------------ //
+
+// Two level radix tree, mapping every chunk of the address space to a size class (or to 0, if it's not ours)
+uint8_t * chunkMap[size_t(1) << ROOT_BITS];
+
+// Size class of the chunk containing the pointer
+inline size_t classOfChunk(const void * ptr) noexcept
+{
+	uintptr_t id = reinterpret_cast<uintptr_t>(ptr) >> CHUNK_BITS;
+	if (id >> MAP_BITS)
+		return 0;
+
+	uint8_t * leaf = __atomic_load_n(& chunkMap[id >> LEAF_BITS], __ATOMIC_ACQUIRE);
+	return leaf ? leaf[id & ((size_t(1) << LEAF_BITS) - 1)] : 0;
+}
+
+// Record the size class of the chunks in [ptr, ptr + size) - Only called with the region lock held
+bool registerChunks(const void * ptr, size_t size, size_t c) noexcept
+{
+	uintptr_t first = reinterpret_cast<uintptr_t>(ptr) >> CHUNK_BITS;
+	uintptr_t last = (reinterpret_cast<uintptr_t>(ptr) + size - 1) >> CHUNK_BITS;
+	if (last >> MAP_BITS)
+		return false;
+
+	for (uintptr_t id = first; id <= last; ++ id)
+	{
+		uint8_t * & slot = chunkMap[id >> LEAF_BITS];
+		uint8_t * leaf = slot;
+		if (!leaf)
+		{
+			// Leaves are requested from the OS directly, and are never released
+			leaf = static_cast<uint8_t *>(mapChunks(size_t(1) << LEAF_BITS));
+			if (!leaf)
+				return false;
+			__atomic_store_n(& slot, leaf, __ATOMIC_RELEASE);
+		}
+		leaf[id & ((size_t(1) << LEAF_BITS) - 1)] = static_cast<uint8_t>(c);
+	}
+	return true;
+}
+
+// ------------------------------------------------------------ //
+//		Regions
+// ------------------------------------------------------------ //
+
+// Current region - spans are carved from it, until it's exhausted
+Lock regionLock;
+char * regionNext;
+char * regionEnd;
+
+// Total size of the regions
+size_t regionBytes;
+
+// Allocate a new span for a size class
+char * allocSpan(size_t size, size_t c) noexcept
+{
+	Locked lock(regionLock);
+
+	if (static_cast<size_t>(regionEnd - regionNext) < size)
+	{
+		// The rest of the old region is abandoned (it is never touched, so it only costs address space)
+		size_t n = size > REGION_SIZE ? size : REGION_SIZE;
+		char * region = static_cast<char *>(mapChunks(n));
+		if (!region)
+			return nullptr;
+
+		regionNext = region;
+		regionEnd = region + n;
+		regionBytes += n;
+	}
+
+	if (!registerChunks(regionNext, size, c))
+		return nullptr;
+
+	char * span = regionNext;
+	regionNext += size;
+	return span;
+}
+
+// ------------------------------------------------------------ //
+//		Free lists
+// ------------------------------------------------------------ //
+
+// Free blocks are linked through their first word
+struct FreeBlock
+{
+	FreeBlock * next;
+};
+
+// Thread local free list of a size class
+struct FreeList
+{
+	FreeBlock * head;
+	uint32_t count;
+	uint32_t limit;
+};
+
+// Central free list of a size class
+struct Central
+{
+	Lock lock;
+	FreeBlock * head;
+
+	// Uncarved part of the current span
+	char * carve;
+	char * carveEnd;
+};
+
+// Allocation counters (written only by their thread)
+struct Counters
+{
+	uint64_t allocs[CLASSES];
+	uint64_t frees[CLASSES];
+
+	// Large allocations are counted separately, with their usable size
+	uint64_t largeAllocs;
+	uint64_t largeFrees;
+	uint64_t largeAllocBytes;
+	uint64_t largeFreeBytes;
+};
+
+// Thread cache (zero initialized, so accessing it needs no guard)
+struct ThreadCache
+{
+	FreeList lists[CLASSES];
+
+	// Thread cache state: active after the first slow path, dead after the thread started exiting
+	bool active;
+	bool dead;
+
+	// Statistics, and the live bytes already published to the global counter
+	Counters counters;
+	int64_t published;
+
+	// Profiler state: bytes until the next sample, random state for the sampling intervals, and reentrancy guard
+	int64_t countdown;
+	uint64_t random;
+	bool sampling;
+
+	// Set while the reclaim callbacks are called
+	bool reclaiming;
+
+	// Registry of active thread caches
+	ThreadCache * prev;
+	ThreadCache * next;
+};
+
+// Thread cache guard - flushes the thread cache, when the thread exits
+struct CacheGuard
+{
+	void touch() noexcept {}
+	~CacheGuard() noexcept;
+};
+
+Central centrals[CLASSES];
+thread_local ThreadCache cache;
+thread_local CacheGuard guard;
+
+// ------------------------------------------------------------ //
+//		Statistics
+// ------------------------------------------------------------ //
+
+// Registry of active thread caches, and the counters of the exited threads
+Lock registryLock;
+ThreadCache * registry;
+Counters retired;
+
+// Global live bytes (updated on the slow paths) and its highest value
+int64_t globalLive;
+int64_t globalPeak;
+
+// Increment a counter of this thread (relaxed atomics, so stats() can read it, but compiled as a plain add)
+inline void bump(uint64_t & counter, uint64_t n = 1) noexcept
+{
+	__atomic_store_n(& counter, __atomic_load_n(& counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+// Read the counter of any thread
+inline uint64_t peek(const uint64_t & counter) noexcept
+{
+	return __atomic_load_n(& counter, __ATOMIC_RELAXED);
+}
+
+// Live bytes of a set of counters
+int64_t liveOf(const Counters & counters) noexcept
+{
+	int64_t live = 0;
+	for (size_t c = 1; c < CLASSES; ++ c)
+		live += static_cast<int64_t>((peek(counters.allocs[c]) - peek(counters.frees[c])) * classSize(c));
+	return live + static_cast<int64_t>(peek(counters.largeAllocBytes) - peek(counters.largeFreeBytes));
+}
+
+// Add counters to an other set of counters
+void addTo(Counters & total, const Counters & counters) noexcept
+{
+	for (size_t c = 1; c < CLASSES; ++ c)
+	{
+		total.allocs[c] += peek(counters.allocs[c]);
+		total.frees[c] += peek(counters.frees[c]);
+	}
+	total.largeAllocs += peek(counters.largeAllocs);
+	total.largeFrees += peek(counters.largeFrees);
+	total.largeAllocBytes += peek(counters.largeAllocBytes);
+	total.largeFreeBytes += peek(counters.largeFreeBytes);
+}
+
+// Publish the live bytes of this thread, and update the peak
+void publish(ThreadCache & tc) noexcept
+{
+	int64_t live = liveOf(tc.counters);
+	int64_t delta = live - tc.published;
+	if (delta == 0)
+		return;
+
+	tc.published = live;
+	int64_t total = __atomic_add_fetch(& globalLive, delta, __ATOMIC_RELAXED);
+	int64_t peak = __atomic_load_n(& globalPeak, __ATOMIC_RELAXED);
+	while (total > peak && !__atomic_compare_exchange_n(& globalPeak, & peak, total, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// Move the counters of this thread to the retired counters (when the thread exits)
+void retire(ThreadCache & tc) noexcept
+{
+	publish(tc);
+
+	Locked lock(registryLock);
+	addTo(retired, tc.counters);
+	tc.counters = Counters();
+	tc.published = 0;
+
+	// Unlink from the registry (dead threads are not in the registry, their counters are retired on every slow path)
+	if (tc.prev || registry == & tc)
+	{
+		(tc.prev ? tc.prev->next : registry) = tc.next;
+		if (tc.next)
+			tc.next->prev = tc.prev;
+		tc.prev = tc.next = nullptr;
+	}
+}
+
+// ------------------------------------------------------------ //
+//		Thread cache
+// ------------------------------------------------------------ //
+
+// Activate the thread cache
+void activate(ThreadCache & tc) noexcept
+{
+	// Register the guard (allocations during thread exit may activate it again)
+	guard.touch();
+
+	for (size_t c = 1; c < CLASSES; ++ c)
+		tc.lists[c].limit = static_cast<uint32_t>(2 * batchOf(c));
+	tc.active = true;
+
+	// Register for statistics
+	Locked lock(registryLock);
+	tc.prev = nullptr;
+	tc.next = registry;
+	if (registry)
+		registry->prev = & tc;
+	registry = & tc;
+}
+
+
+// Allocate a batch of blocks from the central free list, return one, and keep the rest in the thread cache
+void * allocateSlow(size_t c) noexcept
+{
+	ThreadCache & tc = cache;
+	if (!tc.active && !tc.dead)
+		activate(tc);
+
+	Central & central = centrals[c];
+	size_t size = classSize(c);
+	size_t want = tc.dead ? 1 : batchOf(c);
+	size_t got = 0;
+	FreeBlock * head = nullptr;
+
+	{
+		Locked lock(central.lock);
+
+		// Take free blocks first
+		while (got < want && central.head)
+		{
+			FreeBlock * block = central.head;
+			central.head = block->next;
+			block->next = head;
+			head = block;
+			++ got;
+		}
+
+		// Carve new blocks from the span
+		while (got < want)
+		{
+			if (static_cast<size_t>(central.carveEnd - central.carve) < size)
+			{
+				size_t span = spanOf(c);
+				central.carve = allocSpan(span, c);
+				central.carveEnd = central.carve ? central.carve + span : nullptr;
+				if (!central.carve)
+					break;
+			}
+
+			FreeBlock * block = reinterpret_cast<FreeBlock *>(central.carve);
+			central.carve += size;
+			block->next = head;
+			head = block;
+			++ got;
+		}
+	}
+
+	// Out of memory
+	if (!head)
+		return nullptr;
+
+	FreeList & list = tc.lists[c];
+	list.head = head->next;
+	list.count = static_cast<uint32_t>(got - 1);
+
+	bump(tc.counters.allocs[c]);
+	tc.dead ? retire(tc) : publish(tc);
+	return head;
+}
+
+// Flush blocks from the thread cache back to the central free list, keeping at most one batch
+void deallocateSlow(size_t c) noexcept
+{
+	ThreadCache & tc = cache;
+	if (!tc.active && !tc.dead)
+	{
+		activate(tc);
+		if (tc.lists[c].count <= tc.lists[c].limit)
+			return;
+	}
+
+	FreeList & list = tc.lists[c];
+	size_t keep = tc.dead ? 0 : batchOf(c);
+	if (list.count <= keep)
+		return;
+
+	// Detach the blocks above the kept batch
+	size_t n = list.count - keep;
+	FreeBlock * head = list.head;
+	FreeBlock * tail = head;
+	for (size_t i = 1; i < n; ++ i)
+		tail = tail->next;
+	list.head = tail->next;
+	list.count = static_cast<uint32_t>(keep);
+
+	// Splice them onto the central free list
+	{
+		Central & central = centrals[c];
+		Locked lock(central.lock);
+		tail->next = central.head;
+		central.head = head;
+	}
+
+	tc.dead ? retire(tc) : publish(tc);
+}
+
+CacheGuard::~CacheGuard() noexcept
+{
+	ThreadCache & tc = cache;
+	tc.active = false;
+	tc.dead = true;
+
+	// Return everything, and stop caching (every later free goes through the slow path)
+	for (size_t c = 1; c < CLASSES; ++ c)
+	{
+		tc.lists[c].limit = 0;
+		deallocateSlow(c);
+	}
+	retire(tc);
+}
+
+// ------------------------------------------------------------ //
+//		Profiler
+// ------------------------------------------------------------ //
+
+// Number of stack frames recorded for a sample
+constexpr size_t MAX_FRAMES = 16;
+
+// Countdown while the profiler is stopped (threads notice a started profiler after allocating this much)
+constexpr int64_t IDLE_COUNTDOWN = 1 << 20;
+
+// Profiler event - written to the ring buffer lock-free, seq is 0 while the event is being written
+struct Event
+{
+	uint64_t seq;
+	uint64_t kind;
+	uint64_t address;
+	uint64_t size;
+	uint64_t depth;
+	uint64_t frames[MAX_FRAMES];
+};
+
+// Event kinds
+constexpr uint64_t EVENT_ALLOC = 1;
+constexpr uint64_t EVENT_FREE = 2;
+
+// Profiler buffers: the ring buffer of events, and a lock-free open addressing table of sampled addresses (0 is empty,
+// 1 is a deleted slot). They are allocated by the first start, and published with a single pointer, so a thread always
+// sees a table together with its own size. They are never replaced or unmapped: a thread, that saw the profiler
+// running just before a restart, may still write into them.
+struct Buffers
+{
+	Event * ring;
+	size_t ringSize;
+	uintptr_t * sampled;
+	size_t sampledSize;
+};
+
+// Profiler state
+Lock profilerLock;
+bool profiling;
+size_t sampleInterval;
+Buffers profilerBuffers;
+const Buffers * buffers;
+
+// Next event of the ring buffer, and the first event of the current run (events are never cleared, an event belongs to
+// the current run, if its sequence number is above the start)
+uint64_t ringHead;
+uint64_t ringStart;
+
+// Maximum number of probes in the sample table
+constexpr size_t MAX_PROBES = 64;
+
+// Hash of an address for the sample table
+inline size_t hashAddress(const void * ptr) noexcept
+{
+	uint64_t x = reinterpret_cast<uintptr_t>(ptr);
+	return static_cast<size_t>((x >> 4) * 0x9e3779b97f4a7c15 >> 32);
+}
+
+// Next sampling interval - uniform in [0, 2 * interval), so the average is the interval
+inline int64_t nextCountdown(ThreadCache & tc) noexcept
+{
+	if (tc.random == 0)
+		tc.random = reinterpret_cast<uintptr_t>(& tc) | 1;
+	tc.random ^= tc.random << 13;
+	tc.random ^= tc.random >> 7;
+	tc.random ^= tc.random << 17;
+	return static_cast<int64_t>(tc.random % (2 * sampleInterval)) + 1;
+}
+
+// Write an event into the ring buffer
+void record(const Buffers & b, uint64_t kind, const void * address, size_t size, void * const * frames, size_t depth) noexcept
+{
+	uint64_t idx = __atomic_fetch_add(& ringHead, 1, __ATOMIC_RELAXED);
+	Event & event = b.ring[idx & (b.ringSize - 1)];
+
+	__atomic_store_n(& event.seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(& event.kind, kind, __ATOMIC_RELAXED);
+	__atomic_store_n(& event.address, reinterpret_cast<uintptr_t>(address), __ATOMIC_RELAXED);
+	__atomic_store_n(& event.size, size, __ATOMIC_RELAXED);
+	__atomic_store_n(& event.depth, depth, __ATOMIC_RELAXED);
+	for (size_t i = 0; i < depth; ++ i)
+		__atomic_store_n(& event.frames[i], reinterpret_cast<uintptr_t>(frames[i]), __ATOMIC_RELAXED);
+	__atomic_store_n(& event.seq, idx + 1, __ATOMIC_RELEASE);
+}
+
+// Read an event from the ring buffer (fails, if it was overwritten, or is being written)
+bool load(const Buffers & b, uint64_t idx, Event & out) noexcept
+{
+	Event & event = b.ring[idx & (b.ringSize - 1)];
+
+	if (__atomic_load_n(& event.seq, __ATOMIC_ACQUIRE) != idx + 1)
+		return false;
+	out.kind = __atomic_load_n(& event.kind, __ATOMIC_RELAXED);
+	out.address = __atomic_load_n(& event.address, __ATOMIC_RELAXED);
+	out.size = __atomic_load_n(& event.size, __ATOMIC_RELAXED);
+	out.depth = __atomic_load_n(& event.depth, __ATOMIC_RELAXED);
+	out.depth = out.depth < MAX_FRAMES ? out.depth : MAX_FRAMES;
+	for (size_t i = 0; i < out.depth; ++ i)
+		out.frames[i] = __atomic_load_n(& event.frames[i], __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(& event.seq, __ATOMIC_RELAXED) == idx + 1;
+}
+
+// Sample an allocation (called when the countdown runs out)
+void * sampleAllocation(void * ptr, size_t size) noexcept
+{
+	ThreadCache & tc = cache;
+	if (!__atomic_load_n(& profiling, __ATOMIC_ACQUIRE))
+	{
+		tc.countdown = IDLE_COUNTDOWN;
+		return ptr;
+	}
+
+	tc.countdown = nextCountdown(tc);
+	const Buffers * b = __atomic_load_n(& buffers, __ATOMIC_ACQUIRE);
+	if (tc.sampling || !b)
+		return ptr;
+	tc.sampling = true;
+
+	// Remember the address, so the deallocation can be recorded (not sampled, if the table is too crowded)
+	size_t mask = b->sampledSize - 1;
+	size_t h = hashAddress(ptr);
+	for (size_t i = 0; i < MAX_PROBES; ++ i)
+	{
+		uintptr_t & slot = b->sampled[(h + i) & mask];
+		uintptr_t old = __atomic_load_n(& slot, __ATOMIC_RELAXED);
+		if (old <= 1 && __atomic_compare_exchange_n(& slot, & old, reinterpret_cast<uintptr_t>(ptr), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		{
+			// Capture the stack (skipping this function, and the operator new)
+			void * frames[MAX_FRAMES + 2];
+#if defined(__GLIBC__)
+			size_t depth = ::backtrace(frames, MAX_FRAMES + 2);
+#else
+			frames[2] = __builtin_return_address(0);
+			size_t depth = 3;
+#endif
+			depth = depth > 2 ? depth - 2 : 0;
+			record(* b, EVENT_ALLOC, ptr, size, frames + 2, depth);
+			break;
+		}
+	}
+
+	tc.sampling = false;
+	return ptr;
+}
+
+// Check, if the deallocated address was sampled (only called while the profiler is running)
+void sampleFree(void * ptr) noexcept
+{
+	const Buffers * b = __atomic_load_n(& buffers, __ATOMIC_ACQUIRE);
+	if (!b)
+		return;
+
+	size_t mask = b->sampledSize - 1;
+	size_t h = hashAddress(ptr);
+	uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+	for (size_t i = 0; i < MAX_PROBES; ++ i)
+	{
+		uintptr_t & slot = b->sampled[(h + i) & mask];
+		uintptr_t old = __atomic_load_n(& slot, __ATOMIC_RELAXED);
+		if (old == 0)
+			return;
+		if (old == address)
+		{
+			if (__atomic_compare_exchange_n(& slot, & old, uintptr_t(1), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				record(* b, EVENT_FREE, ptr, 0, nullptr, 0);
+			return;
+		}
+	}
+}
+
+// Count down the allocated bytes, and sample the allocation, if the countdown runs out
+inline void * countdown(void * ptr, size_t size) noexcept
+{
+	ThreadCache & tc = cache;
+	if ((tc.countdown -= static_cast<int64_t>(size)) < 0 && ptr)
+		return sampleAllocation(ptr, size);
+	return ptr;
+}
+
+// Check deallocations while the profiler is running
+inline void checkFree(void * ptr) noexcept
+{
+	if (__builtin_expect(__atomic_load_n(& profiling, __ATOMIC_RELAXED), false))
+		sampleFree(ptr);
+}
+
+// ------------------------------------------------------------ //
+//		Allocation
+// ------------------------------------------------------------ //
+
+// Allocate a block from a size class
+inline void * allocateClass(size_t c) noexcept
+{
+	FreeList & list = cache.lists[c];
+	FreeBlock * block = list.head;
+	if (block)
+	{
+		list.head = block->next;
+		list.count --;
+		bump(cache.counters.allocs[c]);
+		return countdown(block, classSize(c));
+	}
+	return countdown(allocateSlow(c), classSize(c));
+}
+
+// Return a block to the thread cache
+inline void deallocateClass(void * ptr, size_t c) noexcept
+{
+	checkFree(ptr);
+	bump(cache.counters.frees[c]);
+	FreeList & list = cache.lists[c];
+	FreeBlock * block = static_cast<FreeBlock *>(ptr);
+	block->next = list.head;
+	list.head = block;
+	if (++ list.count > list.limit)
+		deallocateSlow(c);
+}
+
+// Size class of an aligned allocation - the first class, whose block size is a multiple of the alignment (spans are
+// chunk aligned, so every block of such a class is aligned), or 0 if there is no such class
+inline size_t classOfAligned(size_t size, size_t align) noexcept
+{
+	if (align > CHUNK_SIZE)
+		return 0;
+
+	for (size_t c = classOf(size > align ? size : align); c < CLASSES; ++ c)
+		if ((classSize(c) & (align - 1)) == 0)
+			return c;
+	return 0;
+}
+
+// Usable size of a large block (0 where malloc can't report it, so these blocks are left out of the byte counters, as
+// documented in Stats)
+inline size_t largeSize(void * ptr, size_t align) noexcept
+{
+#if defined(_WIN32)
+	return align > NEW_ALIGNMENT ? ::_aligned_msize(ptr, align, 0) : ::_msize(ptr);
+#elif defined(__GLIBC__)
+	return skip(align), ::malloc_usable_size(ptr);
+#else
+	return skip(ptr, align), 0;
+#endif
+}
+
+// Count a large allocation of a known usable size
+void * countLargeSize(void * ptr, size_t size) noexcept
+{
+	ThreadCache & tc = cache;
+	if (!tc.active && !tc.dead)
+		activate(tc);
+	bump(tc.counters.largeAllocs);
+	bump(tc.counters.largeAllocBytes, size);
+	tc.dead ? retire(tc) : publish(tc);
+	return countdown(ptr, size);
+}
+
+// Count a large allocation
+inline void * countLarge(void * ptr, size_t align) noexcept
+{
+	return ptr ? countLargeSize(ptr, largeSize(ptr, align)) : ptr;
+}
+
+// Count a large deallocation of a known usable size (before the block is freed)
+void uncountLargeSize(void * ptr, size_t size) noexcept
+{
+	checkFree(ptr);
+	ThreadCache & tc = cache;
+	if (!tc.active && !tc.dead)
+		activate(tc);
+	bump(tc.counters.largeFrees);
+	bump(tc.counters.largeFreeBytes, size);
+	tc.dead ? retire(tc) : publish(tc);
+}
+
+// Count a large deallocation (before the block is freed)
+inline void uncountLarge(void * ptr, size_t align) noexcept
+{
+	if (ptr)
+		uncountLargeSize(ptr, largeSize(ptr, align));
+}
+
+// Settings of large allocations
+size_t mapThreshold = defaultMapThreshold;
+HugePages hugePages = HugePages::none;
+
+// Header at the start of directly mapped blocks - size of the mapping, and its huge pages
+struct MappedHeader
+{
+	size_t size;
+	HugePages pages;
+};
+
+static_assert(sizeof(MappedHeader) <= NEW_ALIGNMENT, "The header of directly mapped blocks must fit before the block");
+
+// Map a large block directly from the OS (align is below the chunk size, so the header is in the first chunk)
+void * allocateMapped(size_t size, size_t align) noexcept
+{
+	size_t offset = align > NEW_ALIGNMENT ? align : NEW_ALIGNMENT;
+	if (size > SIZE_MAX - offset - CHUNK_SIZE)
+		return nullptr;
+
+	size_t mapped = (offset + size + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1);
+	HugePages pages = __atomic_load_n(& hugePages, __ATOMIC_RELAXED);
+	char * base = static_cast<char *>(mapDirect(mapped, pages));
+	if (!base)
+		return nullptr;
+
+	{
+		Locked lock(regionLock);
+		if (!registerChunks(base, 1, MAPPED_CLASS))
+			return unmap(base, mapped), nullptr;
+	}
+
+	MappedHeader & header = * reinterpret_cast<MappedHeader *>(base);
+	header.size = mapped;
+	header.pages = pages;
+	return countLargeSize(base + offset, mapped - offset);
+}
+
+// Unmap a directly mapped block
+void deallocateMapped(void * ptr) noexcept
+{
+	char * base = reinterpret_cast<char *>(reinterpret_cast<uintptr_t>(ptr) & ~(CHUNK_SIZE - 1));
+	size_t mapped = reinterpret_cast<MappedHeader *>(base)->size;
+	uncountLargeSize(ptr, mapped - (static_cast<char *>(ptr) - base));
+
+	// Forget the chunk before unmapping it, the address may be reused by anyone right after
+	{
+		Locked lock(regionLock);
+		registerChunks(base, 1, 0);
+	}
+	unmap(base, mapped);
+}
+
+// Resize a directly mapped block by remapping its pages (returns null, if it is not possible)
+void * reallocateMapped(void * ptr, size_t size) noexcept
+{
+#if defined(__linux__) && defined(MREMAP_MAYMOVE)
+	char * base = reinterpret_cast<char *>(reinterpret_cast<uintptr_t>(ptr) & ~(CHUNK_SIZE - 1));
+	size_t old = reinterpret_cast<MappedHeader *>(base)->size;
+	HugePages pages = reinterpret_cast<MappedHeader *>(base)->pages;
+	size_t offset = static_cast<char *>(ptr) - base;
+	if (pages == HugePages::hugetlb || size > SIZE_MAX - offset - CHUNK_SIZE)
+		return nullptr;
+
+	size_t mapped = (offset + size + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1);
+	if (mapped < old)
+	{
+		munmap(base + mapped, old - mapped);
+	}
+	else if (mapped > old && mremap(base, old, mapped, 0) == MAP_FAILED)
+	{
+		// The address space after the mapping is taken, so the pages are moved into a new chunk aligned reservation
+		bool huge = pages == HugePages::transparent && mapped >= HUGE_PAGE_SIZE;
+		char * target = static_cast<char *>(mapAligned(mapped, huge ? HUGE_PAGE_SIZE : CHUNK_SIZE));
+		if (!target)
+			return nullptr;
+
+		{
+			Locked lock(regionLock);
+			if (!registerChunks(target, 1, MAPPED_CLASS))
+				return unmap(target, mapped), nullptr;
+		}
+		if (mremap(base, old, mapped, MREMAP_MAYMOVE | MREMAP_FIXED, target) == MAP_FAILED)
+		{
+			Locked lock(regionLock);
+			registerChunks(target, 1, 0);
+			return unmap(target, mapped), nullptr;
+		}
+		{
+			Locked lock(regionLock);
+			registerChunks(base, 1, 0);
+		}
+		base = target;
+	}
+
+	#if defined(MADV_HUGEPAGE)
+	if (mapped > old && pages == HugePages::transparent && mapped >= HUGE_PAGE_SIZE)
+		madvise(base, mapped, MADV_HUGEPAGE);
+	#endif
+
+	// The header moved along with the pages
+	uncountLargeSize(ptr, old - offset);
+	reinterpret_cast<MappedHeader *>(base)->size = mapped;
+	return countLargeSize(base + offset, mapped - offset);
+#else
+	return skip(ptr, size), nullptr;
+#endif
+}
+
+// Allocate a large block - directly mapped from the OS above the threshold, passed on to malloc below it
+void * allocateLarge(size_t size, size_t align) noexcept
+{
+	if (size >= __atomic_load_n(& mapThreshold, __ATOMIC_RELAXED) && align < CHUNK_SIZE)
+		return allocateMapped(size, align);
+
+	if (align <= NEW_ALIGNMENT)
+		return countLarge(::malloc(size), NEW_ALIGNMENT);
+#if defined(_WIN32)
+	return countLarge(::_aligned_malloc(size, align), align);
+#else
+	void * ptr;
+	return countLarge(::posix_memalign(& ptr, align, size) == 0 ? ptr : nullptr, align);
+#endif
+}
+
+// Deallocate a large block (class is 0 for blocks from malloc)
+void deallocateLarge(void * ptr, size_t c) noexcept
+{
+	if (c == MAPPED_CLASS)
+		return deallocateMapped(ptr);
+	uncountLarge(ptr, NEW_ALIGNMENT);
+	::free(ptr);
+}
+
+// Allocate memory - small sizes are served from the thread cache, large ones are handled by allocateLarge
+inline void * allocate(size_t size) noexcept
+{
+	if (size <= SMALL_LIMIT)
+		return allocateClass(classOf(size));
+	return allocateLarge(size, NEW_ALIGNMENT);
+}
+
+// Allocate aligned memory - small sizes are served from a size class with naturally aligned blocks
+inline void * allocateAligned(size_t size, size_t align) noexcept
+{
+	if (align <= NEW_ALIGNMENT)
+		return allocate(size);
+
+	size_t c = size <= SMALL_LIMIT ? classOfAligned(size, align) : 0;
+	if (c != 0)
+		return allocateClass(c);
+	return allocateLarge(size, align);
+}
+
+// Allocate zeroed memory - fresh mappings and calloc are already zero, so only small blocks are cleared
+void * tryAllocateZeroed(size_t size, size_t align) noexcept
+{
+	if (size <= SMALL_LIMIT || align >= CHUNK_SIZE || (align > NEW_ALIGNMENT && size < __atomic_load_n(& mapThreshold, __ATOMIC_RELAXED)))
+	{
+		void * ptr = allocateAligned(size, align);
+		return ptr ? memset(ptr, 0, size) : nullptr;
+	}
+
+	if (size >= __atomic_load_n(& mapThreshold, __ATOMIC_RELAXED))
+		return allocateMapped(size, align);
+	return countLarge(::calloc(1, size), NEW_ALIGNMENT);
+}
+
+// Deallocate memory - blocks are returned to the thread cache, unless they are large
+inline void deallocate(void * ptr) noexcept
+{
+	size_t c = classOfChunk(ptr);
+	if (c == 0 || c == MAPPED_CLASS)
+		return deallocateLarge(ptr, c);
+	deallocateClass(ptr, c);
+}
+
+// Deallocate memory of a known size - small blocks skip the chunk map lookup
+inline void deallocateSized(void * ptr, size_t size) noexcept
+{
+	if (ptr && size <= SMALL_LIMIT)
+		return deallocateClass(ptr, classOf(size));
+	deallocate(ptr);
+}
+
+// Deallocate aligned memory
+inline void deallocateAligned(void * ptr, size_t align) noexcept
+{
+#if defined(_WIN32)
+	size_t c = align > NEW_ALIGNMENT ? classOfChunk(ptr) : 1;
+	if (c == 0)
+		return uncountLarge(ptr, align), ::_aligned_free(ptr);
+#else
+	skip(align);
+#endif
+	deallocate(ptr);
+}
+
+// Deallocate aligned memory of a known size - small blocks skip the chunk map lookup
+inline void deallocateAlignedSized(void * ptr, size_t size, size_t align) noexcept
+{
+	if (align <= NEW_ALIGNMENT)
+		return deallocateSized(ptr, size);
+
+	size_t c = ptr && size <= SMALL_LIMIT ? classOfAligned(size, align) : 0;
+	if (c != 0)
+		return deallocateClass(ptr, c);
+	deallocateAligned(ptr, align);
+}
+
+// Size class of a block of a given size and alignment (0 for large blocks)
+inline size_t classOfBlock(size_t size, size_t align) noexcept
+{
+	if (size > SMALL_LIMIT)
+		return 0;
+	return align <= NEW_ALIGNMENT ? classOf(size) : classOfAligned(size, align);
+}
+
+// ------------------------------------------------------------ //
+//		Memory pressure
+// ------------------------------------------------------------ //
+
+// Registered reclaim callback
+struct Reclaimer
+{
+	ReclaimCallback callback;
+	void * context;
+};
+
+// Reclaim callbacks, and the number of threads calling them
+Lock reclaimLock;
+Reclaimer reclaimers[maxReclaimCallbacks];
+size_t reclaimerCount;
+size_t reclaimingThreads;
+
+// Call the reclaim callbacks, until `done` returns true (it's called after every callback, that released memory)
+template<typename F> size_t runReclaim(size_t size, F done) noexcept
+{
+	ThreadCache & tc = cache;
+	if (tc.reclaiming || __atomic_load_n(& reclaimerCount, __ATOMIC_RELAXED) == 0)
+		return 0;
+
+	// Callbacks are called on a copy of the list, without holding the lock, so they can allocate and remove callbacks
+	Reclaimer list[maxReclaimCallbacks];
+	size_t count;
+	{
+		Locked lock(reclaimLock);
+		count = reclaimerCount;
+		memcpy(list, reclaimers, count * sizeof(Reclaimer));
+		__atomic_fetch_add(& reclaimingThreads, 1, __ATOMIC_RELAXED);
+	}
+
+	tc.reclaiming = true;
+	size_t total = 0;
+	for (size_t i = 0; i < count; ++ i)
+	{
+		size_t released = list[i].callback(size, list[i].context);
+		total += released;
+		if (released > 0 && done())
+			break;
+	}
+	tc.reclaiming = false;
+
+	__atomic_fetch_sub(& reclaimingThreads, 1, __ATOMIC_RELEASE);
+	return total;
+}
+
+// Retry a failed allocation, while the reclaim callbacks release memory
+void * allocateAfterReclaim(size_t size, size_t align) noexcept
+{
+	void * result = nullptr;
+	runReclaim(size, [&] () noexcept {return (result = allocateAligned(size, align)) != nullptr;});
+	return result;
+}
+
+// Resize a block (without reclaiming memory, if it fails)
+void * tryReallocate(void * ptr, size_t oldSize, size_t newSize, size_t align) noexcept
+{
+	if (!ptr)
+		return allocateAligned(newSize, align);
+
+	// Small blocks stay in place, while they stay in the same size class
+	size_t c = classOfChunk(ptr);
+	bool large = newSize >= __atomic_load_n(& mapThreshold, __ATOMIC_RELAXED);
+	if (c != 0 && c != MAPPED_CLASS && classOfBlock(newSize, align) == c)
+		return ptr;
+
+	// Directly mapped blocks are remapped, while they stay above the threshold
+	if (c == MAPPED_CLASS && large && align < CHUNK_SIZE)
+	{
+		void * result = reallocateMapped(ptr, newSize);
+		if (result)
+			return result;
+	}
+
+	// Blocks from malloc are passed to realloc, while they stay between the small limit and the threshold
+	if (c == 0 && !large && align <= NEW_ALIGNMENT && newSize > SMALL_LIMIT)
+	{
+		// The old block is uncounted first (it may be gone after realloc), and counted again, if realloc fails
+		size_t old = largeSize(ptr, NEW_ALIGNMENT);
+		uncountLargeSize(ptr, old);
+		void * result = ::realloc(ptr, newSize);
+		if (!result)
+			return countLargeSize(ptr, old), nullptr;
+		return countLargeSize(result, largeSize(result, NEW_ALIGNMENT));
+	}
+
+	// Anything else is copied into a new block
+	void * result = allocateAligned(newSize, align);
+	if (!result)
+		return nullptr;
+	memcpy(result, ptr, oldSize < newSize ? oldSize : newSize);
+	deallocateAlignedSized(ptr, oldSize, align);
+	return result;
+}
+
+// Close anonymous namespace
+}
+
+// ------------------------------------------------------------ //
+//		Public interface
+// ------------------------------------------------------------ //
+
+static_assert(Stats::classes == CLASSES - 1, "Stats::classes must match the number of size classes");
+
+Stats stats() noexcept
+{
+	Counters total = Counters();
+	{
+		Locked lock(registryLock);
+		addTo(total, retired);
+		for (ThreadCache * tc = registry; tc; tc = tc->next)
+			addTo(total, tc->counters);
+	}
+
+	// Counters of other threads are read without synchronization, so the differences may be slightly negative
+	Stats result = Stats();
+	int64_t small = 0;
+	for (size_t c = 1; c < CLASSES; ++ c)
+	{
+		Stats::SizeClass & sc = result.sizeClasses[c - 1];
+		sc.size = classSize(c);
+		sc.allocCount = total.allocs[c];
+		sc.freeCount = total.frees[c];
+
+		result.allocCount += total.allocs[c];
+		result.freeCount += total.frees[c];
+		small += static_cast<int64_t>((total.allocs[c] - total.frees[c]) * classSize(c));
+	}
+	int64_t large = static_cast<int64_t>(total.largeAllocBytes - total.largeFreeBytes);
+
+	result.largeAllocCount = total.largeAllocs;
+	result.largeFreeCount = total.largeFrees;
+	result.allocCount += total.largeAllocs;
+	result.freeCount += total.largeFrees;
+
+	result.smallBytes = small > 0 ? static_cast<size_t>(small) : 0;
+	result.largeBytes = large > 0 ? static_cast<size_t>(large) : 0;
+	result.liveBytes = result.smallBytes + result.largeBytes;
+	int64_t peak = __atomic_load_n(& globalPeak, __ATOMIC_RELAXED);
+	result.peakBytes = peak > static_cast<int64_t>(result.liveBytes) ? static_cast<size_t>(peak) : result.liveBytes;
+
+	Locked lock(regionLock);
+	result.mappedBytes = regionBytes;
+	return result;
+}
+
+void * reallocate(void * ptr, size_t oldSize, size_t newSize, size_t align) noexcept
+{
+	void * result = tryReallocate(ptr, oldSize, newSize, align);
+	if (!result)
+		runReclaim(newSize, [&] () noexcept {return (result = tryReallocate(ptr, oldSize, newSize, align)) != nullptr;});
+	return result;
+}
+
+void * allocateZeroed(size_t size, size_t align) noexcept
+{
+	void * result = tryAllocateZeroed(size, align);
+	if (!result)
+		runReclaim(size, [&] () noexcept {return (result = tryAllocateZeroed(size, align)) != nullptr;});
+	return result;
+}
+
+bool addReclaimCallback(ReclaimCallback callback, void * context) noexcept
+{
+	Locked lock(reclaimLock);
+	if (!callback || reclaimerCount == maxReclaimCallbacks)
+		return false;
+	reclaimers[reclaimerCount].callback = callback;
+	reclaimers[reclaimerCount].context = context;
+	__atomic_store_n(& reclaimerCount, reclaimerCount + 1, __ATOMIC_RELAXED);
+	return true;
+}
+
+void removeReclaimCallback(ReclaimCallback callback, void * context) noexcept
+{
+	{
+		Locked lock(reclaimLock);
+		for (size_t i = 0; i < reclaimerCount; ++ i)
+			if (reclaimers[i].callback == callback && reclaimers[i].context == context)
+			{
+				memmove(reclaimers + i, reclaimers + i + 1, (reclaimerCount - i - 1) * sizeof(Reclaimer));
+				__atomic_store_n(& reclaimerCount, reclaimerCount - 1, __ATOMIC_RELAXED);
+				break;
+			}
+	}
+
+	// Wait for the threads, that may have copied the callback before it was removed (unless called from a callback)
+	if (cache.reclaiming)
+		return;
+	while (__atomic_load_n(& reclaimingThreads, __ATOMIC_ACQUIRE) != 0)
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	}
+}
+
+size_t reclaim(size_t size) noexcept
+{
+	return runReclaim(size, [] () noexcept {return false;});
+}
+
+void setMapThreshold(size_t threshold) noexcept
+{
+	__atomic_store_n(& mapThreshold, threshold ? threshold : SIZE_MAX, __ATOMIC_RELAXED);
+}
+
+void setHugePages(HugePages mode) noexcept
+{
+	__atomic_store_n(& hugePages, mode, __ATOMIC_RELAXED);
+}
+
+bool startProfiler(size_t interval, size_t capacity) noexcept
+{
+	Locked lock(profilerLock);
+	if (profiling || interval == 0)
+		return false;
+
+	// Round the capacity to a power of two
+	size_t events = 1;
+	while (events < capacity)
+		events <<= 1;
+
+	// The buffers are allocated by the first start, and can't be resized afterwards (see Buffers)
+	if (!buffers)
+	{
+		Event * ring = static_cast<Event *>(mapChunks(sizeof(Event) * events));
+		uintptr_t * sampled = static_cast<uintptr_t *>(mapChunks(sizeof(uintptr_t) * 4 * events));
+		if (!ring || !sampled)
+		{
+			if (ring)
+				unmap(ring, sizeof(Event) * events);
+			if (sampled)
+				unmap(sampled, sizeof(uintptr_t) * 4 * events);
+			return false;
+		}
+		profilerBuffers = Buffers{ring, events, sampled, 4 * events};
+		__atomic_store_n(& buffers, & profilerBuffers, __ATOMIC_RELEASE);
+	}
+	else if (events != buffers->ringSize)
+		return false;
+	else
+	{
+		// Late writers of the previous run may still use the table, so it's cleared slot by slot (the ring buffer
+		// isn't cleared, its old events are before the start)
+		for (size_t i = 0; i < buffers->sampledSize; ++ i)
+			__atomic_store_n(& buffers->sampled[i], uintptr_t(0), __ATOMIC_RELAXED);
+	}
+
+	ringStart = __atomic_load_n(& ringHead, __ATOMIC_RELAXED);
+	sampleInterval = interval;
+	__atomic_store_n(& profiling, true, __ATOMIC_RELEASE);
+
+	// Other threads start sampling, when their idle countdown runs out
+	cache.countdown = nextCountdown(cache);
+	return true;
+}
+
+void stopProfiler() noexcept
+{
+	Locked lock(profilerLock);
+	__atomic_store_n(& profiling, false, __ATOMIC_RELEASE);
+}
+
+bool dumpProfile(const char * filename) noexcept
+{
+	Locked lock(profilerLock);
+	if (!buffers)
+		return false;
+
+	FILE * file = fopen(filename, "wb");
+	if (!file)
+		return false;
+
+	// Events of the current run still in the ring buffer
+	uint64_t head = __atomic_load_n(& ringHead, __ATOMIC_ACQUIRE);
+	uint64_t first = head - ringStart > buffers->ringSize ? head - buffers->ringSize : ringStart;
+
+	// Header (the number of events is patched, after the events are written)
+	uint64_t header[4] = {ProfileMagic, sampleInterval, 0, first - ringStart};
+	bool good = fwrite(header, sizeof(header), 1, file) == 1;
+
+	Event event;
+	for (uint64_t idx = first; good && idx < head; ++ idx)
+	{
+		if (!load(* buffers, idx, event))
+			continue;
+		uint64_t fields[4] = {event.kind, event.address, event.size, event.depth};
+		good = fwrite(fields, sizeof(fields), 1, file) == 1 && fwrite(event.frames, sizeof(uint64_t), event.depth, file) == event.depth;
+		header[2] ++;
+	}
+
+	// Memory map of the process, for symbolization
+	uint64_t end[4] = {0, 0, 0, 0};
+	good = good && fwrite(end, sizeof(end), 1, file) == 1;
+#if defined(__linux__)
+	FILE * maps = fopen("/proc/self/maps", "rb");
+	if (maps)
+	{
+		char buffer[4096];
+		for (size_t n; good && (n = fread(buffer, 1, sizeof(buffer), maps)) > 0; )
+			good = fwrite(buffer, 1, n, file) == n;
+		fclose(maps);
+	}
+#endif
+
+	good = good && fseek(file, 0, SEEK_SET) == 0 && fwrite(header, sizeof(header), 1, file) == 1;
+	return fclose(file) == 0 && good;
+}
+
+// Close namespace "nx::mem"
+}}
+
+// ------------------------------------------------------------ //
+//		Operators
+// ------------------------------------------------------------ //
 
 void * operator new (size_t size) noexcept
 {
-	return ::malloc(size);
+	void * ptr = nx::mem::allocate(size);
+	return ptr ? ptr : nx::mem::allocateAfterReclaim(size, nx::type::newAlignment);
 }
 
 void * operator new [] (size_t size) noexcept
 {
-	return ::malloc(size);
+	void * ptr = nx::mem::allocate(size);
+	return ptr ? ptr : nx::mem::allocateAfterReclaim(size, nx::type::newAlignment);
+}
+
+void * operator new (size_t size, std::align_val_t align) noexcept
+{
+	void * ptr = nx::mem::allocateAligned(size, static_cast<size_t>(align));
+	return ptr ? ptr : nx::mem::allocateAfterReclaim(size, static_cast<size_t>(align));
+}
+
+void * operator new [] (size_t size, std::align_val_t align) noexcept
+{
+	void * ptr = nx::mem::allocateAligned(size, static_cast<size_t>(align));
+	return ptr ? ptr : nx::mem::allocateAfterReclaim(size, static_cast<size_t>(align));
 }
 
 void operator delete (void * obj) noexcept
 {
-	::free(obj);
+	nx::mem::deallocate(obj);
 }
 
 void operator delete [] (void * obj) noexcept
 {
-	::free(obj);
+	nx::mem::deallocate(obj);
+}
+
+void operator delete (void * obj, size_t size) noexcept
+{
+	nx::mem::deallocateSized(obj, size);
+}
+
+void operator delete [] (void * obj, size_t size) noexcept
+{
+	nx::mem::deallocateSized(obj, size);
+}
+
+void operator delete (void * obj, std::align_val_t align) noexcept
+{
+	nx::mem::deallocateAligned(obj, static_cast<size_t>(align));
+}
+
+void operator delete [] (void * obj, std::align_val_t align) noexcept
+{
+	nx::mem::deallocateAligned(obj, static_cast<size_t>(align));
+}
+
+void operator delete (void * obj, size_t size, std::align_val_t align) noexcept
+{
+	nx::mem::deallocateAlignedSized(obj, size, static_cast<size_t>(align));
+}
+
+void operator delete [] (void * obj, size_t size, std::align_val_t align) noexcept
+{
+	nx::mem::deallocateAlignedSized(obj, size, static_cast<size_t>(align));
 }
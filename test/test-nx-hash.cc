@@ -0,0 +1,203 @@
+// Include test framework
+#include "nx-test.hh"
+
+// Include "nx" library
+#include <nx-hash.hh>
+#include <nx-util.hh>
+
+// Buffer of pseudo random bytes
+struct Bytes
+{
+	nx::byte data[1024];
+
+	Bytes(uint64_t seed = 42) noexcept
+	{
+		nx::rng::Random random(seed);
+		for (size_t i = 0; i < sizeof(data); ++ i)
+			data[i] = nx::byte(random.next() >> 56);
+	}
+};
+
+void TestBytes(nx::Testing & test)
+{
+	test.runCase("Vectors", [] (bool)	// Same hashes as the reference wyhash (final 4), with explicit seeds
+		{
+			const char * texts[] = {"", "a", "abc", "message digest", "abcdefghijklmnopqrstuvwxyz",
+				"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+				"12345678901234567890123456789012345678901234567890123456789012345678901234567890"};
+			uint64_t hashes[] = {0x93228a4de0eec5a2, 0xc5bac3db178713c4, 0xa97f2f7b1d9b3314, 0x786d1f1df3801df4,
+				0xdca5a8138ad37c87, 0xb9e734f117cfaf70, 0x6cc5eab49a92d617};
+
+			for (size_t i = 0; i < 7; ++ i)
+				ExpectEqual(hashes[i], nx::hashBytes(texts[i], __builtin_strlen(texts[i]), i));
+		}
+	);
+
+	test.runCase("Seed", [] (bool)	// The seed of the process is fixed, and used by default
+		{
+			Bytes bytes;
+			ExpectEqual(nx::hashSeed(), nx::hashSeed());
+			ExpectEqual(nx::hashBytes(bytes.data, 100, nx::hashSeed()), nx::hashBytes(bytes.data, 100));
+			ExpectEqual(false, nx::hashBytes(bytes.data, 100, 1) == nx::hashBytes(bytes.data, 100, 2));
+		}
+	);
+
+	test.runCase("Lengths", [] (bool)	// Every prefix of a buffer (even of zeros) has a different hash
+		{
+			Bytes bytes;
+			nx::byte zeros[301] = {};
+			nx::Set<uint64_t> hashes;
+			for (size_t n = 0; n < 300; ++ n)
+			{
+				hashes.insert(nx::hashBytes(bytes.data, n));
+				hashes.insert(nx::hashBytes(zeros, n + 1));
+			}
+			ExpectEqual(size_t(600), hashes.size());
+		}
+	);
+
+	test.runCase("Unaligned", [] (bool)	// The hash only depends on the bytes, not on their address
+		{
+			Bytes bytes;
+			nx::byte copy[200];
+			for (size_t offset = 1; offset < 8; ++ offset)
+				for (size_t n = 0; n < 150; n += 7)
+				{
+					__builtin_memcpy(copy + offset, bytes.data, n);
+					ExpectEqual(nx::hashBytes(bytes.data, n), nx::hashBytes(copy + offset, n));
+				}
+		}
+	);
+
+	test.runCase("Avalanche", [] (bool)	// Flipping any bit of the input flips about half of the hash bits
+		{
+			Bytes bytes;
+			size_t sizes[] = {1, 3, 8, 16, 17, 40, 48, 49, 100, 500};
+			for (size_t n : sizes)
+			{
+				uint64_t base = nx::hashBytes(bytes.data, n);
+				size_t flips = 0;
+				for (size_t bit = 0; bit < 8 * n; ++ bit)
+				{
+					bytes.data[bit >> 3] ^= nx::byte(1 << (bit & 7));
+					flips += __builtin_popcountll(base ^ nx::hashBytes(bytes.data, n));
+					bytes.data[bit >> 3] ^= nx::byte(1 << (bit & 7));
+				}
+				ExpectEqual(true, flips > 28 * 8 * n && flips < 36 * 8 * n);
+			}
+		}
+	);
+}
+
+void TestHasher(nx::Testing & test)
+{
+	test.runCase("Pieces", [] (bool)	// The hash is the same, however the bytes are split
+		{
+			Bytes bytes;
+			for (size_t n = 0; n < 250; ++ n)
+			{
+				uint64_t expected = nx::hashBytes(bytes.data, n, 7);
+				bool equal = true;
+				for (size_t i = 0; i <= n; ++ i)
+				{
+					nx::Hasher hasher(7);
+					hasher.update(bytes.data, i / 3);
+					hasher.update(bytes.data + i / 3, i - i / 3);
+					hasher.update(bytes.data + i, n - i);
+					equal = equal && hasher.finish() == expected && hasher.size() == n;
+				}
+				ExpectEqual(true, equal);
+			}
+
+			// Byte by byte, and finished more than once
+			nx::Hasher hasher;
+			for (size_t i = 0; i < 1000; ++ i)
+			{
+				hasher.update(bytes.data + i, 1);
+				if (i % 97 == 0)
+					ExpectEqual(nx::hashBytes(bytes.data, i + 1), hasher.finish());
+			}
+			ExpectEqual(nx::hashBytes(bytes.data, 1000), hasher.finish());
+		}
+	);
+
+	test.runCase("Values", [] (bool)	// Values are added by their hash
+		{
+			uint64_t hashes[3] = {nx::hash(10), nx::hash(nx::makeTuple(1, 2)), nx::hash(uint64_t(3))};
+			nx::Hasher hasher(5);
+			hasher.add(10);
+			hasher.add(nx::makeTuple(1, 2));
+			hasher.add(uint64_t(3));
+			ExpectEqual(nx::hashBytes(hashes, sizeof(hashes), 5), hasher.finish());
+		}
+	);
+}
+
+void TestTypes(nx::Testing & test)
+{
+	test.runCase("Tuples", [] (bool)	// Equal tuples have equal hashes, and the order of the items matters
+		{
+			ExpectEqual(nx::hash(nx::Pair<int, long>(1, 2)), nx::hash(nx::Pair<int, long>(1, 2)));
+			ExpectEqual(false, nx::hash(nx::Pair<int, int>(1, 2)) == nx::hash(nx::Pair<int, int>(2, 1)));
+			ExpectEqual(false, nx::hash(nx::Trio<int, int, int>(1, 2, 3)) == nx::hash(nx::Trio<int, int, int>(1, 3, 2)));
+			ExpectEqual(false, nx::hash(nx::Quad<int, int, int, int>(1, 2, 3, 4)) == nx::hash(nx::Quad<int, int, int, int>(1, 2, 4, 3)));
+
+			// Nested tuples
+			nx::Pair<nx::Pair<int, int>, int *> nested(nx::Pair<int, int>(1, 2), nullptr);
+			ExpectEqual(nx::combineHash(nx::hash(nx::Pair<int, int>(1, 2)), nx::hash<int *>(nullptr)), nx::hash(nested));
+		}
+	);
+
+	test.runCase("Multi & Array", [] (bool)	// Integers are hashed as bytes, other items by their hashes
+		{
+			nx::Multi<int, 4> multi = {{1, 2, 3, 4}};
+			auto array = nx::makeArrayFrom<int>(1, 2, 3, 4);
+			ExpectEqual(nx::hashBytes(multi.data, sizeof(multi.data)), nx::hash(multi));
+			ExpectEqual(nx::hash(multi), nx::hash(*array));
+
+			Bytes bytes;
+			auto buffer = nx::makeArray<nx::byte>(100);
+			__builtin_memcpy(buffer->data, bytes.data, 100);
+			ExpectEqual(nx::hashBytes(bytes.data, 100), nx::hash(*buffer));
+
+			nx::Multi<nx::Pair<int, int>, 2> pairs = {{nx::Pair<int, int>(1, 2), nx::Pair<int, int>(3, 4)}};
+			nx::Multi<nx::Pair<int, int>, 2> swapped = {{nx::Pair<int, int>(3, 4), nx::Pair<int, int>(1, 2)}};
+			ExpectEqual(false, nx::hash(pairs) == nx::hash(swapped));
+			ExpectEqual(nx::hash(pairs), nx::hash(nx::lvalue(nx::Multi<nx::Pair<int, int>, 2>(pairs))));
+		}
+	);
+
+	test.runCase("Keys", [] (bool)	// Tuples and arrays work as keys of the hash containers
+		{
+			nx::Dictionary<nx::Pair<int, int>, int> grid;
+			for (int x = 0; x < 30; ++ x)
+				for (int y = 0; y < 30; ++ y)
+					grid.insert(nx::Pair<int, int>(x, y), x * y);
+			ExpectEqual(size_t(900), grid.size());
+			ExpectEqual(true, grid.contains(nx::Pair<int, int>(7, 9)));
+			ExpectEqual(false, grid.contains(nx::Pair<int, int>(7, 30)));
+
+			nx::Set<nx::Multi<nx::byte, 8>> codes;
+			for (size_t i = 0; i < 1000; ++ i)
+			{
+				nx::Multi<nx::byte, 8> code;
+				for (size_t k = 0; k < 8; ++ k)
+					code[k] = nx::byte(i >> k);
+				codes.insert(code);
+			}
+			ExpectEqual(size_t(1000), codes.size());
+		}
+	);
+}
+
+void TestSession(nx::Testing & test)
+{
+	test.runGroup("Bytes", TestBytes);
+	test.runGroup("Hasher", TestHasher);
+	test.runGroup("Types", TestTypes);
+}
+
+int main()
+{
+	return nx::Testing::get().runSession("NX Hash", TestSession);
+}
@@ -0,0 +1,305 @@
+// Include test framework
+#include "nx-test.hh"
+
+// Include "nx" library
+#include <nx-mem.hh>
+#include <nx-util.hh>
+
+// Include threads
+#include <pthread.h>
+
+// Object that counts its destruction
+struct Counted
+{
+	static int created;
+	static int destroyed;
+	static int last;
+
+	int id;
+
+	Counted() noexcept
+		: id(created ++) {}
+	Counted(int id) noexcept
+		: id(id) {}
+	~Counted() noexcept
+		{++ destroyed; last = id;}
+};
+
+int Counted::created = 0;
+int Counted::destroyed = 0;
+int Counted::last = -1;
+
+void TestArena(nx::Testing & test)
+{
+	test.runCase("Alloc", [] (bool)	// Blocks are aligned, and don't overlap
+		{
+			nx::Arena arena;
+			static nx::byte * blocks[2000];
+
+			for (size_t n = 0; n < 2000; ++ n)
+			{
+				size_t align = size_t(1) << (n % 8);
+				blocks[n] = static_cast<nx::byte *>(arena.alloc(n % 100, align));
+				ExpectEqual(true, blocks[n] != nullptr);
+				ExpectEqual(uintptr_t(0), reinterpret_cast<uintptr_t>(blocks[n]) & (align - 1));
+				for (size_t i = 0; i < n % 100; ++ i)
+					blocks[n][i] = nx::byte(n);
+			}
+
+			bool intact = true;
+			for (size_t n = 0; n < 2000; ++ n)
+				for (size_t i = 0; i < n % 100; ++ i)
+					intact = intact && blocks[n][i] == nx::byte(n);
+			ExpectEqual(true, intact);
+			ExpectEqual(true, arena.used() >= 20 * 99 * 50);
+		}
+	);
+
+	test.runCase("Create", [] (bool)	// Objects are destroyed by reset, the last created first
+		{
+			nx::Arena arena;
+			Counted::created = Counted::destroyed = 0;
+
+			Counted * first = arena.create<Counted>(100);
+			ExpectEqual(100, first->id);
+			Counted * array = arena.createArray<Counted>(10);
+			ExpectEqual(true, array != nullptr);
+			ExpectEqual(9, array[9].id);
+			int * number = arena.create<int>(42);
+			ExpectEqual(42, * number);
+
+			ExpectEqual(0, Counted::destroyed);
+			arena.reset();
+			ExpectEqual(11, Counted::destroyed);
+			ExpectEqual(100, Counted::last);
+			ExpectEqual(size_t(0), arena.used());
+		}
+	);
+
+	test.runCase("Reuse", [] (bool)	// Chunks are reused after a reset, and large blocks are released
+		{
+			nx::Arena arena(4096);
+
+			for (int i = 0; i < 100; ++ i)
+				arena.alloc(100);
+			void * large = arena.alloc(1 << 20);
+			ExpectEqual(true, large != nullptr);
+			size_t reserved = arena.reserved();
+			ExpectEqual(true, reserved > (1 << 20));
+
+			arena.reset();
+			ExpectEqual(true, arena.reserved() < reserved - (1 << 20) + 4096);
+			reserved = arena.reserved();
+
+			for (int round = 0; round < 10; ++ round)
+			{
+				for (int i = 0; i < 100; ++ i)
+					arena.alloc(100);
+				arena.reset();
+			}
+			ExpectEqual(reserved, arena.reserved());
+
+			arena.trim();
+			ExpectEqual(size_t(0), arena.reserved());
+		}
+	);
+}
+
+// Pooled object of the thread test, that checks its contents, and counts the live objects
+struct Shared
+{
+	static int live;
+
+	uint64_t value;
+	uint64_t check;
+
+	Shared(uint64_t value) noexcept
+		: value(value), check(~value) {__atomic_add_fetch(& live, 1, __ATOMIC_RELAXED);}
+	~Shared() noexcept
+		{__atomic_sub_fetch(& live, 1, __ATOMIC_RELAXED);}
+};
+
+int Shared::live = 0;
+
+// Pool and slots of the thread test
+struct Exchange
+{
+	nx::Pool<Shared> * pool;
+	Shared * slots[1024];
+};
+
+// Pool thread - creates objects, swaps them into random slots, and destroys the objects it takes out (mostly created by
+// other threads)
+void * exchangeShared(void * context)
+{
+	Exchange * exchange = static_cast<Exchange *>(context);
+	bool ok = true;
+	uint64_t state = reinterpret_cast<uintptr_t>(& ok) | 1;
+	for (size_t round = 0; round < 100000; ++ round)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+
+		Shared * obj = exchange->pool->create(state);
+		ok = ok && obj != nullptr;
+		Shared * taken = __atomic_exchange_n(& exchange->slots[state % 1024], obj, __ATOMIC_ACQ_REL);
+		if (taken)
+		{
+			ok = ok && taken->check == ~taken->value && nx::Pool<Shared>::of(taken) == exchange->pool;
+			exchange->pool->destroy(taken);
+		}
+	}
+	return ok ? context : nullptr;
+}
+
+void TestPool(nx::Testing & test)
+{
+	test.runCase("Slots", [] (bool)	// Slots are distinct, aligned, and found their pool
+		{
+			struct alignas(32) Node { Node * next; int value; };
+			nx::Pool<Node> pool;
+			static Node * nodes[5000];
+
+			for (int i = 0; i < 5000; ++ i)
+			{
+				nodes[i] = pool.create();
+				ExpectEqual(true, nodes[i] != nullptr);
+				ExpectEqual(uintptr_t(0), reinterpret_cast<uintptr_t>(nodes[i]) & 31);
+				ExpectEqual(true, nx::Pool<Node>::of(nodes[i]) == & pool);
+				nodes[i]->value = i;
+			}
+
+			bool intact = true;
+			for (int i = 0; i < 5000; ++ i)
+				intact = intact && nodes[i]->value == i;
+			ExpectEqual(true, intact);
+
+			for (int i = 0; i < 5000; ++ i)
+				pool.destroy(nodes[i]);
+		}
+	);
+
+	test.runCase("Reuse", [] (bool)	// Freed slots are handed out again, the last freed first
+		{
+			nx::Pool<int> pool;
+
+			int * first = pool.alloc();
+			pool.free(first);
+			int * second = pool.alloc();
+			ExpectEqual(true, first == second);
+			pool.free(second);
+
+			// Slots go through the global free list, once the free list of the thread is full
+			static int * slots[1000];
+			for (int round = 0; round < 10; ++ round)
+			{
+				for (int i = 0; i < 1000; ++ i)
+					slots[i] = pool.alloc();
+				for (int i = 0; i < 1000; ++ i)
+					pool.free(slots[i]);
+			}
+			ExpectEqual(true, true);
+		}
+	);
+
+	test.runCase("UniquePtr", [] (bool)	// Pooled objects are destroyed, and returned to the pool by the deleter
+		{
+			nx::Pool<Counted> pool;
+			Counted::destroyed = 0;
+
+			Counted * obj;
+			{
+				nx::UniquePtr<Counted, nx::Pool<Counted>::Deleter> ptr = pool.make(7);
+				ExpectEqual(7, ptr->id);
+				obj = ptr.get();
+			}
+			ExpectEqual(1, Counted::destroyed);
+			ExpectEqual(7, Counted::last);
+
+			Counted * again = pool.alloc();
+			ExpectEqual(true, obj == again);
+			pool.free(again);
+		}
+	);
+
+	test.runCase("Threads", [] (bool)	// Objects can be created and destroyed by any thread, in pools that come and go
+		{
+			for (int run = 0; run < 2; ++ run)
+			{
+				nx::Pool<Shared> pool;
+				static Exchange exchange;
+				exchange.pool = & pool;
+				for (Shared * & slot : exchange.slots)
+					slot = nullptr;
+
+				pthread_t threads[8];
+				for (int t = 0; t < 8; ++ t)
+					pthread_create(& threads[t], nullptr, exchangeShared, & exchange);
+				bool ok = true;
+				for (int t = 0; t < 8; ++ t)
+				{
+					void * result = nullptr;
+					pthread_join(threads[t], & result);
+					ok = ok && result == & exchange;
+				}
+				ExpectEqual(true, ok);
+
+				// The objects left in the slots are destroyed by this thread
+				for (Shared * slot : exchange.slots)
+					if (slot)
+						pool.destroy(slot);
+				ExpectEqual(0, Shared::live);
+			}
+		}
+	);
+}
+
+void TestPolicy(nx::Testing & test)
+{
+	test.runCase("Heap", [] (bool)	// The default policy takes up no space
+		{
+			ExpectEqual(3 * sizeof(size_t), sizeof(nx::List<int>));
+			ExpectEqual(3 * sizeof(size_t) + sizeof(void *), sizeof(nx::List<int, nx::mem::Ref<nx::Arena>>));
+
+			nx::Array<int> * array = nx::Array<int>::create(100, nx::mem::Heap());
+			ExpectEqual(size_t(100), array->length);
+			nx::Array<int>::destroy(array, nx::mem::Heap());
+		}
+	);
+
+	test.runCase("Arena", [] (bool)	// Containers can take their memory from an arena
+		{
+			nx::Arena arena;
+
+			nx::List<int, nx::mem::Ref<nx::Arena>> list(arena);
+			for (int i = 0; i < 1000; ++ i)
+				list.append(i);
+			ExpectEqual(size_t(1000), list.size());
+			ExpectEqual(999, list[999]);
+			ExpectEqual(true, arena.used() >= 1000 * sizeof(int));
+
+			nx::List<int, nx::mem::Ref<nx::Arena>> copy(list);
+			ExpectEqual(size_t(1000), copy.size());
+			ExpectEqual(true, & copy.allocator() != & list.allocator() && copy.allocator().resource == & arena);
+
+			Counted::destroyed = 0;
+			nx::Array<Counted> * array = nx::Array<Counted>::create(10, nx::mem::Ref<nx::Arena>(arena));
+			ExpectEqual(size_t(10), array->length);
+			nx::Array<Counted>::destroy(array, nx::mem::Ref<nx::Arena>(arena));
+			ExpectEqual(10, Counted::destroyed);
+		}
+	);
+}
+
+void TestSession(nx::Testing & test)
+{
+	test.runGroup("Arena", TestArena);
+	test.runGroup("Pool", TestPool);
+	test.runGroup("Policy", TestPolicy);
+}
+
+int main()
+{
+	return nx::Testing::get().runSession("NX Mem", TestSession);
+}
@@ -0,0 +1,420 @@
+// Include test framework
+#include "nx-test.hh"
+
+// Include "nx" library
+#include <nx-new.hh>
+
+// Include threads
+#include <pthread.h>
+
+void TestAllocator(nx::Testing & test)
+{
+	test.runCase("Sanity", [] (bool)	// Every size gets a distinct, writeable, 16 byte aligned block
+		{
+			static void * blocks[4096];
+
+			for (size_t n = 0; n < 4096; ++ n)
+			{
+				blocks[n] = operator new (n * 17);
+				ExpectEqual(true, blocks[n] != nullptr);
+				ExpectEqual(uintptr_t(0), reinterpret_cast<uintptr_t>(blocks[n]) & 15);
+				for (size_t i = 0; i < n * 17; ++ i)
+					static_cast<nx::byte *>(blocks[n])[i] = static_cast<nx::byte>(n);
+			}
+
+			for (size_t n = 0; n < 4096; ++ n)
+			{
+				bool intact = true;
+				for (size_t i = 0; i < n * 17; ++ i)
+					intact = intact && static_cast<nx::byte *>(blocks[n])[i] == static_cast<nx::byte>(n);
+				ExpectEqual(true, intact);
+				operator delete (blocks[n]);
+			}
+		}
+	);
+
+	test.runCase("Reuse", [] (bool)	// Freed blocks are handed out again (LIFO thread cache)
+		{
+			void * first = operator new (48);
+			operator delete (first);
+			void * second = operator new (48);
+			ExpectEqual(true, first == second);
+			operator delete (second);
+		}
+	);
+
+	test.runCase("Churn", [] (bool)	// Enough traffic to go through the central free lists several times
+		{
+			static void * blocks[1024];
+
+			for (size_t round = 0; round < 64; ++ round)
+			{
+				for (size_t i = 0; i < 1024; ++ i)
+					blocks[i] = operator new (16 + (i * round) % 4000);
+				for (size_t i = 0; i < 1024; ++ i)
+					operator delete (blocks[(i * 7) % 1024]);
+			}
+			ExpectEqual(true, true);
+		}
+	);
+}
+
+// Blocks, that are passed between the threads of the stress test
+void * exchanged[4096];
+
+// Stress thread - swaps its own blocks into random slots, and frees the blocks it takes out (mostly allocated by other
+// threads). A block holds its size, and its last byte is a check byte.
+void * exchangeBlocks(void * context)
+{
+	bool * ok = static_cast<bool *>(context);
+	uint64_t state = reinterpret_cast<uintptr_t>(context) | 1;
+	for (size_t round = 0; round < 100000; ++ round)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+
+		// Mostly small sizes (every size class), and a few malloc blocks
+		size_t size = round % 64 ? 16 + (state >> 40) % 2048 : 40000 + (state >> 40) % 20000;
+		nx::byte * block = static_cast<nx::byte *>(operator new (size));
+		* reinterpret_cast<size_t *>(block) = size;
+		block[size - 1] = nx::byte(size);
+
+		nx::byte * taken = static_cast<nx::byte *>(__atomic_exchange_n(& exchanged[state % 4096], block, __ATOMIC_ACQ_REL));
+		if (taken)
+		{
+			size_t takenSize = * reinterpret_cast<size_t *>(taken);
+			* ok = * ok && taken[takenSize - 1] == nx::byte(takenSize);
+			operator delete (taken, takenSize);
+		}
+	}
+	return nullptr;
+}
+
+void TestThreads(nx::Testing & test)
+{
+	test.runCase("Exchange", [] (bool)	// Blocks freed by other threads go back through the batches, and the statistics add up
+		{
+			nx::mem::Stats before = nx::mem::stats();
+
+			bool ok[8];
+			pthread_t threads[8];
+			for (size_t t = 0; t < 8; ++ t)
+			{
+				ok[t] = true;
+				pthread_create(& threads[t], nullptr, exchangeBlocks, & ok[t]);
+			}
+			bool intact = true;
+			for (size_t t = 0; t < 8; ++ t)
+			{
+				pthread_join(threads[t], nullptr);
+				intact = intact && ok[t];
+			}
+
+			// The blocks left in the slots are freed by this thread
+			for (size_t i = 0; i < 4096; ++ i)
+				if (exchanged[i])
+				{
+					nx::byte * block = static_cast<nx::byte *>(exchanged[i]);
+					operator delete (block, * reinterpret_cast<size_t *>(block));
+					exchanged[i] = nullptr;
+				}
+
+			nx::mem::Stats after = nx::mem::stats();
+			ExpectEqual(true, intact);
+			ExpectEqual(true, after.allocCount >= before.allocCount + 800000);
+			ExpectEqual(after.allocCount - before.allocCount, after.freeCount - before.freeCount);
+			ExpectEqual(after.largeAllocCount - before.largeAllocCount, after.largeFreeCount - before.largeFreeCount);
+			ExpectEqual(before.liveBytes, after.liveBytes);
+
+			// Flushed blocks are reused by the other threads, instead of carving new spans for each thread
+			ExpectEqual(true, after.mappedBytes < before.mappedBytes + (64 << 20));
+		}
+	);
+}
+
+void TestAligned(nx::Testing & test)
+{
+	test.runCase("Aligned", [] (bool)	// Aligned blocks for every power of two alignment, small and large
+		{
+			for (size_t align = 1; align <= 8192; align <<= 1)
+				for (size_t size = 1; size < 100000; size = size * 3 + 1)
+				{
+					void * ptr = operator new (size, std::align_val_t(align));
+					ExpectEqual(true, ptr != nullptr);
+					ExpectEqual(uintptr_t(0), reinterpret_cast<uintptr_t>(ptr) & (align - 1));
+					static_cast<nx::byte *>(ptr)[size - 1] = 0;
+					if (size & 1)
+						operator delete (ptr, size, std::align_val_t(align));
+					else
+						operator delete (ptr, std::align_val_t(align));
+				}
+		}
+	);
+
+	test.runCase("Sized", [] (bool)	// Sized delete returns blocks to the same size class
+		{
+			void * first = operator new (100);
+			operator delete (first, 100);
+			void * second = operator new (112);
+			ExpectEqual(true, first == second);
+			operator delete (second, 112);
+		}
+	);
+
+	test.runCase("Typed", [] (bool)	// Over-aligned types are allocated with their alignment
+		{
+			struct alignas(64) Line { nx::byte data[64]; };
+
+			for (size_t n = 1; n < 64; ++ n)
+			{
+				Line * lines = nx::type::alloc<Line>(n * sizeof(Line));
+				ExpectEqual(uintptr_t(0), reinterpret_cast<uintptr_t>(lines) & 63);
+				nx::type::free(lines, n * sizeof(Line));
+			}
+		}
+	);
+}
+
+void TestStats(nx::Testing & test)
+{
+	test.runCase("Counters", [] (bool)	// Allocations show up in the statistics, and disappear when freed
+		{
+			nx::mem::Stats before = nx::mem::stats();
+
+			static void * blocks[1000];
+			for (size_t i = 0; i < 1000; ++ i)
+				blocks[i] = operator new (64);
+			void * large = operator new (1 << 20);
+
+			nx::mem::Stats during = nx::mem::stats();
+			ExpectEqual(before.allocCount + 1001, during.allocCount);
+			ExpectEqual(before.sizeClasses[3].allocCount + 1000, during.sizeClasses[3].allocCount);
+			ExpectEqual(before.largeAllocCount + 1, during.largeAllocCount);
+			ExpectEqual(true, during.liveBytes >= before.liveBytes + 64000 + (1 << 20));
+			ExpectEqual(true, during.peakBytes >= during.liveBytes);
+
+			for (size_t i = 0; i < 1000; ++ i)
+				operator delete (blocks[i]);
+			operator delete (large);
+
+			nx::mem::Stats after = nx::mem::stats();
+			ExpectEqual(before.freeCount + 1001, after.freeCount);
+			ExpectEqual(before.liveBytes, after.liveBytes);
+			ExpectEqual(true, after.peakBytes >= during.liveBytes);
+		}
+	);
+}
+
+void TestMapped(nx::Testing & test)
+{
+	test.runCase("Mapped", [] (bool)	// Blocks above the threshold are mapped directly, and counted as large blocks
+		{
+			nx::mem::setMapThreshold(256 * 1024);
+			nx::mem::Stats before = nx::mem::stats();
+
+			static nx::byte * blocks[16];
+			for (size_t i = 0; i < 16; ++ i)
+			{
+				size_t align = size_t(16) << i % 10;
+				blocks[i] = static_cast<nx::byte *>(operator new ((i + 1) * 100000, std::align_val_t(align)));
+				ExpectEqual(true, blocks[i] != nullptr);
+				ExpectEqual(uintptr_t(0), reinterpret_cast<uintptr_t>(blocks[i]) & (align - 1));
+				blocks[i][0] = blocks[i][(i + 1) * 100000 - 1] = nx::byte(i);
+			}
+
+			nx::mem::Stats during = nx::mem::stats();
+			ExpectEqual(before.largeAllocCount + 16, during.largeAllocCount);
+			ExpectEqual(true, during.largeBytes >= before.largeBytes + 136 * 100000);
+
+			for (size_t i = 0; i < 16; ++ i)
+			{
+				ExpectEqual(nx::byte(i), blocks[i][(i + 1) * 100000 - 1]);
+				operator delete (blocks[i], std::align_val_t(size_t(16) << i % 10));
+			}
+
+			nx::mem::Stats after = nx::mem::stats();
+			ExpectEqual(before.largeFreeCount + 16, after.largeFreeCount);
+			ExpectEqual(before.largeBytes, after.largeBytes);
+			nx::mem::setMapThreshold(nx::mem::defaultMapThreshold);
+		}
+	);
+
+	test.runCase("Reallocate", [] (bool)	// Blocks keep their contents through every kind of resize
+		{
+			// Same size class - in place (only the requested size is written)
+			void * first = operator new (110);
+			ExpectEqual(true, nx::mem::reallocate(first, 110, 100) == first);
+
+			// Small, malloc, and directly mapped sizes, growing and shrinking
+			size_t sizes[] = {110, 1000, 40000, 500000, 3 << 20, 64 << 20, 5 << 20, 300000, 2000, 50};
+			size_t old = 100;
+			nx::byte * block = static_cast<nx::byte *>(first);
+			for (size_t i = 0; i < old; ++ i)
+				block[i] = nx::byte(i * 7);
+
+			for (size_t size : sizes)
+			{
+				block = static_cast<nx::byte *>(nx::mem::reallocate(block, old, size));
+				ExpectEqual(true, block != nullptr);
+
+				bool intact = true;
+				for (size_t i = 0; i < (old < size ? old : size); ++ i)
+					intact = intact && block[i] == nx::byte(i * 7);
+				ExpectEqual(true, intact);
+
+				for (size_t i = old; i < size; ++ i)
+					block[i] = nx::byte(i * 7);
+				old = size;
+			}
+			operator delete (block, old);
+
+			// Aligned blocks stay aligned
+			void * aligned = operator new (1000, std::align_val_t(256));
+			aligned = nx::mem::reallocate(aligned, 1000, 2 << 20, 256);
+			ExpectEqual(uintptr_t(0), reinterpret_cast<uintptr_t>(aligned) & 255);
+			operator delete (aligned, 2 << 20, std::align_val_t(256));
+		}
+	);
+
+	test.runCase("HugePages", [] (bool)	// Huge pages (or the fallback to normal pages) work in every mode
+		{
+			nx::mem::HugePages modes[] = {nx::mem::HugePages::transparent, nx::mem::HugePages::hugetlb};
+			for (nx::mem::HugePages mode : modes)
+			{
+				nx::mem::setHugePages(mode);
+				nx::byte * block = static_cast<nx::byte *>(operator new (5 << 20));
+				ExpectEqual(true, block != nullptr);
+				for (size_t i = 0; i < (5 << 20); i += 4096)
+					block[i] = nx::byte(i >> 12);
+				ExpectEqual(nx::byte(1279), block[1279 << 12]);
+				operator delete (block);
+			}
+			nx::mem::setHugePages(nx::mem::HugePages::none);
+		}
+	);
+}
+
+// Reclaim callback, that releases a reserved block
+struct Reserve
+{
+	void * block;
+	size_t calls;
+	size_t requested;
+
+	static size_t release(size_t size, void * context) noexcept
+	{
+		Reserve * reserve = static_cast<Reserve *>(context);
+		reserve->calls ++;
+		reserve->requested = size;
+		if (!reserve->block)
+			return 0;
+		operator delete (reserve->block, 4096);
+		reserve->block = nullptr;
+		return 4096;
+	}
+};
+
+void TestReclaim(nx::Testing & test)
+{
+	test.runCase("Callbacks", [] (bool)	// Callbacks are called when an allocation fails, and not after they are removed
+		{
+			Reserve first = {operator new (4096), 0, 0};
+			Reserve second = {nullptr, 0, 0};
+			ExpectEqual(true, nx::mem::addReclaimCallback(Reserve::release, & first));
+			ExpectEqual(true, nx::mem::addReclaimCallback(Reserve::release, & second));
+
+			// The allocation can't succeed, so every callback is called (volatile, so gcc doesn't assume non-null results)
+			size_t huge = size_t(1) << 62;
+			void * volatile block = operator new (huge);
+			ExpectEqual(true, block == nullptr);
+			ExpectEqual(size_t(1), first.calls);
+			ExpectEqual(size_t(1), second.calls);
+			ExpectEqual(huge, second.requested);
+			ExpectEqual(true, first.block == nullptr);
+
+			// Callbacks can be called directly
+			first.block = operator new (4096);
+			ExpectEqual(size_t(4096), nx::mem::reclaim(100));
+			ExpectEqual(size_t(100), first.requested);
+
+			nx::mem::removeReclaimCallback(Reserve::release, & first);
+			block = operator new (huge, std::align_val_t(64));
+			ExpectEqual(true, block == nullptr);
+			ExpectEqual(size_t(2), first.calls);
+			ExpectEqual(size_t(3), second.calls);
+
+			nx::mem::removeReclaimCallback(Reserve::release, & second);
+			ExpectEqual(size_t(0), nx::mem::reclaim(100));
+			ExpectEqual(size_t(3), second.calls);
+		}
+	);
+}
+
+void TestProfiler(nx::Testing & test)
+{
+	test.runCase("Sampling", [] (bool)	// Samples are recorded, and the profile can be dumped
+		{
+			ExpectEqual(true, nx::mem::startProfiler(4096));
+			ExpectEqual(false, nx::mem::startProfiler(4096));
+
+			static void * blocks[1000];
+			for (size_t i = 0; i < 1000; ++ i)
+				blocks[i] = operator new (256);
+			for (size_t i = 0; i < 500; ++ i)
+				operator delete (blocks[i]);
+			nx::mem::stopProfiler();
+
+			ExpectEqual(true, nx::mem::dumpProfile("test-nx-new.prof"));
+
+			// Header, and the number of events (about 60 allocations and 30 deallocations)
+			FILE * file = fopen("test-nx-new.prof", "rb");
+			uint64_t header[4] = {0, 0, 0, 0};
+			ExpectEqual(true, file && fread(header, sizeof(header), 1, file) == 1);
+			ExpectEqual(nx::mem::ProfileMagic, header[0]);
+			ExpectEqual(uint64_t(4096), header[1]);
+			ExpectEqual(true, header[2] > 20 && header[2] < 200);
+			if (file)
+				fclose(file);
+			remove("test-nx-new.prof");
+
+			for (size_t i = 500; i < 1000; ++ i)
+				operator delete (blocks[i]);
+		}
+	);
+
+	test.runCase("Restart", [] (bool)	// A restart keeps the buffers, and only dumps the events of the new run
+		{
+			ExpectEqual(false, nx::mem::startProfiler(4096, 1 << 16));
+			ExpectEqual(true, nx::mem::startProfiler(1 << 30));
+			nx::mem::stopProfiler();
+
+			// No events were sampled since the restart (the interval is huge)
+			ExpectEqual(true, nx::mem::dumpProfile("test-nx-new.prof"));
+			FILE * file = fopen("test-nx-new.prof", "rb");
+			uint64_t header[4] = {1, 1, 1, 1};
+			ExpectEqual(true, file && fread(header, sizeof(header), 1, file) == 1);
+			ExpectEqual(uint64_t(0), header[2]);
+			ExpectEqual(uint64_t(0), header[3]);
+			if (file)
+				fclose(file);
+			remove("test-nx-new.prof");
+		}
+	);
+}
+
+void TestSession(nx::Testing & test)
+{
+	test.runGroup("Allocator", TestAllocator);
+	test.runGroup("Threads", TestThreads);
+	test.runGroup("Aligned", TestAligned);
+	test.runGroup("Stats", TestStats);
+	test.runGroup("Mapped", TestMapped);
+	test.runGroup("Reclaim", TestReclaim);
+	test.runGroup("Profiler", TestProfiler);
+}
+
+int main()
+{
+	return nx::Testing::get().runSession("NX New", TestSession);
+}
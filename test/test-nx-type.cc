@@ -66,6 +66,131 @@ void TestArray(nx::Testing & test)
 			
 		}
 	);
+
+	test.runCase("Copy & fill", [] (bool)	// Overlapping copies in both directions, and fills with every kind of item
+		{
+			struct Item { int value; Item & operator = (const Item & other) {value = other.value; return * this;} };
+
+			auto ints = nx::makeArray<int>(100);
+			auto items = nx::makeArray<Item>(100);
+			for (size_t shift = 1; shift < 40; shift += 13)
+			{
+				// Forward (to a higher index), and backward
+				for (size_t i = 0; i < 100; ++ i)
+					ints[i] = items[i].value = int(i);
+				nx::Array<int>::copy(*ints, 10, *ints, 10 + shift, 50);
+				nx::Array<Item>::copy(*items, 10, *items, 10 + shift, 50);
+				for (size_t i = 0; i < 50; ++ i)
+				{
+					ExpectEqual(int(10 + i), ints[10 + shift + i]);
+					ExpectEqual(int(10 + i), items[10 + shift + i].value);
+				}
+
+				for (size_t i = 0; i < 100; ++ i)
+					ints[i] = items[i].value = int(i);
+				nx::Array<int>::copy(*ints, 10 + shift, *ints, 10, 50);
+				nx::Array<Item>::copy(*items, 10 + shift, *items, 10, 50);
+				for (size_t i = 0; i < 50; ++ i)
+				{
+					ExpectEqual(int(10 + shift + i), ints[10 + i]);
+					ExpectEqual(int(10 + shift + i), items[10 + i].value);
+				}
+			}
+
+			int values[] = {0, -1, 0x01010101, 12345};
+			for (int value : values)
+			{
+				nx::Array<int>::fill(*ints, 3, 90, value);
+				nx::Array<Item>::fill(*items, 3, 90, Item{value});
+				ExpectEqual(value, ints[3]);
+				ExpectEqual(value, ints[92]);
+				ExpectEqual(value, items[92].value);
+				ExpectEqual(2, ints[2]);
+				ExpectEqual(93, ints[93]);
+			}
+		}
+	);
+
+	test.runCase("Uninitialized & zeroed", [] (bool)	// Zeroed arrays are zero, even when their memory was used before
+		{
+			size_t sizes[] = {10, 1000, 100000, 1 << 20};
+			for (size_t n : sizes)
+			{
+				auto dirty = nx::makeArray<int>(n);
+				nx::Array<int>::fill(*dirty, -1);
+				dirty.reset();
+
+				auto zeroed = nx::UniquePtr<nx::Array<int>>(nx::Array<int>::createZeroed(n));
+				ExpectEqual(n, zeroed->length);
+				bool zero = true;
+				for (size_t i = 0; i < n; ++ i)
+					zero = zero && zeroed[i] == 0;
+				ExpectEqual(true, zero);
+
+				auto uninitialized = nx::UniquePtr<nx::Array<int>>(nx::Array<int>::createUninitialized(n));
+				ExpectEqual(n, uninitialized->length);
+				uninitialized[n - 1] = 42;
+				ExpectEqual(42, uninitialized[n - 1]);
+			}
+		}
+	);
+
+	test.runCase("RawArray", [] (bool)	// Raw arrays only have a length in front of the items, and own them like arrays
+		{
+			ExpectEqual(sizeof(size_t), sizeof(nx::RawArray<int>));
+			ExpectEqual(size_t(4), sizeof(nx::RawArray<int, uint32_t>));
+			ExpectEqual(size_t(64), sizeof(nx::RawArray<int, uint32_t, 64>));
+
+			auto array = nx::makeRawArray<int, uint32_t>(1000);
+			ExpectEqual(uint32_t(1000), array->length);
+			for (size_t i = 0; i < array->length; ++ i)
+				array[i] = int(i);
+			size_t i = 0;
+			for (int x : *array)
+				ExpectEqual(int(i ++), x);
+
+			auto copy = nx::UniquePtr<nx::RawArray<int, uint32_t>>(nx::RawArray<int, uint32_t>::create(array.get()));
+			ExpectEqual(999, copy[999]);
+
+			auto aligned = nx::makeRawArray<double, uint32_t, 64>(10);
+			ExpectEqual(uintptr_t(0), reinterpret_cast<uintptr_t>(aligned->data) & 63);
+
+			// Lengths that don't fit
+			ExpectEqual(true, nx::RawArray<int, uint8_t>::create(256) == nullptr);
+			auto small = nx::UniquePtr<nx::RawArray<int, uint8_t>>(nx::RawArray<int, uint8_t>::createFrom(1, 2, 3));
+			ExpectEqual(uint8_t(3), small->length);
+			ExpectEqual(3, small[2]);
+
+			// Items are destroyed with the array
+			auto names = nx::makeRawArray<nx::UniquePtr<int>>(3);
+			names[1].reset(new int(5));
+			names.reset();
+			ExpectEqual(true, names.get() == nullptr);
+		}
+	);
+
+	test.runCase("Trivial", [] (bool)	// Trivial types are detected, and copied as bytes
+		{
+			struct Point { int x, y; };
+			struct Named { Point point; nx::UniquePtr<int> name; };
+
+			ExpectEqual(true, nx::type::hasTrivialCreate<Point>() && nx::type::hasTrivialCopyCreate<Point>());
+			ExpectEqual(true, nx::type::hasTrivialMoveCreate<Point>() && nx::type::hasTrivialDestroy<Point>());
+			ExpectEqual(false, nx::type::hasTrivialCopyCreate<Named>() || nx::type::hasTrivialMoveCreate<Named>());
+			ExpectEqual(false, nx::type::hasTrivialDestroy<Named>());
+
+			auto array = nx::makeArray<Point>(1000);
+			for (size_t i = 0; i < array->length; ++ i)
+				array[i] = Point{int(i), -int(i)};
+
+			nx::Array<Point> * copy = nx::Array<Point>::create(array.get());
+			bool equal = true;
+			for (size_t i = 0; i < copy->length; ++ i)
+				equal = equal && copy->data[i].x == int(i) && copy->data[i].y == -int(i);
+			ExpectEqual(true, equal);
+			delete copy;
+		}
+	);
 }
 
 void TestTuple(nx::Testing & test)
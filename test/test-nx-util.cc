@@ -5,6 +5,9 @@
 #include <nx-util.hh>
 #include <nx-rng.hh>
 
+// Include threads
+#include <pthread.h>
+
 void TestRange(nx::Testing & test)
 {
 	test.runCase( "Range<int>" , [] (bool)
@@ -14,35 +17,35 @@ void TestRange(nx::Testing & test)
 
 			j = 0;
 			for (int i: nx::range(10))
-				expectEqual(j ++, i);
-			expectEqual(10, j);
+				ExpectEqual(j ++, i);
+			ExpectEqual(10, j);
 
 			j = 10;
 			for (int i: nx::range(10, 0, -1))
-				expectEqual(j --, i);
-			expectEqual(0, j);
+				ExpectEqual(j --, i);
+			ExpectEqual(0, j);
 			
 			n = 0;
 			j = 0;
 			for (int i: nx::range(0, 10, 3))
 			{
-				expectEqual(j, i);
+				ExpectEqual(j, i);
 				++ n;
 				j += 3;
 			}
-			expectEqual(4, n);
-			expectEqual(12, j);
+			ExpectEqual(4, n);
+			ExpectEqual(12, j);
 			
 			n = 0;
 			j = 10;
 			for (int i: nx::range(10, 0, -3))
 			{
-				expectEqual(j, i);
+				ExpectEqual(j, i);
 				++ n;
 				j -= 3;
 			}
-			expectEqual(4, n);
-			expectEqual(-2, j);
+			ExpectEqual(4, n);
+			ExpectEqual(-2, j);
 			
 		}
 	);
@@ -55,34 +58,34 @@ void TestRange(nx::Testing & test)
 			j = 0;
 			for (double f: nx::range(10.0))
 			{
-				expectEqual(double(j++), f);
+				ExpectEqual(double(j++), f);
 			}
-			expectEqual(10, j);
+			ExpectEqual(10, j);
 			
 			j = 10;
 			for (double f: nx::range(10.0, 0.0, -1.0))
-				expectEqual(double(j--), f);
-			expectEqual(0, j);
+				ExpectEqual(double(j--), f);
+			ExpectEqual(0, j);
 			
 			n = 0;
 			g = 0.0;
 			for (double f: nx::range(0.0, 10.0, 3.0/7.0))
 			{
-				expectEqual(g, f);
+				ExpectEqual(g, f);
 				++ n;
 				g += 3.0/7.0;
 			}
-			expectEqual(24, n);
+			ExpectEqual(24, n);
 			
 			n = 0;
 			g = 10.0;
 			for (double f: nx::range(10.0, 0.0, -3.0/7.0))
 			{
-				expectEqual(g, f);
+				ExpectEqual(g, f);
 				++ n;
 				g -= 3.0/7.0;
 			}
-			expectEqual(24, n);
+			ExpectEqual(24, n);
 		}			
 	);
 }
@@ -92,9 +95,9 @@ void TestList(nx::Testing & test)
 	test.runCase( "Sanity" , [] (bool)	// List sanity test - Make sure nothing is broken from the start
 		{
 			nx::List<uint64_t> list;
-			expectEqual(0, list.size());
-			expectEqual(0, list.capacity());
-			expectEqual(0, list.end() - list.begin());
+			ExpectEqual(0, list.size());
+			ExpectEqual(0, list.capacity());
+			ExpectEqual(0, list.end() - list.begin());
 		}
 	);
 
@@ -105,10 +108,10 @@ void TestList(nx::Testing & test)
 				nx::List<int> list;
 				
 				list.reserve(16);
-				expectEqual(16, list.capacity());
+				ExpectEqual(16, list.capacity());
 
 				list.resize(16);
-				expectEqual(16, list.size());
+				ExpectEqual(16, list.size());
 			}
 
 			// Test double
@@ -116,10 +119,10 @@ void TestList(nx::Testing & test)
 				nx::List<double> list;
 				
 				list.reserve(16);
-				expectEqual(16, list.capacity());
+				ExpectEqual(16, list.capacity());
 
 				list.resize(16);
-				expectEqual(16, list.size());
+				ExpectEqual(16, list.size());
 			}
 			
 			// Test List
@@ -127,10 +130,10 @@ void TestList(nx::Testing & test)
 				nx::List<nx::List<int>> list;
 				
 				list.reserve(16);
-				expectEqual(16, list.capacity());
+				ExpectEqual(16, list.capacity());
 
 				list.resize(16);
-				expectEqual(16, list.size());
+				ExpectEqual(16, list.size());
 			}
 			
 			// Test UniquePtr
@@ -138,15 +141,116 @@ void TestList(nx::Testing & test)
 				nx::List<nx::UniquePtr<int>> list;
 				
 				list.reserve(16);
-				expectEqual(16, list.capacity());
+				ExpectEqual(16, list.capacity());
 
 				list.resize(16);
-				expectEqual(16, list.size());
+				ExpectEqual(16, list.size());
 			}
 
 		}
 	);
 	
+	test.runCase( "Relocate" , [] (bool)	// Trivially relocatable items keep their values, when the buffer is resized
+		{
+			ExpectEqual(true, nx::type::isTriviallyRelocatable<nx::UniquePtr<int>>());
+			ExpectEqual(true, nx::type::isTriviallyRelocatable<nx::List<int>>());
+
+			nx::List<nx::UniquePtr<int>> list;
+			for (int i = 0; i < 100000; ++ i)
+				list.append(nx::UniquePtr<int>(new int(i)));
+			list.compact();
+
+			bool intact = true;
+			for (int i = 0; i < 100000; ++ i)
+				intact = intact && * list[i] == i;
+			ExpectEqual(true, intact);
+			ExpectEqual(size_t(100000), list.capacity());
+		}
+	);
+	
+	test.runCase( "Emplace & Insert" , [] (bool)	// Items are constructed in place, at the end and in the middle
+		{
+			nx::List<nx::Pair<int, int>> pairs;
+			for (int i = 0; i < 100; ++ i)
+				ExpectEqual(i, pairs.emplace(i, -i).first);
+			pairs.insert(0, 1000, 0);
+			pairs.insert(50, 2000, 0);
+			pairs.insert(1000, 3000, 0);
+			ExpectEqual(size_t(103), pairs.size());
+			ExpectEqual(1000, pairs[0].first);
+			ExpectEqual(48, pairs[49].first);
+			ExpectEqual(2000, pairs[50].first);
+			ExpectEqual(49, pairs[51].first);
+			ExpectEqual(3000, pairs[102].first);
+
+			// Items, that are not trivially relocatable, are shifted by moving them
+			struct Tracked
+			{
+				int value;
+				Tracked * self;
+
+				Tracked(int value) : value(value), self(this) {}
+				Tracked(const Tracked & other) : value(other.value), self(this) {}
+				Tracked & operator = (const Tracked & other) {value = other.value; return * this;}
+			};
+			nx::List<Tracked> tracked;
+			for (int i = 0; i < 20; ++ i)
+				tracked.insert(i / 2, i);
+			bool intact = true;
+			for (size_t i = 0; i < tracked.size(); ++ i)
+				intact = intact && tracked[i].self == & tracked[i];
+			ExpectEqual(true, intact);
+			ExpectEqual(19, tracked[9].value);
+			ExpectEqual(0, tracked[19].value);
+
+			// Arguments, that are items of the list itself, through growth and shifts
+			nx::List<nx::Pair<int, int>> self;
+			for (int i = 0; i < 16; ++ i)
+				self.emplace(i, i);
+			while (self.size() < self.capacity())
+				self.emplace(0, 0);
+			self.emplace(self[1]);
+			ExpectEqual(1, self[self.size() - 1].first);
+			self.insert(0, self[2]);
+			ExpectEqual(2, self[0].first);
+			ExpectEqual(0, self[1].first);
+			size_t size = self.size();
+			self.appendN(self.capacity(), self[3]);
+			ExpectEqual(2, self[size].first);
+			ExpectEqual(2, self[self.size() - 1].first);
+			while (self.size() < self.capacity())
+				self.emplace(0, 0);
+			self.append(self[0]);
+			ExpectEqual(2, self[self.size() - 1].first);
+			while (self.size() < self.capacity())
+				self.emplace(0, 0);
+			self.append(nx::rvalue(self[4]));
+			ExpectEqual(3, self[self.size() - 1].first);
+		}
+	);
+
+	test.runCase( "Bulk" , [] (bool)	// Bulk appends reserve once
+		{
+			nx::List<int> list;
+			list.appendN(1000, 7);
+			ExpectEqual(size_t(1000), list.size());
+			ExpectEqual(7, list[999]);
+
+			int values[] = {1, 2, 3, 4, 5};
+			list.extend(values, 5);
+			list.extend(values + 1, values + 3);
+			ExpectEqual(size_t(1007), list.size());
+			ExpectEqual(5, list[1004]);
+			ExpectEqual(3, list[1006]);
+
+			int * slots = list.appendUninitialized(100);
+			for (int i = 0; i < 100; ++ i)
+				slots[i] = i;
+			ExpectEqual(size_t(1107), list.size());
+			ExpectEqual(99, list[1106]);
+		}
+	);
+	
 	test.runCase( "Append & Extend" , [] (bool)
 		{
 			nx::rng::Random r(2018);
@@ -157,55 +261,895 @@ void TestList(nx::Testing & test)
 			for (size_t i : nx::range(16))
 			{
 				list1.append(uint64_t(list[i]));
-				expectEqual(i + 1, list1.size());
+				ExpectEqual(i + 1, list1.size());
 			}
 			
 			// Check elements
 			for (size_t i : nx::range(16))
-				expectEqual(list[i], list1[i]);
+				ExpectEqual(list[i], list1[i]);
 			
 			// Append const T &
 			nx::List<uint64_t> list2;			
 			for (size_t i : nx::range(16))
 			{
 				list2.append(list[i]);
-				expectEqual(i + 1, list2.size());
+				ExpectEqual(i + 1, list2.size());
 			}
 			
 			// Check elements
 			for (size_t i : nx::range(16))
-				expectEqual(list[i], list1[i]);
+				ExpectEqual(list[i], list1[i]);
 			
 			// Extend T &&
 			nx::List<uint64_t> list3;
 			for (size_t i : nx::range(16))
 			{
 				list3.extend(nx::List<uint64_t>(list1));
-				expectEqual((i + 1) * list1.size(), list3.size());
+				ExpectEqual((i + 1) * list1.size(), list3.size());
 			}
 			
 			// Check elements
 			for (size_t i : nx::range(16))
 				for (size_t j : nx::range(16))
-					expectEqual(list[j], list3[i*16 + j]);
+					ExpectEqual(list[j], list3[i*16 + j]);
 			
 			// Extend const T &
 			nx::List<uint64_t> list4;
 			for (size_t i : nx::range(16))
 			{
 				list4.extend(list1);
-				expectEqual((i + 1) * list1.size(), list4.size());
+				ExpectEqual((i + 1) * list1.size(), list4.size());
 			}
 			
 			// Check elements
 			for (size_t i : nx::range(16))
 				for (size_t j : nx::range(16))
-					expectEqual(list[j], list4[i*16 + j]);
+					ExpectEqual(list[j], list4[i*16 + j]);
 		}
 	);
 	
 }
 
+void TestSmallList(nx::Testing & test)
+{
+	test.runCase( "Inline & spill" , [] (bool)	// Short lists stay inline, longer ones spill to the heap, and come back with compact
+		{
+			nx::mem::Stats before = nx::mem::stats();
+			nx::SmallList<int, 8> list;
+			for (int i = 0; i < 8; ++ i)
+				list.append(i);
+			ExpectEqual(true, list.isInline());
+			ExpectEqual(before.allocCount, nx::mem::stats().allocCount);
+
+			for (int i = 8; i < 100; ++ i)
+				list.append(i);
+			ExpectEqual(false, list.isInline());
+			ExpectEqual(size_t(100), list.size());
+
+			list.resize(5);
+			list.compact();
+			ExpectEqual(true, list.isInline());
+			ExpectEqual(size_t(8), list.capacity());
+
+			int sum = 0;
+			for (int x : list)
+				sum += x;
+			ExpectEqual(10, sum);
+		}
+	);
+
+	test.runCase( "Copy & move" , [] (bool)	// Inline and spilled lists can be copied, moved and extended
+		{
+			int lengths[] = {3, 30};
+			for (int length : lengths)
+			{
+				nx::SmallList<nx::UniquePtr<int>, 4> list;
+				for (int i = 0; i < length; ++ i)
+					list.append(nx::UniquePtr<int>(new int(i)));
+
+				nx::SmallList<nx::UniquePtr<int>, 4> moved(static_cast<nx::SmallList<nx::UniquePtr<int>, 4> &&>(list));
+				ExpectEqual(size_t(0), list.size());
+				ExpectEqual(size_t(length), moved.size());
+				ExpectEqual(length - 1, * moved[length - 1]);
+
+				list = static_cast<nx::SmallList<nx::UniquePtr<int>, 4> &&>(moved);
+				ExpectEqual(size_t(length), list.size());
+				ExpectEqual(0, * list[0]);
+			}
+
+			nx::SmallList<int, 4> a;
+			a.append(1);
+			a.append(2);
+			nx::SmallList<int, 4> b(a);
+			b.extend(a);
+			b += a;
+			ExpectEqual(size_t(6), b.size());
+			ExpectEqual(2, b[5]);
+
+			a = b;
+			ExpectEqual(size_t(6), a.size());
+			ExpectEqual(false, a.isInline());
+		}
+	);
+
+	test.runCase( "Aliasing" , [] (bool)	// Items of the list itself can be appended, and the list can extend itself, when it grows
+		{
+			nx::SmallList<int, 4> list;
+			list.append(1);
+			while (list.size() < 16)
+				list.append(2);
+			ExpectEqual(size_t(16), list.capacity());
+			list.append(list[0]);
+			ExpectEqual(1, list[16]);
+			ExpectEqual(size_t(24), list.capacity());
+
+			while (list.size() < list.capacity())
+				list.append(3);
+			list.append(static_cast<int &&>(list[0]));
+			ExpectEqual(1, list[24]);
+
+			list.extend(list);
+			ExpectEqual(size_t(50), list.size());
+			ExpectEqual(1, list[25]);
+			ExpectEqual(1, list[49]);
+		}
+	);
+}
+
+void TestChunkedList(nx::Testing & test)
+{
+	test.runCase( "Append & index" , [] (bool)	// Items keep their address, and can be found by index
+		{
+			nx::ChunkedList<size_t> list;
+			static size_t * addresses[100000];
+			for (size_t i = 0; i < 100000; ++ i)
+			{
+				list.append(i);
+				addresses[i] = & list[i];
+			}
+
+			bool stable = true;
+			for (size_t i = 0; i < 100000; ++ i)
+				stable = stable && & list[i] == addresses[i] && * addresses[i] == i;
+			ExpectEqual(true, stable);
+			ExpectEqual(size_t(16), list.chunkLength(0));
+			ExpectEqual(size_t(32), list.chunkLength(1));
+			ExpectEqual(true, list.capacity() >= list.size());
+		}
+	);
+
+	test.runCase( "Iterate" , [] (bool)	// Iteration by item and by chunk visits every item once, in order
+		{
+			size_t lengths[] = {0, 1, 16, 47, 48, 1000};
+			for (size_t length : lengths)
+			{
+				nx::ChunkedList<size_t> list;
+				for (size_t i = 0; i < length; ++ i)
+					list.emplace(i);
+
+				size_t next = 0;
+				bool ordered = true;
+				for (size_t x : list)
+					ordered = ordered && x == next ++;
+				ExpectEqual(true, ordered);
+				ExpectEqual(length, next);
+
+				size_t sum = 0;
+				list.forEachChunk([&] (size_t * items, size_t count) {for (size_t i = 0; i < count; ++ i) sum += items[i];});
+				ExpectEqual(length * (length - 1) / 2, sum);
+			}
+		}
+	);
+
+	test.runCase( "Copy & move" , [] (bool)	// Items are copied and destroyed, and chunks are taken over by moves
+		{
+			nx::ChunkedList<nx::UniquePtr<int>> owned;
+			for (int i = 0; i < 100; ++ i)
+				owned.emplace(new int(i));
+			nx::ChunkedList<nx::UniquePtr<int>> moved(static_cast<nx::ChunkedList<nx::UniquePtr<int>> &&>(owned));
+			ExpectEqual(size_t(0), owned.size());
+			ExpectEqual(99, * moved[99]);
+
+			nx::ChunkedList<int> list;
+			int values[] = {1, 2, 3};
+			for (int i = 0; i < 20; ++ i)
+				list.extend(values, 3);
+			nx::ChunkedList<int> copy(list);
+			copy = list;
+			ExpectEqual(size_t(60), copy.size());
+			ExpectEqual(3, copy[59]);
+		}
+	);
+}
+
+void TestDeque(nx::Testing & test)
+{
+	test.runCase( "Push & pop" , [] (bool)	// Items come out in the right order at both ends, across growth and wrap around
+		{
+			nx::Deque<int> deque;
+			ExpectEqual(size_t(0), deque.capacity());
+
+			for (int i = 0; i < 10; ++ i)
+				deque.pushBack(i);
+			for (int i = 0; i < 5; ++ i)
+				ExpectEqual(i, deque.popFront());
+			for (int i = 1; i <= 20; ++ i)
+				deque.pushFront(-i);
+			ExpectEqual(size_t(25), deque.size());
+			ExpectEqual(-20, deque.front());
+			ExpectEqual(9, deque.back());
+			ExpectEqual(-1, deque[19]);
+			ExpectEqual(5, deque[20]);
+
+			int next = -20;
+			bool ordered = true;
+			for (int x : deque)
+			{
+				ordered = ordered && x == next;
+				next = next == -1 ? 5 : next + 1;
+			}
+			ExpectEqual(true, ordered);
+			ExpectEqual(9, deque.popBack());
+			ExpectEqual(-20, deque.popFront());
+		}
+	);
+
+	test.runCase( "Spans" , [] (bool)	// Bulk pushes and pops go through at most two spans
+		{
+			nx::Deque<int> deque;
+			int values[100];
+			for (int i = 0; i < 100; ++ i)
+				values[i] = i;
+
+			deque.pushBack(values, 12);
+			int out[100];
+			deque.popFront(out, 10);
+			deque.pushBack(values + 12, 10);
+			ExpectEqual(size_t(16), deque.capacity());
+			ExpectEqual(size_t(6), deque.headSpan().second);
+			ExpectEqual(size_t(6), deque.tailSpan().second);
+			ExpectEqual(10, deque.headSpan().first[0]);
+			ExpectEqual(21, deque.tailSpan().first[5]);
+
+			// Growing keeps the order of wrapped items
+			deque.pushBack(values + 22, 78);
+			deque.popFront(out, 90);
+			bool ordered = true;
+			for (int i = 0; i < 90; ++ i)
+				ordered = ordered && out[i] == i + 10;
+			ExpectEqual(true, ordered);
+
+			nx::Deque<nx::UniquePtr<int>> owned;
+			for (int i = 0; i < 40; ++ i)
+				owned.pushFront(nx::UniquePtr<int>(new int(i)));
+			nx::Deque<nx::UniquePtr<int>> moved(static_cast<nx::Deque<nx::UniquePtr<int>> &&>(owned));
+			ExpectEqual(39, * moved.front());
+			ExpectEqual(0, * moved.popBack());
+
+			nx::Deque<int> copy(deque);
+			ExpectEqual(size_t(0), copy.size());
+			deque.pushFront(1);
+			copy = deque;
+			ExpectEqual(1, copy.front());
+		}
+	);
+
+	test.runCase( "Aliasing" , [] (bool)	// Items of the deque itself can be pushed, when it grows
+		{
+			nx::Deque<int> deque;
+			deque.pushBack(1);
+			while (deque.size() < deque.capacity())
+				deque.pushBack(2);
+			size_t capacity = deque.capacity();
+			deque.pushBack(deque.front());
+			ExpectEqual(1, deque.back());
+			ExpectEqual(2 * capacity, deque.capacity());
+
+			while (deque.size() < deque.capacity())
+				deque.pushFront(3);
+			deque.pushFront(deque.back());
+			ExpectEqual(1, deque.front());
+			ExpectEqual(4 * capacity, deque.capacity());
+		}
+	);
+}
+
+// Item, that counts its live instances (not trivially relocatable)
+struct Tracked
+{
+	static int live;
+	int value;
+
+	Tracked(int value) : value(value) {live ++;}
+	Tracked(const Tracked & other) : value(other.value) {live ++;}
+	~Tracked() {live --;}
+
+	bool operator == (const Tracked & other) const noexcept
+		{return value == other.value;}
+};
+
+int Tracked::live = 0;
+
+namespace nx {
+template<> struct Hash<Tracked>
+{
+	static uint64_t hash(const Tracked & item) noexcept
+		{return nx::hash(item.value);}
+};
+}
+
+void TestSet(nx::Testing & test)
+{
+	test.runCase( "Insert & erase" , [] (bool)	// Items are found after inserts, and gone after erases, through growth
+		{
+			nx::Set<int> set;
+			ExpectEqual(size_t(0), set.capacity());
+			ExpectEqual(false, set.contains(0));
+			ExpectEqual(false, set.erase(0));
+
+			for (int i = 0; i < 10000; ++ i)
+				ExpectEqual(true, set.insert(i * 3));
+			ExpectEqual(false, set.insert(300));
+			ExpectEqual(size_t(10000), set.size());
+			ExpectEqual(size_t(16384), set.capacity());
+
+			bool found = true;
+			for (int i = 0; i < 30000; ++ i)
+				found = found && set.contains(i) == (i % 3 == 0);
+			ExpectEqual(true, found);
+
+			for (int i = 0; i < 10000; i += 2)
+				ExpectEqual(true, set.erase(i * 3));
+			found = true;
+			for (int i = 0; i < 10000; ++ i)
+				found = found && set.contains(i * 3) == (i % 2 == 1);
+			ExpectEqual(true, found);
+
+			size_t count = 0;
+			for (int x : set)
+				count += x % 6 == 3 ? 1 : 1000;
+			ExpectEqual(size_t(5000), count);
+		}
+	);
+
+	test.runCase( "Churn" , [] (bool)	// Deleted slots are reused and dropped, without growing the set
+		{
+			nx::Set<int> set;
+			set.reserve(100);
+			size_t capacity = set.capacity();
+			for (int round = 0; round < 1000; ++ round)
+			{
+				for (int i = 0; i < 50; ++ i)
+					set.insert(round * 50 + i);
+				for (int i = 0; i < 50; ++ i)
+					set.erase(round * 50 + i);
+			}
+			ExpectEqual(size_t(0), set.size());
+			ExpectEqual(capacity, set.capacity());
+			ExpectEqual(false, set.contains(49999));
+		}
+	);
+
+	test.runCase( "Bulk" , [] (bool)	// Bulk inserts count the new items, and bulk lookups fail on any missing item
+		{
+			static int ids[1000];
+			for (int i = 0; i < 1000; ++ i)
+				ids[i] = i % 700;
+
+			nx::Set<int> set;
+			ExpectEqual(true, set.containsAll(ids, 0));
+			ExpectEqual(false, set.containsAll(ids, 1));
+			ExpectEqual(size_t(700), set.insertAll(ids, 1000));
+			ExpectEqual(size_t(700), set.size());
+			ExpectEqual(size_t(0), set.insertAll(ids, 1000));
+			ExpectEqual(true, set.containsAll(ids, 1000));
+
+			set.erase(699);
+			ExpectEqual(false, set.containsAll(ids, 1000));
+			ExpectEqual(true, set.containsAll(ids, 699));
+		}
+	);
+
+	test.runCase( "Copy & move" , [] (bool)	// Copies are independent, moves leave an empty set, and items are destroyed
+		{
+			{
+				nx::Set<Tracked> owned;
+				for (int i = 0; i < 100; ++ i)
+					owned.insert(Tracked(i));
+				nx::Set<Tracked> moved(nx::rvalue(owned));
+				ExpectEqual(size_t(0), owned.size());
+				ExpectEqual(size_t(100), moved.size());
+				owned = nx::rvalue(moved);
+				ExpectEqual(size_t(100), owned.size());
+				ExpectEqual(100, Tracked::live);
+				owned.erase(Tracked(5));
+				ExpectEqual(99, Tracked::live);
+			}
+			ExpectEqual(0, Tracked::live);
+
+			nx::Set<int> set;
+			for (int i = 0; i < 100; ++ i)
+				set.insert(i);
+			nx::Set<int> copy(set);
+			set.clear();
+			ExpectEqual(false, set.contains(5));
+			ExpectEqual(true, copy.contains(5));
+			set = copy;
+			ExpectEqual(size_t(100), set.size());
+			ExpectEqual(true, set.contains(99));
+
+			// Empty sets don't allocate, even through copies and reserve(0)
+			nx::Set<int> empty;
+			empty.reserve(0);
+			nx::Set<int> emptyCopy(empty);
+			copy = empty;
+			ExpectEqual(size_t(0), empty.capacity());
+			ExpectEqual(size_t(0), emptyCopy.capacity());
+			ExpectEqual(size_t(0), copy.size());
+			ExpectEqual(false, emptyCopy.contains(1));
+		}
+	);
+}
+
+void TestIntSet(nx::Testing & test)
+{
+	test.runCase( "Add & remove" , [] (bool)	// Values move between array and bitmap containers, and stay in order
+		{
+			nx::IntSet<> set;
+			ExpectEqual(false, set.contains(0));
+			ExpectEqual(false, set.remove(0));
+
+			// Dense values (bitmaps), sparse values (arrays), and both ends of the range
+			for (uint32_t i = 0; i < 10000; ++ i)
+				ExpectEqual(true, set.add(i));
+			for (uint32_t i = 0; i < 1000; ++ i)
+				set.add(1000000 + i * 1000);
+			set.add(0xffffffff);
+			ExpectEqual(false, set.add(5000));
+			ExpectEqual(size_t(11001), set.size());
+			ExpectEqual(true, set.contains(9999) && set.contains(1000000 + 999 * 1000) && set.contains(0xffffffff));
+			ExpectEqual(false, set.contains(10000) || set.contains(1000001));
+
+			for (uint32_t i = 0; i < 10000; i += 2)
+				ExpectEqual(true, set.remove(i));
+			ExpectEqual(false, set.remove(2));
+			ExpectEqual(size_t(6001), set.size());
+
+			uint32_t last = 0;
+			size_t count = 0;
+			bool ordered = true;
+			set.forEach([&] (uint32_t value) {ordered = ordered && (count == 0 || value > last); last = value; count ++;});
+			ExpectEqual(true, ordered);
+			ExpectEqual(size_t(6001), count);
+			ExpectEqual(0xffffffffu, last);
+
+			// Removing every value drops the containers
+			for (uint32_t i = 1; i < 10000; i += 2)
+				set.remove(i);
+			set.remove(0xffffffff);
+			ExpectEqual(size_t(1000), set.size());
+		}
+	);
+
+	test.runCase( "Algebra" , [] (bool)	// Union, intersection and difference of every kind of container
+		{
+			// Multiples of 2 and 3, in dense and sparse ranges, with some of them as runs
+			nx::IntSet<> twos;
+			nx::IntSet<> threes;
+			for (uint32_t i = 0; i < 200000; i += 2)
+				twos.add(i);
+			for (uint32_t i = 0; i < 200000; i += 3)
+				threes.add(i);
+			for (uint32_t i = 0; i < 70000; ++ i)
+				twos.add(1 << 20 | i);
+			threes.add(1 << 20 | 5);
+			threes.add(3 << 20);
+			twos.optimize();
+
+			ExpectEqual(size_t(100000 / 3 + 1 + 1), twos.intersectionSize(threes));
+
+			nx::IntSet<> both(twos);
+			both.intersect(threes);
+			ExpectEqual(size_t(100000 / 3 + 1 + 1), both.size());
+			ExpectEqual(true, both.contains(6) && both.contains(1 << 20 | 5));
+			ExpectEqual(false, both.contains(4) || both.contains(9) || both.contains(3 << 20));
+
+			nx::IntSet<> either(twos);
+			either.unite(threes);
+			ExpectEqual(twos.size() + threes.size() - both.size(), either.size());
+			ExpectEqual(true, either.contains(9) && either.contains(3 << 20) && either.contains(1 << 20 | 69999));
+
+			nx::IntSet<> only(twos);
+			only.subtract(threes);
+			ExpectEqual(twos.size() - both.size(), only.size());
+			ExpectEqual(true, only.contains(4) && only.contains(1 << 20 | 6));
+			ExpectEqual(false, only.contains(6) || only.contains(1 << 20 | 5));
+
+			// Runs on the other side
+			nx::IntSet<> range;
+			for (uint32_t i = 100; i < 150000; ++ i)
+				range.add(i);
+			range.optimize();
+			nx::IntSet<> evens(twos);
+			evens.subtract(range);
+			ExpectEqual(size_t(50 + (200000 - 150000) / 2 + 70000), evens.size());
+			evens = twos;
+			evens.intersect(range);
+			ExpectEqual(size_t((150000 - 100) / 2), evens.size());
+			ExpectEqual(evens.size(), range.intersectionSize(twos));
+		}
+	);
+
+	test.runCase( "Runs" , [] (bool)	// Long ranges are compressed into runs, and can still be changed
+		{
+			nx::IntSet<> set;
+			for (uint32_t i = 0; i < 1000000; ++ i)
+				set.add(5000000 + i);
+			set.optimize();
+			ExpectEqual(size_t(1000000), set.size());
+			ExpectEqual(true, set.contains(5000000) && set.contains(5999999));
+			ExpectEqual(false, set.contains(4999999) || set.contains(6000000));
+
+			ExpectEqual(true, set.remove(5500000));
+			ExpectEqual(false, set.contains(5500000));
+			ExpectEqual(true, set.add(6000000));
+			ExpectEqual(size_t(1000000), set.size());
+
+			nx::IntSet<> moved(nx::rvalue(set));
+			ExpectEqual(size_t(0), set.size());
+			ExpectEqual(true, moved.contains(5500001));
+		}
+	);
+}
+
+// Key with a bad hash (the low bits select the group, and the high bits are the control byte)
+struct BadKey
+{
+	int value;
+	bool operator == (const BadKey & other) const noexcept
+		{return value == other.value;}
+};
+
+namespace nx {
+template<> struct Hash<BadKey>
+{
+	static uint64_t hash(const BadKey & key) noexcept
+		{return key.value % 2 ? uint64_t(key.value % 5) << 59 : 64;}
+};
+}
+
+void TestDictionary(nx::Testing & test)
+{
+	test.runCase( "Insert & erase" , [] (bool)	// Keys are found after inserts, and gone after erases
+		{
+			nx::Dictionary<int, int> dict;
+			ExpectEqual(size_t(0), dict.capacity());
+			ExpectEqual(false, dict.contains(1));
+
+			ExpectEqual(true, dict.insert(1, 10));
+			ExpectEqual(true, dict.insert(2, 20));
+			ExpectEqual(false, dict.insert(1, 11));
+			ExpectEqual(size_t(2), dict.size());
+			ExpectEqual(11, dict.get(1));
+			ExpectEqual(-1, dict.get(3, -1));
+			ExpectEqual(true, dict.find(3) == nullptr);
+
+			dict[3] += 30;
+			ExpectEqual(30, dict[3]);
+			ExpectEqual(true, dict.erase(1));
+			ExpectEqual(false, dict.erase(1));
+			ExpectEqual(false, dict.contains(1));
+			ExpectEqual(size_t(2), dict.size());
+
+			const nx::Dictionary<int, int> & view = dict;
+			ExpectEqual(0, view[1]);
+			ExpectEqual(size_t(2), dict.size());
+
+			ExpectEqual(true, dict.insert(1, 12));
+			ExpectEqual(12, * dict.find(1));
+		}
+	);
+
+	test.runCase( "Aliasing" , [] (bool)	// Keys and values, that are in the dictionary itself, survive growth and compaction
+		{
+			nx::Dictionary<int, int> dict;
+			for (int i = 0; i < 8; ++ i)
+				dict.insert(i, i + 1);
+			ExpectEqual(size_t(8), dict.capacity());
+			ExpectEqual(true, dict.insert(100, dict[3]));
+			ExpectEqual(4, dict.get(100));
+			ExpectEqual(size_t(16), dict.capacity());
+
+			// The key of the new entry is a value of the dictionary
+			while (dict.size() < dict.capacity())
+				dict.insert(int(dict.size()) + 200, 0);
+			dict[dict[2]] = 7;
+			ExpectEqual(7, dict.get(3));
+			dict[dict[100] + 1000] = 8;
+			ExpectEqual(8, dict.get(1004));
+
+			// Compaction instead of growth
+			size_t capacity = dict.capacity();
+			for (int i = 200; i < 220; ++ i)
+				dict.erase(i);
+			while (dict.size() + 0 < dict.capacity() && dict.insert(int(dict.size()) + 500, 0))
+				if (dict.capacity() != capacity)
+					break;
+			ExpectEqual(true, dict.insert(-1, dict[100]));
+			ExpectEqual(4, dict.get(-1));
+		}
+	);
+
+	test.runCase( "Growth" , [] (bool)	// Index tables of every width up to 32 bits, with erased keys between them
+		{
+			nx::Dictionary<uint32_t, uint32_t> dict;
+			for (uint32_t i = 0; i < 100000; ++ i)
+				dict.insert(i * 7, i);
+			ExpectEqual(size_t(100000), dict.size());
+			ExpectEqual(size_t(131072), dict.capacity());
+
+			bool found = true;
+			for (uint32_t i = 0; i < 100000; ++ i)
+				found = found && dict.get(i * 7, ~0u) == i && !dict.contains(i * 7 + 1);
+			ExpectEqual(true, found);
+
+			for (uint32_t i = 0; i < 100000; i += 2)
+				dict.erase(i * 7);
+			found = true;
+			for (uint32_t i = 0; i < 100000; ++ i)
+				found = found && dict.contains(i * 7) == (i % 2 == 1);
+			ExpectEqual(true, found);
+			ExpectEqual(size_t(50000), dict.size());
+
+			dict.compact();
+			ExpectEqual(size_t(65536), dict.capacity());
+			ExpectEqual(99999u, dict.get(99999 * 7));
+		}
+	);
+
+	test.runCase( "Order" , [] (bool)	// Iteration follows insertion order, through erases, compaction and growth
+		{
+			nx::Dictionary<int, int> dict;
+			for (int i = 0; i < 64; ++ i)
+				dict[i] = i;
+			for (int i = 0; i < 64; ++ i)
+				if (i % 4 != 0)
+					dict.erase(i);
+
+			// The node list is full, but mostly erased, so it's compacted (the capacity doesn't change)
+			for (int i = 100; i < 120; ++ i)
+				dict.insert(i, i);
+			ExpectEqual(size_t(36), dict.size());
+			ExpectEqual(size_t(64), dict.capacity());
+
+			// Reinserted keys go to the end
+			dict.erase(0);
+			dict.insert(0, 0);
+			int expected[36];
+			for (int i = 0; i < 15; ++ i)
+				expected[i] = 4 * (i + 1);
+			for (int i = 0; i < 20; ++ i)
+				expected[15 + i] = 100 + i;
+			expected[35] = 0;
+
+			size_t count = 0;
+			bool ordered = true;
+			for (auto & entry : dict)
+			{
+				ordered = ordered && entry.first == expected[count] && entry.second == expected[count];
+				count ++;
+			}
+			ExpectEqual(true, ordered);
+			ExpectEqual(size_t(36), count);
+
+			// Growth keeps the order too
+			for (int i = 200; i < 300; ++ i)
+				dict.insert(i, i);
+			ExpectEqual(size_t(256), dict.capacity());
+			ExpectEqual(4, (* dict.begin()).first);
+		}
+	);
+
+	test.runCase( "Collisions" , [] (bool)	// Keys with the same control byte, and keys in the same group, are still found
+		{
+			nx::Dictionary<BadKey, int> dict;
+			for (int i = 0; i < 300; ++ i)
+				dict.insert(BadKey{i}, i);
+			ExpectEqual(size_t(300), dict.size());
+
+			bool found = true;
+			for (int i = 0; i < 300; ++ i)
+				found = found && dict.get(BadKey{i}, -1) == i && !dict.contains(BadKey{i + 300});
+			ExpectEqual(true, found);
+
+			for (int i = 0; i < 300; i += 3)
+				dict.erase(BadKey{i});
+			found = true;
+			for (int i = 0; i < 300; ++ i)
+				found = found && dict.contains(BadKey{i}) == (i % 3 != 0);
+			ExpectEqual(true, found);
+		}
+	);
+
+	test.runCase( "Bulk" , [] (bool)	// Bulk lookups find the same values as single lookups, for every index width
+		{
+			static int keys[100000];
+			static int * values[100000];
+			static const int * constValues[100000];
+			static bool found[100000];
+			for (int i = 0; i < 100000; ++ i)
+				keys[i] = (i * 7919) % 150000;
+
+			nx::Dictionary<int, int> dict;
+			ExpectEqual(size_t(0), dict.getMany(keys, 100, values));
+			ExpectEqual(true, values[0] == nullptr && values[99] == nullptr);
+
+			size_t sizes[] = {100, 1000, 100000};
+			for (size_t size : sizes)
+			{
+				for (int i = 0; i < int(size); ++ i)
+					dict.insert(i, -i);
+				for (int i = 0; i < int(size); i += 5)
+					dict.erase(i);
+
+				size_t expected = 0;
+				for (int i = 0; i < 100000; ++ i)
+					expected += dict.contains(keys[i]);
+				ExpectEqual(expected, dict.getMany(keys, 100000, values));
+				ExpectEqual(expected, static_cast<const nx::Dictionary<int, int> &>(dict).getMany(keys, 100000, constValues));
+				ExpectEqual(expected, dict.containsMany(keys, 99999, found) + dict.contains(keys[99999]));
+
+				bool same = true;
+				for (int i = 0; i < 99999; ++ i)
+				{
+					same = same && found[i] == dict.contains(keys[i]) && values[i] == dict.find(keys[i]) && constValues[i] == values[i];
+					same = same && (values[i] == nullptr || * values[i] == -keys[i]);
+				}
+				ExpectEqual(true, same);
+			}
+
+			// Keys in the same groups
+			nx::Dictionary<BadKey, int> bad;
+			BadKey badKeys[300];
+			bool badFound[300];
+			for (int i = 0; i < 300; ++ i)
+			{
+				badKeys[i] = BadKey{i};
+				if (i % 2)
+					bad.insert(BadKey{i}, i);
+			}
+			ExpectEqual(size_t(150), bad.containsMany(badKeys, 300, badFound));
+			ExpectEqual(true, badFound[1] && !badFound[2] && badFound[299]);
+		}
+	);
+
+	test.runCase( "Copy & move" , [] (bool)	// Copies are independent, moves leave an empty dictionary, and values are destroyed
+		{
+			nx::Dictionary<int, nx::UniquePtr<int>> owned;
+			for (int i = 0; i < 1000; ++ i)
+				owned[i].reset(new int(i));
+			for (int i = 0; i < 1000; i += 2)
+				owned.erase(i);
+
+			nx::Dictionary<int, nx::UniquePtr<int>> moved(nx::rvalue(owned));
+			ExpectEqual(size_t(0), owned.size());
+			ExpectEqual(size_t(500), moved.size());
+			ExpectEqual(999, * moved[999]);
+			owned = nx::rvalue(moved);
+			ExpectEqual(size_t(500), owned.size());
+
+			nx::Dictionary<int, int> dict;
+			for (int i = 0; i < 50; ++ i)
+				dict.insert(i, -i);
+			nx::Dictionary<int, int> copy(dict);
+			dict.clear();
+			ExpectEqual(size_t(0), dict.size());
+			ExpectEqual(size_t(50), copy.size());
+			ExpectEqual(-49, copy[49]);
+			dict = copy;
+			ExpectEqual(-10, dict.get(10));
+		}
+	);
+}
+
+// Shared state of the concurrent dictionary threads
+struct Shared
+{
+	nx::ConcurrentDictionary<int, int> * dict;
+	int  first;
+	bool ok;
+};
+
+// Writer thread - inserts its own keys, replaces their values, and erases every other one
+void * writeShared(void * context)
+{
+	Shared * shared = static_cast<Shared *>(context);
+	for (int i = shared->first; i < shared->first + 20000; ++ i)
+		shared->ok = shared->dict->insert(i, i) && shared->ok;
+	for (int i = shared->first; i < shared->first + 20000; ++ i)
+		shared->ok = !shared->dict->insert(i, -i) && shared->ok;
+	for (int i = shared->first; i < shared->first + 20000; i += 2)
+		shared->ok = shared->dict->erase(i) && shared->ok;
+	return nullptr;
+}
+
+// Reader thread - the preloaded keys are always there, and other values are never torn
+void * readShared(void * context)
+{
+	Shared * shared = static_cast<Shared *>(context);
+	for (int round = 0; round < 20; ++ round)
+		for (int i = 0; i < 1000; ++ i)
+		{
+			shared->ok = shared->dict->get(i, -1) == i && shared->ok;
+			int value = 0;
+			int key = 100000 + (i * 97 + round) % 80000;
+			if (shared->dict->get(key, value))
+				shared->ok = (value == key || value == -key) && shared->ok;
+		}
+	return nullptr;
+}
+
+void TestConcurrentDictionary(nx::Testing & test)
+{
+	test.runCase( "Insert & erase" , [] (bool)	// Works like Dictionary from a single thread, through several resizes
+		{
+			nx::ConcurrentDictionary<int, int> dict;
+			for (int i = 0; i < 10000; ++ i)
+				ExpectEqual(true, dict.insert(i, i));
+			ExpectEqual(false, dict.insert(5, 50));
+			ExpectEqual(size_t(10000), dict.size());
+			ExpectEqual(50, dict.get(5, -1));
+			ExpectEqual(-1, dict.get(10000, -1));
+
+			bool found = true;
+			for (int i = 0; i < 10000; i += 3)
+				found = dict.erase(i) && found;
+			for (int i = 0; i < 10000; ++ i)
+				found = found && dict.contains(i) == (i % 3 != 0);
+			ExpectEqual(true, found);
+			ExpectEqual(false, dict.erase(0));
+
+			size_t count = 0;
+			long long sum = 0;
+			dict.forEach([&] (int key, int value) {count ++; sum += value - key;});
+			ExpectEqual(dict.size(), count);
+			ExpectEqual(45ll, sum);
+
+			nx::ConcurrentDictionary<int, nx::Pair<int, long long>> pairs;
+			pairs.insert(1, nx::Pair<int, long long>(2, 3));
+			nx::Pair<int, long long> pair(0, 0);
+			ExpectEqual(true, pairs.get(1, pair));
+			ExpectEqual(3ll, pair.second);
+		}
+	);
+
+	test.runCase( "Threads" , [] (bool)	// Readers and writers at the same time, while the table grows
+		{
+			nx::ConcurrentDictionary<int, int> dict;
+			for (int i = 0; i < 1000; ++ i)
+				dict.insert(i, i);
+
+			Shared shared[8];
+			pthread_t threads[8];
+			for (int t = 0; t < 8; ++ t)
+			{
+				shared[t] = Shared{& dict, 100000 + 20000 * (t / 2), true};
+				pthread_create(& threads[t], nullptr, t % 2 ? readShared : writeShared, & shared[t]);
+			}
+			bool ok = true;
+			for (int t = 0; t < 8; ++ t)
+			{
+				pthread_join(threads[t], nullptr);
+				ok = ok && shared[t].ok;
+			}
+			ExpectEqual(true, ok);
+			ExpectEqual(size_t(1000 + 4 * 10000), dict.size());
+			ExpectEqual(-100001, dict.get(100001, 0));
+			ExpectEqual(false, dict.contains(100002));
+		}
+	);
+}
+
 void TestTuple(nx::Testing & test)
 {
 	test.runCase( "Pair" , [] (bool)
@@ -232,6 +1176,13 @@ void TestSession(nx::Testing & test)
 {
 	test.runGroup("Range", TestRange);
 	test.runGroup("List", TestList);
+	test.runGroup("SmallList", TestSmallList);
+	test.runGroup("ChunkedList", TestChunkedList);
+	test.runGroup("Deque", TestDeque);
+	test.runGroup("Set", TestSet);
+	test.runGroup("IntSet", TestIntSet);
+	test.runGroup("Dictionary", TestDictionary);
+	test.runGroup("ConcurrentDictionary", TestConcurrentDictionary);
 //	test.runGroup("", Test);
 }
 
@@ -0,0 +1,215 @@
+/**
+	nx-heap-report - Converts a binary heap profile (written by nx::mem::dumpProfile) to a pprof heap profile
+
+	Usage: nx-heap-report <profile> [<output>]
+
+	Allocations are grouped by their stack trace. A sampled allocation is in use, if its deallocation was not recorded.
+	The output is the legacy text format of pprof ("heap_v2"), so pprof can scale the sampled numbers, and symbolize the
+	addresses using the memory map at the end of the profile.
+ */
+
+// Local includes
+#include <nx-new.hh>
+
+// Standard includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Stack trace, with the allocations sampled there
+struct Stack
+{
+	uint64_t depth;
+	uint64_t frames[64];
+
+	uint64_t allocCount;
+	uint64_t allocBytes;
+	uint64_t inuseCount;
+	uint64_t inuseBytes;
+};
+
+// Live sample - address, size and stack of a sampled allocation
+struct Sample
+{
+	uint64_t address;
+	uint64_t size;
+	size_t stack;
+};
+
+// Growable array (only for trivial types)
+template<typename T> struct Vector
+{
+	T * items = nullptr;
+	size_t n = 0;
+	size_t m = 0;
+
+	T * append()
+	{
+		if (n == m)
+		{
+			m = m ? 2 * m : 256;
+			items = static_cast<T *>(realloc(items, sizeof(T) * m));
+			if (!items)
+			{
+				fprintf(stderr, "nx-heap-report: out of memory\n");
+				exit(1);
+			}
+		}
+		return & items[n ++];
+	}
+};
+
+// Hash of a stack trace
+static uint64_t hashStack(const uint64_t * frames, uint64_t depth)
+{
+	uint64_t h = depth;
+	for (uint64_t i = 0; i < depth; ++ i)
+		h = (h ^ frames[i]) * 0x100000001b3;
+	return h;
+}
+
+// Find or add a stack trace (table is an open addressing index into stacks, with 0 meaning empty)
+static size_t findStack(Vector<Stack> & stacks, Vector<size_t> & table, const uint64_t * frames, uint64_t depth)
+{
+	// Keep the table at most half full
+	if (2 * stacks.n >= table.n)
+	{
+		size_t size = table.n ? 2 * table.n : 1024;
+		free(table.items);
+		table.items = static_cast<size_t *>(calloc(size, sizeof(size_t)));
+		table.n = table.m = size;
+		for (size_t s = 0; s < stacks.n; ++ s)
+		{
+			size_t i = hashStack(stacks.items[s].frames, stacks.items[s].depth) & (size - 1);
+			while (table.items[i])
+				i = (i + 1) & (size - 1);
+			table.items[i] = s + 1;
+		}
+	}
+
+	size_t i = hashStack(frames, depth) & (table.n - 1);
+	for (; table.items[i]; i = (i + 1) & (table.n - 1))
+	{
+		Stack & stack = stacks.items[table.items[i] - 1];
+		if (stack.depth == depth && memcmp(stack.frames, frames, sizeof(uint64_t) * depth) == 0)
+			return table.items[i] - 1;
+	}
+
+	Stack * stack = stacks.append();
+	memset(stack, 0, sizeof(Stack));
+	stack->depth = depth;
+	memcpy(stack->frames, frames, sizeof(uint64_t) * depth);
+	table.items[i] = stacks.n;
+	return stacks.n - 1;
+}
+
+// Find the live sample of an address (samples is an open addressing table, with address 0 meaning empty)
+static Sample & findSample(Vector<Sample> & samples, uint64_t address)
+{
+	size_t i = (address >> 4) * 0x9e3779b97f4a7c15 >> 20 & (samples.n - 1);
+	while (samples.items[i].address && samples.items[i].address != address)
+		i = (i + 1) & (samples.n - 1);
+	return samples.items[i];
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: nx-heap-report <profile> [<output>]\n");
+		return 2;
+	}
+
+	FILE * input = fopen(argv[1], "rb");
+	FILE * output = argc > 2 ? fopen(argv[2], "w") : stdout;
+	if (!input || !output)
+	{
+		fprintf(stderr, "nx-heap-report: cannot open %s\n", input ? argv[2] : argv[1]);
+		return 1;
+	}
+
+	// Header
+	uint64_t header[4];
+	if (fread(header, sizeof(header), 1, input) != 1 || header[0] != nx::mem::ProfileMagic)
+	{
+		fprintf(stderr, "nx-heap-report: %s is not a heap profile\n", argv[1]);
+		return 1;
+	}
+	if (header[3] > 0)
+		fprintf(stderr, "nx-heap-report: warning: %llu events were overwritten, in use numbers may be off\n", (unsigned long long) header[3]);
+
+	// Live samples (table sized for every event being a live sample)
+	Vector<Sample> samples;
+	for (samples.n = 1024; samples.n < 2 * header[2]; samples.n <<= 1);
+	samples.items = static_cast<Sample *>(calloc(samples.n, sizeof(Sample)));
+
+	Vector<Stack> stacks;
+	Vector<size_t> table;
+
+	// Events
+	for (;;)
+	{
+		uint64_t fields[4];
+		uint64_t frames[64];
+		if (fread(fields, sizeof(fields), 1, input) != 1 || fields[3] > 64 || fread(frames, sizeof(uint64_t), fields[3], input) != fields[3])
+		{
+			fprintf(stderr, "nx-heap-report: %s is truncated\n", argv[1]);
+			return 1;
+		}
+		if (fields[0] == 0)
+			break;
+
+		Sample & sample = findSample(samples, fields[1]);
+		if (fields[0] == 1)
+		{
+			size_t s = findStack(stacks, table, frames, fields[3]);
+			stacks.items[s].allocCount += 1;
+			stacks.items[s].allocBytes += fields[2];
+			stacks.items[s].inuseCount += 1;
+			stacks.items[s].inuseBytes += fields[2];
+
+			// Recorded deallocations are never removed from the table, so a reused address just updates the sample
+			sample.address = fields[1];
+			sample.size = fields[2];
+			sample.stack = s + 1;
+		}
+		else if (fields[0] == 2 && sample.stack)
+		{
+			stacks.items[sample.stack - 1].inuseCount -= 1;
+			stacks.items[sample.stack - 1].inuseBytes -= sample.size;
+			sample.stack = 0;
+		}
+	}
+
+	// Totals
+	uint64_t total[4] = {0, 0, 0, 0};
+	for (size_t s = 0; s < stacks.n; ++ s)
+	{
+		total[0] += stacks.items[s].inuseCount;
+		total[1] += stacks.items[s].inuseBytes;
+		total[2] += stacks.items[s].allocCount;
+		total[3] += stacks.items[s].allocBytes;
+	}
+
+	// Profile
+	fprintf(output, "heap profile: %llu: %llu [%llu: %llu] @ heap_v2/%llu\n", (unsigned long long) total[0], (unsigned long long) total[1],
+		(unsigned long long) total[2], (unsigned long long) total[3], (unsigned long long) header[1]);
+	for (size_t s = 0; s < stacks.n; ++ s)
+	{
+		const Stack & stack = stacks.items[s];
+		fprintf(output, "%llu: %llu [%llu: %llu] @", (unsigned long long) stack.inuseCount, (unsigned long long) stack.inuseBytes,
+			(unsigned long long) stack.allocCount, (unsigned long long) stack.allocBytes);
+		for (uint64_t i = 0; i < stack.depth; ++ i)
+			fprintf(output, " 0x%llx", (unsigned long long) stack.frames[i]);
+		fprintf(output, "\n");
+	}
+
+	// Memory map
+	fprintf(output, "\nMAPPED_LIBRARIES:\n");
+	char buffer[4096];
+	for (size_t n; (n = fread(buffer, 1, sizeof(buffer), input)) > 0; )
+		fwrite(buffer, 1, n, output);
+
+	fclose(input);
+	return fclose(output) == 0 ? 0 : 1;
+}